@@ -0,0 +1,35 @@
+uniform sampler2DArray u_views;
+uniform int u_layer;            // one view as is, or -1 for the dome master
+uniform mat4 u_faces[6];        // camera space to each cube face (looking down -Z)
+uniform float u_fov;            // of the fisheye, radians
+
+varying vec2 v_texcoord;
+
+void main () {
+    if (u_layer >= 0) {
+        gl_FragColor = texture(u_views, vec3(v_texcoord, float(u_layer)));
+        return;
+    }
+
+    // Equidistant fisheye: the center looks where the camera looks
+    vec2 p = v_texcoord * 2. - 1.;
+    float r = length(p);
+    if (r > 1.) {
+        gl_FragColor = vec4(0., 0., 0., 1.);
+        return;
+    }
+    float theta = r * u_fov * .5;
+    float phi = atan(p.y, p.x);
+    vec3 dir = vec3(sin(theta) * cos(phi), sin(theta) * sin(phi), -cos(theta));
+
+    // The face this direction goes through is the one it points most straight into
+    vec4 color = vec4(0., 0., 0., 1.);
+    for (int i = 0; i < 6; i++) {
+        vec3 q = mat3(u_faces[i]) * dir;
+        if (-q.z >= max(abs(q.x), abs(q.y))) {
+            color = texture(u_views, vec3(q.xy / -q.z * .5 + .5, float(i)));
+            break;
+        }
+    }
+    gl_FragColor = color;
+}
@@ -5,14 +5,46 @@ varying vec2 v_texcoord;
 
 uniform sampler2D u_diffuse;
 
+// Tiled imagery (ofxVirtualTexture), used when u_virtualSize is set
+uniform sampler2D u_atlas;
+uniform sampler2D u_indirection;
+uniform vec2 u_virtualSize;     // full image, pixels
+uniform vec2 u_virtualGrid;     // tiles of the full image
+uniform float u_virtualTile;
+uniform float u_virtualBorder;
+uniform vec2 u_atlasSize;
+uniform sampler2D u_coverage;
+uniform float u_coverageMax;
+
 void main () {
     vec3 color = vec3(1., 0., 0.);
     vec2 st = v_texcoord;
     
 //    color = v_normal * .5 + .5;
-    color = texture(u_diffuse, st).rgb;
+    if (u_virtualSize.x > 0.) {
+        // Which slot of the atlas holds this tile, and how many levels coarser it is
+        vec2 pixel = st * u_virtualSize;
+        vec2 cell = min(floor(pixel / u_virtualTile), u_virtualGrid - 1.);
+        vec3 entry = floor(texture(u_indirection, (cell + .5) / u_virtualGrid).rgb * 255. + .5);
+        float scale = exp2(entry.b);
+        vec2 tile = floor(cell / scale);
+        vec2 inTile = pixel / scale - tile * u_virtualTile;
+        vec2 atlas = entry.rg * (u_virtualTile + 2. * u_virtualBorder) + u_virtualBorder + inTile;
+        color = texture(u_atlas, atlas / u_atlasSize).rgb;
+    }
+    else {
+        color = texture(u_diffuse, st).rgb;
+    }
     color *= .5;
     color += .25;
     
+    // Satellites in view (CoverageMap), from none to the busiest cell
+    if (u_coverageMax > 0.) {
+        float visible = texture(u_coverage, st).r;
+        float pct = clamp(visible / u_coverageMax, 0., 1.);
+        vec3 heat = mix(vec3(0.337, 0.780, 0.847), vec3(0.918, 0.275, 0.247), pct);
+        color = mix(color, heat, step(0.001, visible) * (.25 + pct * .5));
+    }
+    
     gl_FragColor = vec4(color, 1.);
 }
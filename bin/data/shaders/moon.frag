@@ -3,11 +3,10 @@
 #define PI 3.1415926535
 #define HALF_PI 1.57079632679
 
-uniform float u_synodic_day;
-
 varying vec4 v_position;
 varying vec4 v_color;
 varying vec2 v_texcoord;
+varying float v_synodic_day;
 
 vec2 sphereCoords(in vec2 _st, in vec3 _norm) {
     vec3 vertPoint = _norm;
@@ -23,7 +22,7 @@ void main () {
     vec2 uv = st-.5;
     
     // LIGHT
-    float angle = u_synodic_day*TAU-HALF_PI; // Moon fase to radiant
+    float angle = v_synodic_day*TAU-HALF_PI; // Moon fase to radiant
     vec3 l = normalize(vec3(cos(angle),0.,sin(angle)));
     
     // PLANET
@@ -1,16 +1,20 @@
 uniform mat4 modelViewMatrix;
 uniform mat4 modelViewProjectionMatrix;
+uniform float u_size;
 
 attribute vec4 color;
 attribute vec4 position;
 attribute vec2 texcoord;
+attribute vec4 a_moon;      // per instance: position and synodic day
 
 varying vec4 v_position;
 varying vec4 v_color;
 varying vec2 v_texcoord;
+varying float v_synodic_day;
 
 void main() {
     v_texcoord  = texcoord;
     v_color     = color;
-    gl_Position = modelViewProjectionMatrix * position;
+    v_synodic_day = a_moon.w;
+    gl_Position = modelViewProjectionMatrix * vec4(a_moon.xyz + position.xyz * u_size, 1.);
 }
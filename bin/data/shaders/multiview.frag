@@ -0,0 +1,18 @@
+// What openFrameworks' default shader does, for the draws of the scene
+// while it renders into every view at once
+
+uniform sampler2D src_tex_unit0;
+uniform float usingTexture;
+uniform float usingColors;
+uniform vec4 globalColor;
+
+varying vec4 v_color;
+varying vec2 v_texcoord;
+
+void main () {
+    vec4 color = (usingColors > .5)? v_color : globalColor;
+    if (usingTexture > .5) {
+        color *= texture2D(src_tex_unit0, v_texcoord);
+    }
+    gl_FragColor = color;
+}
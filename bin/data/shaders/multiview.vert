@@ -0,0 +1,15 @@
+uniform mat4 modelViewProjectionMatrix;
+uniform mat4 textureMatrix;
+
+attribute vec4 position;
+attribute vec4 color;
+attribute vec2 texcoord;
+
+varying vec4 v_color;
+varying vec2 v_texcoord;
+
+void main() {
+    v_color     = color;
+    v_texcoord  = (textureMatrix * vec4(texcoord, 0., 1.)).xy;
+    gl_Position = modelViewProjectionMatrix * position;
+}
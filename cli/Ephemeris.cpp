@@ -0,0 +1,337 @@
+//
+//  Ephemeris.cpp
+//  Solar
+//
+
+#include "Ephemeris.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "CsvField.h"
+#include "FrameVector.h"
+#include "SatelliteCache.h"
+
+#define EPHEMERIS_EARTH_RADIUS_KM   6378.137
+#define EPHEMERIS_EARTH_FLATTENING  0.0033528106647474805
+#define EPHEMERIS_DEG_TO_RAD        0.017453292519943295
+#define EPHEMERIS_RAD_TO_DEG        57.29577951308232
+
+namespace {
+
+void appendNumber(std::string& _out, const char* _format, double _value) {
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), _format, _value);
+    _out.append(buffer, std::max(0, std::min(length, int(sizeof(buffer)) - 1)));
+}
+
+void appendJson(std::string& _out, double _value) {
+    if (std::isfinite(_value)) {
+        appendNumber(_out, "%.10g", _value);
+    }
+    else {
+        _out += "null";
+    }
+}
+
+// Quoted JSON string, with quotes, backslashes and control characters escaped
+void appendJsonString(std::string& _out, const std::string& _text) {
+    _out += '"';
+    for (size_t i = 0; i < _text.size(); i++) {
+        unsigned char c = (unsigned char)_text[i];
+        if (c == '"' || c == '\\') {
+            _out += '\\';
+            _out += char(c);
+        }
+        else if (c < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            _out += buffer;
+        }
+        else {
+            _out += char(c);
+        }
+    }
+    _out += '"';
+}
+
+bool bigEndianHost() {
+    const uint16_t probe = 1;
+    return *(const unsigned char*)&probe == 0;
+}
+
+// Appends _value to _out in little endian byte order, whatever the host uses
+template<typename T>
+void appendRaw(std::string& _out, const T& _value) {
+    const char* bytes = (const char*)&_value;
+    size_t at = _out.size();
+    _out.append(bytes, sizeof(T));
+    if (bigEndianHost()) {
+        std::reverse(_out.begin() + at, _out.end());
+    }
+}
+
+// Same for a whole array, in one copy when the host is already little endian
+template<typename T>
+void appendRaw(std::string& _out, const std::vector<T>& _values) {
+    if (!bigEndianHost()) {
+        _out.append((const char*)_values.data(), _values.size() * sizeof(T));
+        return;
+    }
+    for (size_t i = 0; i < _values.size(); i++) {
+        appendRaw(_out, _values[i]);
+    }
+}
+
+}
+
+Ephemeris::Ephemeris(const EphemerisOptions& _options, const std::vector<EphemerisTarget>& _targets) :
+    m_options(_options),
+    m_targets(_targets) {
+
+    m_columns.push_back("jd");
+    if (m_options.helio) {
+        m_columns.push_back("helio_x");
+        m_columns.push_back("helio_y");
+        m_columns.push_back("helio_z");
+    }
+    if (m_options.geo) {
+        m_columns.push_back("geo_x");
+        m_columns.push_back("geo_y");
+        m_columns.push_back("geo_z");
+    }
+    if (m_options.equatorial) {
+        m_columns.push_back("ra");
+        m_columns.push_back("dec");
+        m_columns.push_back("distance");
+    }
+    if (m_options.horizontal) {
+        m_columns.push_back("alt");
+        m_columns.push_back("az");
+    }
+
+    // Observer on the WGS84 ellipsoid
+    double phi = m_options.lat * EPHEMERIS_DEG_TO_RAD;
+    double lambda = m_options.lng * EPHEMERIS_DEG_TO_RAD;
+    double b = 1.0 - EPHEMERIS_EARTH_FLATTENING;
+    double C = 1.0 / std::sqrt(std::cos(phi) * std::cos(phi) + b * b * std::sin(phi) * std::sin(phi));
+    double h = m_options.altitude / 1000.0;
+    m_site = glm::dvec3((EPHEMERIS_EARTH_RADIUS_KM * C + h) * std::cos(phi) * std::cos(lambda),
+                        (EPHEMERIS_EARTH_RADIUS_KM * C + h) * std::cos(phi) * std::sin(lambda),
+                        (EPHEMERIS_EARTH_RADIUS_KM * C * b * b + h) * std::sin(phi));
+}
+
+size_t Ephemeris::getBlocks() const {
+    size_t steps = std::max<size_t>(1, m_options.blockSteps);
+    return (m_options.steps + steps - 1) / steps;
+}
+
+Ephemeris::State Ephemeris::makeState() const {
+    State state;
+    state.earth = Body(EARTH);
+    for (size_t i = 0; i < m_targets.size(); i++) {
+        state.bodies.push_back(Body(m_targets[i].body == NAB? SUN : m_targets[i].body));
+        state.satellites.push_back(m_targets[i].satellite);
+    }
+    return state;
+}
+
+void Ephemeris::compute(size_t _index, State& _state, EphemerisBlock& _block) const {
+    const size_t total = m_targets.size();
+    const size_t first = _index * m_options.blockSteps;
+    const size_t steps = std::min(m_options.blockSteps, m_options.steps - first);
+    const size_t rows = steps * total;
+    const double unit = m_options.km? 1.0 : unitFactor<Unit::KM, Unit::AU>();
+    const double toKm = unitFactor<Unit::AU, Unit::KM>();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    _block.index = _index;
+    _block.rows = rows;
+    _block.target.resize(rows);
+    _block.columns.assign(m_columns.size() * rows, nan);
+
+    for (size_t s = 0; s < steps; s++) {
+        double jd = m_options.jdStart + (first + s) * m_options.step;
+        _state.obs.setJD(jd);
+        _state.eop.update(jd);
+
+        glm::dmat3 eclipticToEquatorial = _state.eop.getEclipticToEquatorial();
+        glm::dmat3 equatorialToEcliptic = glm::transpose(eclipticToEquatorial);
+        glm::dvec3 site = glm::transpose(_state.eop.getEquatorialToTerrestrial()) * m_site;
+        glm::dmat3 local = _state.eop.getEquatorialToHorizontal(m_options.lng, m_options.lat);
+
+        glm::dvec3 earth(0.0);
+        if (m_options.helio) {
+            _state.earth.compute(_state.obs);
+            Vector v = _state.earth.getEclipticHeliocentric().getVector(AU);
+            earth = glm::dvec3(v.x, v.y, v.z) * toKm;
+        }
+
+        for (size_t t = 0; t < total; t++) {
+            size_t row = s * total + t;
+            _block.target[row] = uint16_t(t);
+
+            // Everything in km: ecliptic helio/geocentric and true equatorial of date
+            glm::dvec3 helio, geo, equat;
+            if (m_targets[t].body != NAB) {
+                Body& body = _state.bodies[t];
+                body.compute(_state.obs);
+                Vector g = body.getEclipticGeocentric().getVector(AU);
+                Vector h = body.getEclipticHeliocentric().getVector(AU);
+                geo = glm::dvec3(g.x, g.y, g.z) * toKm;
+                helio = glm::dvec3(h.x, h.y, h.z) * toKm;
+                equat = eclipticToEquatorial * geo;
+            }
+            else {
+                try {
+                    equat = SatelliteCache::evaluate(_state.satellites[t], jd).position;
+                }
+                catch (...) {
+                    _block.columns[row] = jd;
+                    continue;   // decayed: the rest of the row stays NaN
+                }
+                geo = equatorialToEcliptic * equat;
+                helio = earth + geo;
+            }
+
+            size_t c = 0;
+            _block.columns[(c++) * rows + row] = jd;
+            if (m_options.helio) {
+                _block.columns[(c++) * rows + row] = helio.x * unit;
+                _block.columns[(c++) * rows + row] = helio.y * unit;
+                _block.columns[(c++) * rows + row] = helio.z * unit;
+            }
+            if (m_options.geo) {
+                _block.columns[(c++) * rows + row] = geo.x * unit;
+                _block.columns[(c++) * rows + row] = geo.y * unit;
+                _block.columns[(c++) * rows + row] = geo.z * unit;
+            }
+            if (m_options.equatorial) {
+                double ra = std::atan2(equat.y, equat.x) * EPHEMERIS_RAD_TO_DEG;
+                double distance = glm::length(equat);
+                _block.columns[(c++) * rows + row] = (ra < 0.0)? ra + 360.0 : ra;
+                _block.columns[(c++) * rows + row] = std::asin(equat.z / distance) * EPHEMERIS_RAD_TO_DEG;
+                _block.columns[(c++) * rows + row] = distance * unit;
+            }
+            if (m_options.horizontal) {
+                // Topocentric, which matters for the Moon and satellites
+                double alt, az;
+                EarthOrientation::toAltAz(local * (equat - site), alt, az);
+                _block.columns[(c++) * rows + row] = alt * EPHEMERIS_RAD_TO_DEG;
+                _block.columns[(c++) * rows + row] = az * EPHEMERIS_RAD_TO_DEG;
+            }
+        }
+    }
+}
+
+// CSV
+// --------------------------------------------------------------------------
+
+std::string CsvWriter::header(const Ephemeris& _ephemeris) const {
+    const std::vector<std::string>& columns = _ephemeris.getColumns();
+    std::string out = "jd,target";
+    for (size_t c = 1; c < columns.size(); c++) {
+        out += "," + columns[c];
+    }
+    return out + "\n";
+}
+
+void CsvWriter::serialize(const Ephemeris& _ephemeris, const EphemerisBlock& _block, std::string& _out) const {
+    const std::vector<EphemerisTarget>& targets = _ephemeris.getTargets();
+    const size_t columns = _ephemeris.getColumns().size();
+    _out.clear();
+    _out.reserve(_block.rows * columns * 16);
+    for (size_t r = 0; r < _block.rows; r++) {
+        appendNumber(_out, "%.8f", _block.columns[r]);
+        _out += ",";
+        appendCsvField(_out, targets[_block.target[r]].name);
+        for (size_t c = 1; c < columns; c++) {
+            _out += ",";
+            double value = _block.columns[c * _block.rows + r];
+            if (std::isfinite(value)) {
+                appendNumber(_out, "%.10g", value);
+            }
+        }
+        _out += "\n";
+    }
+}
+
+// NDJSON
+// --------------------------------------------------------------------------
+
+void NdjsonWriter::serialize(const Ephemeris& _ephemeris, const EphemerisBlock& _block, std::string& _out) const {
+    const std::vector<EphemerisTarget>& targets = _ephemeris.getTargets();
+    const EphemerisOptions& options = _ephemeris.getOptions();
+    const size_t rows = _block.rows;
+    _out.clear();
+    _out.reserve(rows * _ephemeris.getColumns().size() * 20);
+
+    for (size_t r = 0; r < rows; r++) {
+        size_t c = 1;
+        _out += "{\"jd\":";
+        appendNumber(_out, "%.8f", _block.columns[r]);
+        _out += ",\"target\":";
+        appendJsonString(_out, targets[_block.target[r]].name);
+        if (options.helio || options.geo) {
+            for (int frame = 0; frame < 2; frame++) {
+                if ((frame == 0 && !options.helio) || (frame == 1 && !options.geo)) {
+                    continue;
+                }
+                _out += (frame == 0)? ",\"helio\":[" : ",\"geo\":[";
+                for (int i = 0; i < 3; i++) {
+                    _out += (i? "," : "");
+                    appendJson(_out, _block.columns[(c++) * rows + r]);
+                }
+                _out += "]";
+            }
+        }
+        if (options.equatorial) {
+            _out += ",\"ra\":";
+            appendJson(_out, _block.columns[(c++) * rows + r]);
+            _out += ",\"dec\":";
+            appendJson(_out, _block.columns[(c++) * rows + r]);
+            _out += ",\"distance\":";
+            appendJson(_out, _block.columns[(c++) * rows + r]);
+        }
+        if (options.horizontal) {
+            _out += ",\"alt\":";
+            appendJson(_out, _block.columns[(c++) * rows + r]);
+            _out += ",\"az\":";
+            appendJson(_out, _block.columns[(c++) * rows + r]);
+        }
+        _out += "}\n";
+    }
+}
+
+// COLUMNAR
+// --------------------------------------------------------------------------
+
+std::string ColumnarWriter::header(const Ephemeris& _ephemeris) const {
+    const std::vector<std::string>& columns = _ephemeris.getColumns();
+    const std::vector<EphemerisTarget>& targets = _ephemeris.getTargets();
+
+    std::string out = "SEPH";
+    appendRaw(out, uint32_t(1));
+    appendRaw(out, uint16_t(columns.size()));
+    for (size_t i = 0; i < columns.size(); i++) {
+        appendRaw(out, uint8_t(columns[i].size()));
+        out += columns[i];
+    }
+    appendRaw(out, uint16_t(targets.size()));
+    for (size_t i = 0; i < targets.size(); i++) {
+        std::string name = targets[i].name.substr(0, 255);
+        appendRaw(out, uint8_t(name.size()));
+        out += name;
+    }
+    return out;
+}
+
+void ColumnarWriter::serialize(const Ephemeris& _ephemeris, const EphemerisBlock& _block, std::string& _out) const {
+    _out.clear();
+    _out.reserve(4 + _block.target.size() * sizeof(uint16_t) + _block.columns.size() * sizeof(double));
+    appendRaw(_out, uint32_t(_block.rows));
+    appendRaw(_out, _block.target);
+    appendRaw(_out, _block.columns);
+}
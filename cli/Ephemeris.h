@@ -0,0 +1,109 @@
+//
+//  Ephemeris.h
+//  Solar
+//
+//  Computation and serialization stages of the command line exporter.
+//  Work is cut in blocks of consecutive steps; a block holds every target
+//  at every step of its range as columns, so it can be serialized (or
+//  written as is, in the columnar layout) without going back to the bodies.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "Astro/src/Body.h"
+#include "Astro/src/Satellite.h"
+
+#include "EarthOrientation.h"
+
+struct EphemerisOptions {
+    double      jdStart = 0.0;
+    double      step = 1.0 / 24.0;      // days
+    size_t      steps = 0;
+    size_t      blockSteps = 256;
+
+    double      lng = 0.0;              // observer, degrees
+    double      lat = 0.0;
+    double      altitude = 0.0;         // meters
+
+    bool        helio = true;
+    bool        geo = true;
+    bool        equatorial = true;
+    bool        horizontal = true;
+    bool        km = false;             // distances in km instead of AU
+};
+
+struct EphemerisTarget {
+    std::string name;
+    BodyId      body = NAB;             // NAB for satellites
+    Satellite   satellite;
+};
+
+struct EphemerisBlock {
+    size_t      index = 0;
+    size_t      rows = 0;               // steps x targets, step major
+    std::vector<uint16_t>   target;     // rows
+    std::vector<double>     columns;    // column major, columns x rows
+};
+
+class Ephemeris {
+public:
+    Ephemeris(const EphemerisOptions& _options, const std::vector<EphemerisTarget>& _targets);
+
+    size_t      getBlocks() const;
+    const std::vector<std::string>& getColumns() const { return m_columns; }
+    const std::vector<EphemerisTarget>& getTargets() const { return m_targets; }
+    const EphemerisOptions& getOptions() const { return m_options; }
+
+    // Per thread copy of every body, propagator and the Earth orientation
+    struct State {
+        Observer                obs;
+        Body                    earth;
+        std::vector<Body>       bodies;
+        std::vector<Satellite>  satellites;
+        EarthOrientation        eop;
+    };
+    State       makeState() const;
+
+    void        compute(size_t _index, State& _state, EphemerisBlock& _block) const;
+
+protected:
+    EphemerisOptions                m_options;
+    std::vector<EphemerisTarget>    m_targets;
+    std::vector<std::string>        m_columns;
+    glm::dvec3                      m_site;     // Earth fixed, km
+};
+
+// Turns blocks into bytes. Blocks are serialized concurrently, so writers keep no state
+class EphemerisWriter {
+public:
+    virtual ~EphemerisWriter() {}
+
+    virtual std::string header(const Ephemeris& _ephemeris) const { return ""; }
+    virtual void        serialize(const Ephemeris& _ephemeris, const EphemerisBlock& _block, std::string& _out) const = 0;
+    virtual std::string footer(const Ephemeris& _ephemeris) const { return ""; }
+};
+
+class CsvWriter : public EphemerisWriter {
+public:
+    virtual std::string header(const Ephemeris& _ephemeris) const;
+    virtual void        serialize(const Ephemeris& _ephemeris, const EphemerisBlock& _block, std::string& _out) const;
+};
+
+class NdjsonWriter : public EphemerisWriter {
+public:
+    virtual void        serialize(const Ephemeris& _ephemeris, const EphemerisBlock& _block, std::string& _out) const;
+};
+
+// "SEPH" uint32 version, uint16 columns, { uint8 length, name }, uint16 targets, { uint8 length, name },
+// then per block: uint32 rows, uint16 target[rows], double column[rows] for every column.
+// Little endian on every host
+class ColumnarWriter : public EphemerisWriter {
+public:
+    virtual std::string header(const Ephemeris& _ephemeris) const;
+    virtual void        serialize(const Ephemeris& _ephemeris, const EphemerisBlock& _block, std::string& _out) const;
+};
@@ -0,0 +1,482 @@
+//
+//  main.cpp
+//  Solar command line exporter
+//
+//  Streams ephemerides without openFrameworks or a window:
+//
+//      solar-cli --bodies sun,moon,mars --tle stations.tle --lng -73.96 --lat 40.78
+//                --start now --days 30 --step 0.0416667 --format csv --out eph.csv
+//
+//  or yearly rise/set/twilight/transit tables for many places:
+//
+//      solar-cli --almanac --sites cities.csv --year 2025 --transits mars,jupiter --out almanac.csv
+//
+//  Compute threads fill blocks of steps, serializer threads turn them into
+//  bytes and the main thread writes them in order. Bounded queues between
+//  the stages (and a cap on blocks in flight) keep memory constant no matter
+//  how large the export is.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "Astro/src/TimeOps.h"
+
+#include "Almanac.h"
+#include "BoundedQueue.h"
+#include "Ephemeris.h"
+#include "TleFile.h"
+
+struct Chunk {
+    size_t      index = 0;
+    std::string bytes;
+};
+
+void usage() {
+    std::cerr <<
+    "solar-cli [options]\n"
+    "  --bodies LIST     comma separated: sun,mercury,venus,mars,jupiter,saturn,\n"
+    "                    uranus,neptune,pluto,moon or all (default all)\n"
+    "  --tle FILE        also export every satellite in a TLE file\n"
+    "  --lng DEG --lat DEG [--alt M]   observer (default 0,0)\n"
+    "  --start JD|now    first Julian Day (default now)\n"
+    "  --end JD | --days N             last Julian Day or span (default 1 day)\n"
+    "  --step DAYS       spacing (default 1/24)\n"
+    "  --frames LIST     helio,geo,equatorial,horizontal (default all)\n"
+    "  --unit au|km      distances (default au)\n"
+    "  --format csv|ndjson|binary      (default csv)\n"
+    "  --out FILE        (default stdout)\n"
+    "  --threads N       compute threads (default all cores)\n"
+    "  --block N         steps per block (default 256)\n"
+    "  --quiet           no summary on stderr\n"
+    "\n"
+    "solar-cli --almanac [options]\n"
+    "  --sites FILE      name,lat,lng[,timezone] per line (default the --lng/--lat observer)\n"
+    "  --tz HOURS        timezone of the --lng/--lat observer (default from its longitude)\n"
+    "  --year YEAR       local calendar year (default --start and --days, 365 days)\n"
+    "  --transits LIST   bodies whose transits are listed besides the Sun and Moon\n"
+    "  --step DAYS       sampling of the shared ephemeris (default 1/24)\n"
+    "  --threads N --out FILE --quiet\n";
+}
+
+std::vector<std::string> splitList(const std::string& _list) {
+    std::vector<std::string> items;
+    std::stringstream stream(_list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.size() > 0) {
+            std::transform(item.begin(), item.end(), item.begin(), ::tolower);
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool addBodies(const std::string& _list, std::vector<EphemerisTarget>& _targets) {
+    static const std::map<std::string, BodyId> names = {
+        { "sun", SUN }, { "mercury", MERCURY }, { "venus", VENUS }, { "mars", MARS },
+        { "jupiter", JUPITER }, { "saturn", SATURN }, { "uranus", URANUS }, { "neptune", NEPTUNE },
+        { "pluto", PLUTO }, { "moon", LUNA }, { "luna", LUNA } };
+    static const char* all[] = { "sun", "mercury", "venus", "moon", "mars", "jupiter", "saturn", "uranus", "neptune", "pluto" };
+
+    std::vector<std::string> items = splitList(_list);
+    if (items.size() == 1 && items[0] == "all") {
+        items.assign(all, all + sizeof(all) / sizeof(all[0]));
+    }
+    for (size_t i = 0; i < items.size(); i++) {
+        std::map<std::string, BodyId>::const_iterator it = names.find(items[i]);
+        if (it == names.end()) {
+            std::cerr << "Unknown body " << items[i] << std::endl;
+            return false;
+        }
+        EphemerisTarget target;
+        target.name = items[i];
+        std::transform(target.name.begin(), target.name.end(), target.name.begin(), ::toupper);
+        target.body = it->second;
+        _targets.push_back(target);
+    }
+    return true;
+}
+
+bool parseBodies(const std::string& _list, std::vector<BodyId>& _bodies) {
+    std::vector<EphemerisTarget> targets;
+    if (!addBodies(_list, targets)) {
+        return false;
+    }
+    for (size_t i = 0; i < targets.size(); i++) {
+        _bodies.push_back(targets[i].body);
+    }
+    return true;
+}
+
+bool addSatellites(const std::string& _path, std::vector<EphemerisTarget>& _targets) {
+    std::map<unsigned int, TleText> tles;
+    if (!TleFile::load(_path, tles)) {
+        std::cerr << "Can't read " << _path << std::endl;
+        return false;
+    }
+    for (std::map<unsigned int, TleText>::iterator it = tles.begin(); it != tles.end(); ++it) {
+        EphemerisTarget target;
+        try {
+            target.satellite = Satellite(TLE(it->second.name, it->second.line1, it->second.line2));
+        }
+        catch (...) {
+            std::cerr << "Skipping malformed TLE for NORAD " << it->first << std::endl;
+            continue;
+        }
+        // The writers escape (JSON) or quote (CSV) it as needed
+        target.name = it->second.name;
+        target.body = NAB;
+        _targets.push_back(target);
+    }
+    return true;
+}
+
+int runAlmanac(Almanac& _almanac, const std::vector<AlmanacSite>& _sites, const std::string& _output, bool _quiet) {
+    FILE* out = stdout;
+    if (!_output.empty()) {
+        out = std::fopen(_output.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Can't write " << _output << std::endl;
+            return 1;
+        }
+    }
+
+    std::chrono::steady_clock::time_point clock = std::chrono::steady_clock::now();
+    _almanac.prepare();
+    double prepared = std::chrono::duration<double>(std::chrono::steady_clock::now() - clock).count();
+
+    size_t bytes = 0;
+    std::string head = _almanac.header();
+    bool failed = std::fwrite(head.data(), 1, head.size(), out) != head.size();
+    size_t sites = 0;
+    if (!failed) {
+        sites = _almanac.run(_sites, [&](const std::string& _rows) {
+            bytes += _rows.size();
+            return std::fwrite(_rows.data(), 1, _rows.size(), out) == _rows.size();
+        });
+    }
+    std::fflush(out);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+
+    if (failed || sites < _sites.size()) {
+        std::cerr << "Write failed after " << sites << " sites" << std::endl;
+        return 1;
+    }
+    if (!_quiet) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - clock).count();
+        std::cerr << sites << " sites, " << bytes / 1048576.0 << " MB in " << seconds << "s ("
+                  << prepared << "s shared ephemeris)" << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    EphemerisOptions options;
+    std::string bodies = "all";
+    std::string tle = "";
+    std::string format = "csv";
+    std::string output = "";
+    double start = TimeOps::now(UTC);
+    double end = -1.0;
+    double days = 1.0;
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool quiet = false;
+    bool bodiesSet = false;
+    bool almanac = false;
+    bool daysSet = false;
+    bool stepSet = false;
+    std::string sites = "";
+    std::string transits = "";
+    double tz = 1e9;
+    int year = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::string value = hasValue? argv[i + 1] : "";
+
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            return 0;
+        }
+        else if (arg == "--quiet") {
+            quiet = true;
+            continue;
+        }
+        else if (arg == "--almanac") {
+            almanac = true;
+            continue;
+        }
+        else if (!hasValue) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            usage();
+            return 1;
+        }
+
+        if (arg == "--bodies")          { bodies = value; bodiesSet = true; }
+        else if (arg == "--tle")        { tle = value; }
+        else if (arg == "--lng")        { options.lng = std::atof(value.c_str()); }
+        else if (arg == "--lat")        { options.lat = std::atof(value.c_str()); }
+        else if (arg == "--alt")        { options.altitude = std::atof(value.c_str()); }
+        else if (arg == "--start")      { start = (value == "now")? TimeOps::now(UTC) : std::atof(value.c_str()); }
+        else if (arg == "--end")        { end = std::atof(value.c_str()); }
+        else if (arg == "--days")       { days = std::atof(value.c_str()); daysSet = true; }
+        else if (arg == "--sites")      { sites = value; }
+        else if (arg == "--transits")   { transits = value; }
+        else if (arg == "--tz")         { tz = std::atof(value.c_str()); }
+        else if (arg == "--year")       { year = std::atoi(value.c_str()); }
+        else if (arg == "--step")       { options.step = std::atof(value.c_str()); stepSet = true; }
+        else if (arg == "--format")     { format = value; }
+        else if (arg == "--out")        { output = value; }
+        else if (arg == "--threads")    { threads = std::max(1, std::atoi(value.c_str())); }
+        else if (arg == "--block")      { options.blockSteps = std::max(1, std::atoi(value.c_str())); }
+        else if (arg == "--unit")       { options.km = (value == "km"); }
+        else if (arg == "--frames") {
+            std::vector<std::string> frames = splitList(value);
+            options.helio = std::find(frames.begin(), frames.end(), "helio") != frames.end();
+            options.geo = std::find(frames.begin(), frames.end(), "geo") != frames.end();
+            options.equatorial = std::find(frames.begin(), frames.end(), "equatorial") != frames.end();
+            options.horizontal = std::find(frames.begin(), frames.end(), "horizontal") != frames.end();
+        }
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            usage();
+            return 1;
+        }
+        i++;
+    }
+
+    // ALMANAC
+    // --------------------------------
+    if (almanac) {
+        Almanac engine;
+        std::vector<AlmanacSite> places;
+        if (!sites.empty()) {
+            if (!Almanac::loadSites(sites, places)) {
+                std::cerr << "Can't read " << sites << std::endl;
+                return 1;
+            }
+        }
+        else {
+            AlmanacSite site;
+            site.name = "observer";
+            site.lng = options.lng;
+            site.lat = options.lat;
+            site.timezone = (tz < 1e8)? tz : std::floor(options.lng / 15.0 + 0.5);
+            places.push_back(site);
+        }
+        if (places.empty()) {
+            std::cerr << "No sites" << std::endl;
+            return 1;
+        }
+
+        std::vector<BodyId> bodies;
+        if (!transits.empty() && !parseBodies(transits, bodies)) {
+            return 1;
+        }
+        engine.setTransits(bodies);
+        if (year != 0) {
+            engine.setYear(year);
+        }
+        else {
+            engine.setWindow(start, daysSet? int(days) : 365);
+        }
+        if (stepSet) {
+            engine.setStep(options.step);
+        }
+        engine.setThreads(threads);
+        return runAlmanac(engine, places, output, quiet);
+    }
+
+    // TARGETS
+    // --------------------------------
+    std::vector<EphemerisTarget> targets;
+    if ((tle.empty() || bodiesSet) && !addBodies(bodies, targets)) {
+        return 1;
+    }
+    if (!tle.empty() && !addSatellites(tle, targets)) {
+        return 1;
+    }
+    if (targets.empty() || targets.size() > 0xFFFF) {
+        std::cerr << "Nothing to export" << std::endl;
+        return 1;
+    }
+
+    if (end < start) {
+        end = start + days;
+    }
+    if (options.step <= 0.0) {
+        std::cerr << "--step has to be positive" << std::endl;
+        return 1;
+    }
+    options.jdStart = start;
+    options.steps = size_t(std::floor((end - start) / options.step)) + 1;
+
+    std::unique_ptr<EphemerisWriter> writer;
+    if (format == "csv") {
+        writer.reset(new CsvWriter());
+    }
+    else if (format == "ndjson") {
+        writer.reset(new NdjsonWriter());
+    }
+    else if (format == "binary") {
+        writer.reset(new ColumnarWriter());
+    }
+    else {
+        std::cerr << "Unknown format " << format << std::endl;
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (!output.empty()) {
+        out = std::fopen(output.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Can't write " << output << std::endl;
+            return 1;
+        }
+    }
+
+    // PIPELINE
+    // --------------------------------
+    Ephemeris ephemeris(options, targets);
+    const size_t blocks = ephemeris.getBlocks();
+    const unsigned int serializers = std::max(1u, threads / 2);
+    const size_t inFlight = threads * 4;
+
+    BoundedQueue<EphemerisBlock> computed(threads * 2);
+    BoundedQueue<Chunk> serialized(threads * 2);
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::mutex gateMutex;
+    std::condition_variable gate;
+    size_t written = 0;
+
+    // Under the gate's mutex, so a worker can't check the predicate, miss
+    // the change and then sleep through the notification
+    auto fail = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(gateMutex);
+            failed = true;
+        }
+        gate.notify_all();
+    };
+
+    std::chrono::steady_clock::time_point clock = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> computeWorkers;
+    for (unsigned int t = 0; t < threads; t++) {
+        computeWorkers.push_back(std::thread([&]() {
+            Ephemeris::State state = ephemeris.makeState();
+            for (size_t i = next++; i < blocks && !failed; i = next++) {
+                // Don't run further ahead of the writer than the reorder window
+                {
+                    std::unique_lock<std::mutex> lock(gateMutex);
+                    gate.wait(lock, [&]() { return failed || i < written + inFlight; });
+                }
+                EphemerisBlock block;
+                ephemeris.compute(i, state, block);
+                if (!computed.push(std::move(block))) {
+                    break;
+                }
+            }
+        }));
+    }
+
+    std::vector<std::thread> serializeWorkers;
+    for (unsigned int t = 0; t < serializers; t++) {
+        serializeWorkers.push_back(std::thread([&]() {
+            EphemerisBlock block;
+            while (computed.pop(block)) {
+                Chunk chunk;
+                chunk.index = block.index;
+                writer->serialize(ephemeris, block, chunk.bytes);
+                if (!serialized.push(std::move(chunk))) {
+                    break;
+                }
+            }
+        }));
+    }
+
+    // Close each queue once everything feeding it is done
+    std::thread closer([&]() {
+        for (size_t t = 0; t < computeWorkers.size(); t++) {
+            computeWorkers[t].join();
+        }
+        computed.close();
+        for (size_t t = 0; t < serializeWorkers.size(); t++) {
+            serializeWorkers[t].join();
+        }
+        serialized.close();
+    });
+
+    size_t bytes = 0;
+    std::string head = writer->header(ephemeris);
+    if (std::fwrite(head.data(), 1, head.size(), out) != head.size()) {
+        fail();
+    }
+    bytes += head.size();
+
+    // Blocks finish out of order, write them back in order
+    std::map<size_t, std::string> pending;
+    Chunk chunk;
+    while (!failed && serialized.pop(chunk)) {
+        pending[chunk.index].swap(chunk.bytes);
+        while (!pending.empty() && pending.begin()->first == written) {
+            const std::string& data = pending.begin()->second;
+            if (std::fwrite(data.data(), 1, data.size(), out) != data.size()) {
+                fail();
+                break;
+            }
+            bytes += data.size();
+            pending.erase(pending.begin());
+            {
+                std::lock_guard<std::mutex> lock(gateMutex);
+                written++;
+            }
+            gate.notify_all();
+        }
+    }
+
+    if (failed) {
+        computed.close();
+        serialized.close();
+    }
+    closer.join();
+
+    std::string tail = writer->footer(ephemeris);
+    std::fwrite(tail.data(), 1, tail.size(), out);
+    std::fflush(out);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+
+    if (failed) {
+        std::cerr << "Write failed after " << bytes << " bytes" << std::endl;
+        return 1;
+    }
+
+    if (!quiet) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - clock).count();
+        std::cerr << options.steps * targets.size() << " rows, " << blocks << " blocks, "
+                  << bytes / 1048576.0 << " MB in " << seconds << "s ("
+                  << (bytes / 1048576.0) / std::max(seconds, 1e-9) << " MB/s, "
+                  << threads << " compute + " << serializers << " serialize threads)" << std::endl;
+    }
+    return 0;
+}
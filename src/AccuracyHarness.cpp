@@ -0,0 +1,446 @@
+//
+//  AccuracyHarness.cpp
+//  Solar
+//
+
+#include "AccuracyHarness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <random>
+#include <thread>
+
+#include "Astro/src/Body.h"
+#include "Astro/src/CoordOps.h"
+#include "Astro/src/TimeOps.h"
+
+#include "EarthOrientation.h"
+#include "KernelOps.h"
+#include "SatelliteCache.h"
+
+#define HARNESS_BATCH           256
+#define HARNESS_WINDOW          64          // satellites each worker plays frame after frame
+#define HARNESS_FRAME_STEP      0.0005      // days per frame, as the app's default time_step
+#define HARNESS_RAD_TO_ARCSEC   206264.80624709636
+#define HARNESS_TAU             6.283185307179586
+
+namespace {
+
+enum PathId {
+    SATELLITE_HERMITE = 0,
+    SATELLITE_HERMITE_FLOAT,
+    SATELLITE_SCENE_FLOAT,
+    BODIES_SCENE_FLOAT,
+    EARTH_ORIENTATION,
+    HORIZONTAL,
+    GMST_TIMEOPS,
+    PATH_TOTAL
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds(const Clock::time_point& _start) {
+    return std::chrono::duration<double>(Clock::now() - _start).count();
+}
+
+double angle(const glm::dvec3& _a, const glm::dvec3& _b) {
+    return std::atan2(glm::length(glm::cross(_a, _b)), glm::dot(_a, _b));
+}
+
+}
+
+double HarnessResult::rmsError() const {
+    return (samples > 0)? std::sqrt(sumError2 / samples) : 0.0;
+}
+
+double HarnessResult::speedup() const {
+    return (fastSeconds > 0.0)? referenceSeconds / fastSeconds : 0.0;
+}
+
+bool HarnessResult::passed() const {
+    if (samples == 0) {
+        return true;    // nothing to check (e.g. empty catalog)
+    }
+    return maxError <= budget.maxError && (budget.minSpeedup <= 0.0 || speedup() >= budget.minSpeedup);
+}
+
+void HarnessResult::merge(const HarnessResult& _other) {
+    samples += _other.samples;
+    maxError = std::max(maxError, _other.maxError);
+    sumError2 += _other.sumError2;
+    referenceSeconds += _other.referenceSeconds;
+    fastSeconds += _other.fastSeconds;
+}
+
+AccuracyHarness::AccuracyHarness() :
+    m_samples(1000000),
+    m_threads(std::max(1u, std::thread::hardware_concurrency())) {
+
+    double now = TimeOps::now(UTC);
+    m_jdStart = now - 30.0;
+    m_jdEnd = now + 30.0;
+
+    m_budgets.resize(PATH_TOTAL);
+    m_budgets[SATELLITE_HERMITE]        = { "satellite-hermite",        "km",       0.1,    2.0 };
+    m_budgets[SATELLITE_HERMITE_FLOAT]  = { "satellite-hermite-float",  "km",       0.1,    2.0 };
+    m_budgets[SATELLITE_SCENE_FLOAT]    = { "satellite-scene-float",    "km",       KERNEL_FLOAT_BUDGET_KM, 0.5 };
+    m_budgets[BODIES_SCENE_FLOAT]       = { "bodies-scene-float",       "arcsec",   KERNEL_FLOAT_BUDGET_ARCSEC, 0.5 };
+    m_budgets[EARTH_ORIENTATION]        = { "earth-orientation",        "arcsec",   0.05,   2.0 };
+    m_budgets[HORIZONTAL]               = { "horizontal",               "arcsec",   0.1,    0.5 };
+    m_budgets[GMST_TIMEOPS]             = { "gmst-vs-timeops",          "arcsec",   30.0,   0.0 };
+}
+
+bool AccuracyHarness::setBudget(const std::string& _name, double _maxError, double _minSpeedup) {
+    for (size_t i = 0; i < m_budgets.size(); i++) {
+        if (m_budgets[i].name == _name) {
+            m_budgets[i].maxError = _maxError;
+            m_budgets[i].minSpeedup = _minSpeedup;
+            return true;
+        }
+    }
+    return false;
+}
+
+void AccuracyHarness::work(unsigned int _id, size_t _samples, std::vector<HarnessResult>& _results) {
+    std::mt19937_64 rng(0x50C4A + _id);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    _results.resize(PATH_TOTAL);
+    for (size_t i = 0; i < PATH_TOTAL; i++) {
+        _results[i].budget = m_budgets[i];
+    }
+
+    // Propagators and bodies mutate on compute(), so every worker owns a copy.
+    // Satellites are a window of the catalog played by the app's own cache
+    // from frame to frame, so knots are reused and refreshed as in a session
+    std::vector<Satellite> window;
+    if (m_satellites.size() > 0) {
+        size_t first = size_t(unit(rng) * m_satellites.size()) % m_satellites.size();
+        for (size_t i = 0; i < m_satellites.size() && window.size() < HARNESS_WINDOW; i++) {
+            Satellite sat = m_satellites[(first + i) % m_satellites.size()];
+            try {
+                SatelliteCache::evaluate(sat, m_jdStart);
+                SatelliteCache::evaluate(sat, m_jdEnd);
+            }
+            catch (...) {
+                continue;   // decayed or out of range for this TLE
+            }
+            window.push_back(m_satellites[(first + i) % m_satellites.size()]);
+        }
+    }
+    std::vector<Satellite> propagators = window;
+    SatelliteCache cache;
+    cache.setTimeStep(HARNESS_FRAME_STEP);
+    cache.setup(window);
+    double satJd = m_jdStart + unit(rng) * (m_jdEnd - m_jdStart);
+
+    BodyId bodyIds[] = { MERCURY, VENUS, MARS, JUPITER, SATURN, URANUS, NEPTUNE, PLUTO };
+    std::vector<Body> bodies;
+    for (size_t i = 0; i < sizeof(bodyIds) / sizeof(bodyIds[0]); i++) {
+        bodies.push_back(Body(bodyIds[i]));
+    }
+
+    EarthOrientation cached;
+
+    std::vector<double>         jds(HARNESS_BATCH);
+    std::vector<glm::dvec3>     reference(HARNESS_BATCH);
+    std::vector< EquatorialVector<Unit::KM, double> > eciD(HARNESS_BATCH);
+    std::vector< EquatorialVector<Unit::KM, float> >  eciF(HARNESS_BATCH);
+    std::vector< HelioVector<Unit::AU> > helio(HARNESS_BATCH);
+    std::vector<glm::vec3>      scene(HARNESS_BATCH), equat(HARNESS_BATCH), helioScene(HARNESS_BATCH);
+    std::vector<glm::dvec3>     vectors(HARNESS_BATCH), fast(HARNESS_BATCH);
+    std::vector<double>         lngs(HARNESS_BATCH), lats(HARNESS_BATCH), values(HARNESS_BATCH);
+    std::vector<Observer>       observers(HARNESS_BATCH);
+    std::vector<Ecliptic>       ecliptics(HARNESS_BATCH);
+
+    for (size_t done = 0; done < _samples; done += HARNESS_BATCH) {
+        size_t n = std::min<size_t>(HARNESS_BATCH, _samples - done);
+
+        // Consecutive frames from a random start, as a session would play them
+        double start = m_jdStart + unit(rng) * (m_jdEnd - m_jdStart);
+        for (size_t i = 0; i < n; i++) {
+            jds[i] = start + i * HARNESS_FRAME_STEP;
+        }
+
+        // SATELLITES: SatelliteCache::getPositions against a fresh SGP4 evaluation
+        // ------------------------------------------------------------------
+        if (window.size() > 0) {
+            size_t total = window.size();
+            size_t frames = std::max<size_t>(1, n / total);
+            size_t propagations, lookups;
+            cache.getStats(propagations, lookups);
+
+            HarnessResult& d = _results[SATELLITE_HERMITE];
+            HarnessResult& f = _results[SATELLITE_HERMITE_FLOAT];
+            double referenceTime = 0.0;
+            size_t evaluated = 0;
+            for (size_t frame = 0; frame < frames; frame++) {
+                satJd += HARNESS_FRAME_STEP;
+                if (satJd > m_jdEnd) {
+                    satJd = m_jdStart;  // a seek, as scrubbing back would be
+                }
+
+                try {
+                    Clock::time_point t = Clock::now();
+                    cache.getPositions(satJd, eciD);
+                    d.fastSeconds += seconds(t);
+
+                    t = Clock::now();
+                    cache.getPositions(satJd, eciF);
+                    f.fastSeconds += seconds(t);
+
+                    t = Clock::now();
+                    for (size_t i = 0; i < total; i++) {
+                        reference[i] = SatelliteCache::evaluate(propagators[i], satJd).position;
+                    }
+                    referenceTime += seconds(t);
+                    evaluated += total;
+                }
+                catch (...) {
+                    continue;
+                }
+
+                for (size_t i = 0; i < total; i++) {
+                    double errD = glm::length(eciD[i].toDvec3() - reference[i]);
+                    double errF = glm::length(eciF[i].as<double>().toDvec3() - reference[i]);
+                    d.maxError = std::max(d.maxError, errD);
+                    d.sumError2 += errD * errD;
+                    f.maxError = std::max(f.maxError, errF);
+                    f.sumError2 += errF * errF;
+                }
+                d.samples += total;
+                f.samples += total;
+            }
+
+            // Knots the worker thread propagated cost the same SGP4 time as the
+            // reference. Seeds are inside the timed calls too and get charged
+            // twice, which only makes the speedup look worse than it is
+            cache.getStats(propagations, lookups);
+            double knotTime = (evaluated > 0)? propagations * referenceTime / evaluated : 0.0;
+            d.referenceSeconds += referenceTime;
+            f.referenceSeconds += referenceTime;
+            d.fastSeconds += knotTime;
+            f.fastSeconds += knotTime;
+
+            // Scene projection of the last frame, float against double
+            cached.update(satJd);
+            glm::dmat3 toEcliptic = glm::transpose(cached.getEclipticToEquatorial());
+            const double earthSize = 1.7;
+            const double toKm = 1.0 / (unitFactor<Unit::KM, Unit::EARTH_RADII>() * earthSize);
+
+            Clock::time_point t = Clock::now();
+            KernelOps::satellitesToScene<double>(eciD.data(), total, toEcliptic, earthSize, glm::vec3(0.0f), equat.data(), scene.data(), helioScene.data());
+            referenceTime = seconds(t);
+            for (size_t i = 0; i < total; i++) {
+                reference[i] = toEcliptic * eciD[i].toDvec3();
+            }
+
+            std::vector< EquatorialVector<Unit::KM, float> > narrowed(total);
+            for (size_t i = 0; i < total; i++) {
+                narrowed[i] = eciD[i].as<float>();
+            }
+            t = Clock::now();
+            KernelOps::satellitesToScene<float>(narrowed.data(), total, toEcliptic, earthSize, glm::vec3(0.0f), equat.data(), scene.data(), helioScene.data());
+            double fastTime = seconds(t);
+
+            HarnessResult& s = _results[SATELLITE_SCENE_FLOAT];
+            s.referenceSeconds += referenceTime;
+            s.fastSeconds += fastTime;
+            for (size_t i = 0; i < total; i++) {
+                double err = glm::length(glm::dvec3(scene[i]) * toKm - reference[i]);
+                s.maxError = std::max(s.maxError, err);
+                s.sumError2 += err * err;
+            }
+            s.samples += total;
+        }
+
+        // BODIES: float scene kernel against the exact heliocentric direction
+        // ------------------------------------------------------------------
+        {
+            Observer obs;
+            for (size_t i = 0; i < n; i++) {
+                Body& body = bodies[i % bodies.size()];
+                obs.setJD(m_jdStart + unit(rng) * (m_jdEnd - m_jdStart));
+                body.compute(obs);
+                Vector v = body.getEclipticHeliocentric().getVector(AU);
+                helio[i] = HelioVector<Unit::AU>(v.x, v.y, v.z);
+            }
+
+            Clock::time_point t = Clock::now();
+            KernelOps::bodiesToScene<double>(helio.data(), n, 500.0, scene.data());
+            double referenceTime = seconds(t);
+            t = Clock::now();
+            KernelOps::bodiesToScene<float>(helio.data(), n, 500.0, scene.data());
+            double fastTime = seconds(t);
+
+            HarnessResult& r = _results[BODIES_SCENE_FLOAT];
+            r.referenceSeconds += referenceTime;
+            r.fastSeconds += fastTime;
+            for (size_t i = 0; i < n; i++) {
+                double err = angle(glm::dvec3(scene[i]), helio[i].toDvec3()) * HARNESS_RAD_TO_ARCSEC;
+                r.maxError = std::max(r.maxError, err);
+                r.sumError2 += err * err;
+            }
+            r.samples += n;
+        }
+
+        // EARTH ORIENTATION: cached matrix against Astro's CoordOps::toEquatorial
+        // ------------------------------------------------------------------
+        {
+            for (size_t i = 0; i < n; i++) {
+                double lon = unit(rng) * HARNESS_TAU;
+                double lat = std::asin(unit(rng) * 2.0 - 1.0);
+                vectors[i] = glm::dvec3(std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat));
+                ecliptics[i] = Ecliptic(lon, lat, 1.0, RADS, AU);
+                observers[i].setJD(jds[i]);
+            }
+
+            Clock::time_point t = Clock::now();
+            for (size_t i = 0; i < n; i++) {
+                Vector v = CoordOps::toEquatorial(observers[i], ecliptics[i]).getVector();
+                reference[i] = glm::dvec3(v.x, v.y, v.z);
+            }
+            double referenceTime = seconds(t);
+
+            t = Clock::now();
+            for (size_t i = 0; i < n; i++) {
+                cached.update(jds[i]);
+                fast[i] = cached.toEquatorial(vectors[i]);
+            }
+            double fastTime = seconds(t);
+
+            HarnessResult& r = _results[EARTH_ORIENTATION];
+            r.referenceSeconds += referenceTime;
+            r.fastSeconds += fastTime;
+            for (size_t i = 0; i < n; i++) {
+                double err = angle(fast[i], reference[i]) * HARNESS_RAD_TO_ARCSEC;
+                r.maxError = std::max(r.maxError, err);
+                r.sumError2 += err * err;
+            }
+            r.samples += n;
+        }
+
+        // HORIZONTAL: shared rotation matrix against what Body::compute runs
+        // (CoordOps::toEquatorial then CoordOps::toHorizontal) for the planets
+        // ------------------------------------------------------------------
+        {
+            for (size_t i = 0; i < n; i++) {
+                lngs[i] = unit(rng) * 360.0 - 180.0;
+                lats[i] = unit(rng) * 180.0 - 90.0;
+                observers[i] = Observer(lngs[i], lats[i]);
+                observers[i].setJD(jds[i]);
+                Body& body = bodies[i % bodies.size()];
+                body.compute(observers[i]);
+                ecliptics[i] = body.getEclipticGeocentric();
+                Vector v = ecliptics[i].getVector(AU);
+                vectors[i] = glm::dvec3(v.x, v.y, v.z);
+            }
+
+            std::vector<double> alt(n), az(n);
+            Clock::time_point t = Clock::now();
+            for (size_t i = 0; i < n; i++) {
+                Horizontal hor = CoordOps::toHorizontal(observers[i], CoordOps::toEquatorial(observers[i], ecliptics[i]));
+                alt[i] = hor.getAltitud(RADS);
+                az[i] = hor.getAzimuth(RADS);
+            }
+            double referenceTime = seconds(t);
+
+            t = Clock::now();
+            for (size_t i = 0; i < n; i++) {
+                cached.update(jds[i]);
+                glm::dvec3 enu = cached.getEquatorialToHorizontal(lngs[i], lats[i]) * cached.toEquatorial(vectors[i]);
+                EarthOrientation::toAltAz(enu, values[i], fast[i].x);
+                fast[i].y = values[i];
+            }
+            double fastTime = seconds(t);
+
+            HarnessResult& r = _results[HORIZONTAL];
+            r.referenceSeconds += referenceTime;
+            r.fastSeconds += fastTime;
+            for (size_t i = 0; i < n; i++) {
+                glm::dvec3 a(std::cos(alt[i]) * std::sin(az[i]), std::cos(alt[i]) * std::cos(az[i]), std::sin(alt[i]));
+                glm::dvec3 b(std::cos(fast[i].y) * std::sin(fast[i].x), std::cos(fast[i].y) * std::cos(fast[i].x), std::sin(fast[i].y));
+                double err = angle(a, b) * HARNESS_RAD_TO_ARCSEC;
+                r.maxError = std::max(r.maxError, err);
+                r.sumError2 += err * err;
+            }
+            r.samples += n;
+        }
+
+        // GMST: cached Earth orientation against Astro's TimeOps
+        // ------------------------------------------------------------------
+        {
+            Clock::time_point t = Clock::now();
+            for (size_t i = 0; i < n; i++) {
+                values[i] = TimeOps::toGreenwichSiderealTime(jds[i]);
+            }
+            double referenceTime = seconds(t);
+
+            t = Clock::now();
+            for (size_t i = 0; i < n; i++) {
+                cached.update(jds[i]);
+                fast[i].x = cached.getGMST();
+            }
+            double fastTime = seconds(t);
+
+            HarnessResult& r = _results[GMST_TIMEOPS];
+            r.referenceSeconds += referenceTime;
+            r.fastSeconds += fastTime;
+            for (size_t i = 0; i < n; i++) {
+                double diff = std::remainder(fast[i].x - values[i], HARNESS_TAU);
+                double err = std::abs(diff) * HARNESS_RAD_TO_ARCSEC;
+                r.maxError = std::max(r.maxError, err);
+                r.sumError2 += err * err;
+            }
+            r.samples += n;
+        }
+    }
+}
+
+bool AccuracyHarness::run(std::ostream& _out) {
+    unsigned int threads = std::max(1u, m_threads);
+    std::vector< std::vector<HarnessResult> > partial(threads);
+    std::vector<std::thread> workers;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < threads; i++) {
+        size_t share = m_samples / threads + ((i < m_samples % threads)? 1 : 0);
+        workers.push_back(std::thread(&AccuracyHarness::work, this, i, share, std::ref(partial[i])));
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    m_results.assign(PATH_TOTAL, HarnessResult());
+    for (size_t i = 0; i < PATH_TOTAL; i++) {
+        m_results[i].budget = m_budgets[i];
+        for (unsigned int t = 0; t < threads; t++) {
+            m_results[i].merge(partial[t][i]);
+        }
+    }
+
+    bool pass = true;
+    _out << std::left << std::setw(26) << "path" << std::right
+         << std::setw(10) << "samples"
+         << std::setw(14) << "max" << std::setw(14) << "rms" << std::setw(8) << "unit"
+         << std::setw(11) << "speedup" << std::setw(16) << "budget" << "  result" << std::endl;
+    for (size_t i = 0; i < m_results.size(); i++) {
+        const HarnessResult& r = m_results[i];
+        std::ostringstream budget;
+        budget << r.budget.maxError << "/" << r.budget.minSpeedup << "x";
+        _out << std::left << std::setw(26) << r.budget.name << std::right
+             << std::setw(10) << r.samples
+             << std::setw(14) << std::setprecision(5) << r.maxError
+             << std::setw(14) << std::setprecision(5) << r.rmsError()
+             << std::setw(8) << r.budget.unit
+             << std::setw(10) << std::setprecision(3) << r.speedup() << "x"
+             << std::setw(16) << budget.str()
+             << "  " << (r.samples == 0? "SKIP" : (r.passed()? "PASS" : "FAIL")) << std::endl;
+        pass = pass && r.passed();
+    }
+    _out << threads << " threads, " << seconds(start) << "s" << std::endl;
+    return pass;
+}
@@ -0,0 +1,72 @@
+//
+//  AccuracyHarness.h
+//  Solar
+//
+//  Headless accuracy-versus-speed check of every fast path against the
+//  computation it replaces. Random JDs and observers are sampled on all
+//  cores; each path reports max/RMS error (arcsec or km) next to its
+//  speedup and fails when it leaves its budget.
+//
+//  Satellites go through SatelliteCache as the app drives it: every worker
+//  plays a window of the catalog frame after frame, and the knots the
+//  cache propagates count against its time. Earth orientation and the
+//  horizontal matrix are checked against Astro's CoordOps.
+//
+
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Astro/src/Satellite.h"
+
+struct HarnessBudget {
+    std::string name;
+    std::string unit;           // "arcsec" or "km"
+    double      maxError;       // fails above this
+    double      minSpeedup;     // fails below this, 0 disables the check
+};
+
+struct HarnessResult {
+    HarnessBudget budget;
+    size_t      samples = 0;
+    double      maxError = 0.0;
+    double      sumError2 = 0.0;
+    double      referenceSeconds = 0.0;
+    double      fastSeconds = 0.0;
+
+    double      rmsError() const;
+    double      speedup() const;
+    bool        passed() const;
+    void        merge(const HarnessResult& _other);
+};
+
+class AccuracyHarness {
+public:
+    AccuracyHarness();
+
+    void        setSamples(size_t _samples) { m_samples = _samples; }
+    void        setThreads(unsigned int _threads) { m_threads = _threads; }
+    void        setRange(double _jdStart, double _jdEnd) { m_jdStart = _jdStart; m_jdEnd = _jdEnd; }
+    void        setSatellites(const std::vector<Satellite>& _satellites) { m_satellites = _satellites; }
+
+    // Overrides the default budget of a path by name
+    bool        setBudget(const std::string& _name, double _maxError, double _minSpeedup);
+    const std::vector<HarnessBudget>& getBudgets() const { return m_budgets; }
+
+    // Returns true when every path stays inside its budget
+    bool        run(std::ostream& _out);
+    const std::vector<HarnessResult>& getResults() const { return m_results; }
+
+protected:
+    void        work(unsigned int _id, size_t _samples, std::vector<HarnessResult>& _results);
+
+    std::vector<HarnessBudget>  m_budgets;
+    std::vector<HarnessResult>  m_results;
+    std::vector<Satellite>      m_satellites;
+    size_t                      m_samples;
+    unsigned int                m_threads;
+    double                      m_jdStart;
+    double                      m_jdEnd;
+};
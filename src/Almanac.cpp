@@ -0,0 +1,447 @@
+//
+//  Almanac.cpp
+//  Solar
+//
+
+#include "Almanac.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "Astro/src/Observer.h"
+#include "Astro/src/TimeOps.h"
+
+#include "CsvField.h"
+#include "EarthOrientation.h"
+
+#define ALMANAC_DEG_TO_RAD      0.017453292519943295
+#define ALMANAC_TAU             6.283185307179586
+#define ALMANAC_AU_KM           149597870.7
+#define ALMANAC_EARTH_RADIUS_KM 6378.14
+#define ALMANAC_REFRACTION      -0.5667     // degrees, at the horizon
+#define ALMANAC_SUN_H0          -0.8333     // refraction and semidiameter
+#define ALMANAC_TOLERANCE       1e-6        // days (~0.1s)
+
+namespace {
+
+// Meeus 7.1, 0h UTC of a Gregorian date
+double toJD(int _year, int _month, int _day) {
+    if (_month <= 2) {
+        _year -= 1;
+        _month += 12;
+    }
+    int a = _year / 100;
+    int b = 2 - a + a / 4;
+    return std::floor(365.25 * (_year + 4716)) + std::floor(30.6001 * (_month + 1)) + _day + b - 1524.5;
+}
+
+std::string formatMinutes(double _fraction) {
+    int minutes = std::min(1439, std::max(0, int(std::floor(_fraction * 1440.0 + 0.5))));
+    char buffer[8];
+    std::snprintf(buffer, sizeof(buffer), "%02d:%02d", minutes / 60, minutes % 60);
+    return buffer;
+}
+
+}
+
+Almanac::Almanac() :
+    m_jdStart(0.0),
+    m_days(0),
+    m_sampleStart(0.0),
+    m_step(1.0 / 24.0),
+    m_samples(0),
+    m_threads(std::max(1u, std::thread::hardware_concurrency())),
+    m_prepared(false) {
+    setWindow(TimeOps::now(UTC), 365);
+}
+
+void Almanac::setYear(int _year) {
+    m_jdStart = toJD(_year, 1, 1);
+    m_days = int(toJD(_year + 1, 1, 1) - m_jdStart + 0.5);
+    m_prepared = false;
+}
+
+void Almanac::setWindow(double _jd, int _days) {
+    m_jdStart = std::floor(_jd - 0.5) + 0.5;
+    m_days = std::max(1, _days);
+    m_prepared = false;
+}
+
+void Almanac::setTransits(const std::vector<BodyId>& _bodies) {
+    m_transitBodies = _bodies;
+    m_prepared = false;
+}
+
+void Almanac::setThreads(unsigned int _threads) {
+    m_threads = std::max(1u, _threads);
+}
+
+void Almanac::setStep(double _days) {
+    m_step = std::max(1.0 / 1440.0, std::min(0.25, _days));
+    m_prepared = false;
+}
+
+void Almanac::prepare() {
+    // Tracks: Sun and Moon for rise/set and twilights, then the transit bodies
+    std::vector<BodyId> bodies = { SUN, LUNA };
+    for (size_t i = 0; i < m_transitBodies.size(); i++) {
+        if (m_transitBodies[i] != EARTH && m_transitBodies[i] != NAB &&
+            std::find(bodies.begin(), bodies.end(), m_transitBodies[i]) == bodies.end()) {
+            bodies.push_back(m_transitBodies[i]);
+        }
+    }
+
+    // Local days reach up to 14h either side of UTC
+    m_sampleStart = m_jdStart - 1.0;
+    m_samples = size_t(std::ceil((m_days + 2.0) / m_step)) + 1;
+
+    m_tracks.assign(bodies.size(), Track());
+    for (size_t b = 0; b < bodies.size(); b++) {
+        m_tracks[b].body = bodies[b];
+        m_tracks[b].name = Body(bodies[b]).getName();
+        std::transform(m_tracks[b].name.begin(), m_tracks[b].name.end(), m_tracks[b].name.begin(), ::tolower);
+        m_tracks[b].direction.resize(m_samples);
+        m_tracks[b].sinH0.resize(m_samples, std::sin((bodies[b] == SUN? ALMANAC_SUN_H0 : ALMANAC_REFRACTION) * ALMANAC_DEG_TO_RAD));
+    }
+    m_gast.resize(m_samples);
+
+    // Contiguous ranges of samples, each thread with its own bodies and Earth orientation
+    unsigned int threads = (unsigned int)std::min<size_t>(m_threads, std::max<size_t>(1, m_samples / 64));
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([this, t, threads, &bodies]() {
+            size_t begin = m_samples * t / threads;
+            size_t end = m_samples * (t + 1) / threads;
+            Observer obs(0.0, 0.0);
+            EarthOrientation eop;
+            std::vector<Body> local;
+            for (size_t b = 0; b < bodies.size(); b++) {
+                local.push_back(Body(bodies[b]));
+            }
+
+            for (size_t k = begin; k < end; k++) {
+                double jd = m_sampleStart + k * m_step;
+                obs.setJD(jd);
+                eop.update(jd);
+                m_gast[k] = eop.getGAST();
+                glm::dmat3 toEquatorial = eop.getEclipticToEquatorial();
+
+                for (size_t b = 0; b < local.size(); b++) {
+                    local[b].compute(obs);
+                    Vector g = local[b].getEclipticGeocentric().getVector(AU);
+                    glm::dvec3 equat = toEquatorial * glm::dvec3(g.x, g.y, g.z);
+                    double distance = glm::length(equat);
+                    m_tracks[b].direction[k] = equat * (1.0 / distance);
+
+                    if (bodies[b] == LUNA) {
+                        // Meeus 15: h0 = 0.7275 parallax - 0'34"
+                        double parallax = std::asin(ALMANAC_EARTH_RADIUS_KM / (distance * ALMANAC_AU_KM));
+                        m_tracks[b].sinH0[k] = std::sin(0.7275 * parallax + ALMANAC_REFRACTION * ALMANAC_DEG_TO_RAD);
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    // Unwrapped, so it can be interpolated inside a step
+    m_cosGast.resize(m_samples);
+    m_sinGast.resize(m_samples);
+    for (size_t k = 0; k < m_samples; k++) {
+        if (k > 0) {
+            while (m_gast[k] < m_gast[k - 1]) {
+                m_gast[k] += ALMANAC_TAU;
+            }
+        }
+        m_cosGast[k] = std::cos(m_gast[k]);
+        m_sinGast[k] = std::sin(m_gast[k]);
+    }
+
+    m_crossings.clear();
+    const double twilights[] = { -6.0, -12.0, -18.0 };
+    const char* names[] = { "civil", "nautical", "astronomical" };
+    Crossing crossing;
+    crossing.track = 0;
+    crossing.standard = true;
+    crossing.sinAltitude = 0.0;
+    crossing.up = "sunrise";
+    crossing.down = "sunset";
+    m_crossings.push_back(crossing);
+    for (int i = 0; i < 3; i++) {
+        crossing.standard = false;
+        crossing.sinAltitude = std::sin(twilights[i] * ALMANAC_DEG_TO_RAD);
+        crossing.up = std::string(names[i]) + "_dawn";
+        crossing.down = std::string(names[i]) + "_dusk";
+        m_crossings.push_back(crossing);
+    }
+    crossing.track = 1;
+    crossing.standard = true;
+    crossing.up = "moonrise";
+    crossing.down = "moonset";
+    m_crossings.push_back(crossing);
+
+    m_transits.clear();
+    for (size_t b = 0; b < m_tracks.size(); b++) {
+        m_transits.push_back(int(b));
+    }
+    m_prepared = true;
+}
+
+std::string Almanac::header() const {
+    std::string out = "site,date";
+    for (size_t c = 0; c < m_crossings.size(); c++) {
+        out += "," + m_crossings[c].up + "," + m_crossings[c].down;
+    }
+    for (size_t t = 0; t < m_transits.size(); t++) {
+        out += ",transit_" + m_tracks[m_transits[t]].name;
+    }
+    return out + "\n";
+}
+
+double Almanac::evaluate(const SiteView& _site, const Track& _track, const Crossing* _crossing, size_t _k, double _s) const {
+    double g = m_gast[_k] + _s * (m_gast[_k + 1] - m_gast[_k]);
+    double cg = std::cos(g);
+    double sg = std::sin(g);
+    double c = cg * _site.cosLng - sg * _site.sinLng;
+    double s = sg * _site.cosLng + cg * _site.sinLng;
+
+    glm::dvec3 e = _track.direction[_k] * (1.0 - _s) + _track.direction[_k + 1] * _s;
+    e = e * (1.0 / glm::length(e));
+
+    if (!_crossing) {
+        // East component: positive before the upper transit
+        return -s * e.x + c * e.y;
+    }
+    double sinH0 = _crossing->standard? _track.sinH0[_k] * (1.0 - _s) + _track.sinH0[_k + 1] * _s : _crossing->sinAltitude;
+    return _site.cosLat * (c * e.x + s * e.y) + _site.sinLat * e.z - sinH0;
+}
+
+double Almanac::refine(const SiteView& _site, const Track& _track, const Crossing* _crossing, size_t _k, double _fa, double _fb) const {
+    // Regula falsi (Illinois) on the fraction of the step
+    double a = 0.0, b = 1.0;
+    double fa = _fa, fb = _fb;
+    for (int i = 0; i < 40 && std::fabs(b - a) * m_step > ALMANAC_TOLERANCE; i++) {
+        double c = (a * fb - b * fa) / (fb - fa);
+        double fc = evaluate(_site, _track, _crossing, _k, c);
+        if ((fc < 0.0) != (fb < 0.0)) {
+            a = b;
+            fa = fb;
+        }
+        else {
+            fa *= 0.5;
+        }
+        b = c;
+        fb = fc;
+        if (fc == 0.0) {
+            break;
+        }
+    }
+    return m_sampleStart + (_k + b) * m_step;
+}
+
+void Almanac::tabulate(const AlmanacSite& _site, std::string& _out) const {
+    const double lng = _site.lng * ALMANAC_DEG_TO_RAD;
+    const double lat = _site.lat * ALMANAC_DEG_TO_RAD;
+    SiteView site;
+    site.cosLng = std::cos(lng);
+    site.sinLng = std::sin(lng);
+    site.cosLat = std::cos(lat);
+    site.sinLat = std::sin(lat);
+
+    // Local sidereal angle at every sample, shared by all the columns of this site
+    std::vector<double> cosTheta(m_samples), sinTheta(m_samples);
+    for (size_t k = 0; k < m_samples; k++) {
+        cosTheta[k] = m_cosGast[k] * site.cosLng - m_sinGast[k] * site.sinLng;
+        sinTheta[k] = m_sinGast[k] * site.cosLng + m_cosGast[k] * site.sinLng;
+    }
+
+    const size_t columns = m_crossings.size() * 2 + m_transits.size();
+    std::vector<std::string> cells(size_t(m_days) * columns);
+    const double midnight = m_jdStart - _site.timezone / 24.0;     // JD of the first local midnight
+
+    std::vector<double> f(m_samples);
+    std::vector<char> happened(m_days);
+    for (size_t c = 0; c < m_crossings.size(); c++) {
+        const Crossing& crossing = m_crossings[c];
+        const Track& track = m_tracks[crossing.track];
+        for (size_t k = 0; k < m_samples; k++) {
+            const glm::dvec3& e = track.direction[k];
+            double sinH0 = crossing.standard? track.sinH0[k] : crossing.sinAltitude;
+            f[k] = site.cosLat * (cosTheta[k] * e.x + sinTheta[k] * e.y) + site.sinLat * e.z - sinH0;
+        }
+
+        std::fill(happened.begin(), happened.end(), 0);
+        for (size_t k = 0; k + 1 < m_samples; k++) {
+            if ((f[k] < 0.0) == (f[k + 1] < 0.0)) {
+                continue;
+            }
+            double jd = refine(site, track, &crossing, k, f[k], f[k + 1]);
+            double day = std::floor(jd - midnight);
+            if (day < 0.0 || day >= m_days) {
+                continue;
+            }
+            size_t d = size_t(day);
+            happened[d] = 1;
+            std::string& cell = cells[d * columns + c * 2 + ((f[k] < 0.0)? 0 : 1)];
+            if (cell.empty()) {
+                cell = formatMinutes(jd - midnight - day);
+            }
+        }
+
+        // Days without any crossing are all above or all below
+        for (int d = 0; d < m_days; d++) {
+            if (!happened[d]) {
+                size_t k = std::min(m_samples - 1, size_t(std::floor((midnight + d + 0.5 - m_sampleStart) / m_step + 0.5)));
+                const char* mark = (f[k] >= 0.0)? "**" : "--";
+                cells[d * columns + c * 2] = mark;
+                cells[d * columns + c * 2 + 1] = mark;
+            }
+        }
+    }
+
+    for (size_t t = 0; t < m_transits.size(); t++) {
+        const Track& track = m_tracks[m_transits[t]];
+        size_t column = m_crossings.size() * 2 + t;
+        for (size_t k = 0; k < m_samples; k++) {
+            const glm::dvec3& e = track.direction[k];
+            f[k] = -sinTheta[k] * e.x + cosTheta[k] * e.y;
+        }
+        for (size_t k = 0; k + 1 < m_samples; k++) {
+            // East to west, on the meridian above the pole (not the lower transit)
+            if (!(f[k] > 0.0 && f[k + 1] <= 0.0)) {
+                continue;
+            }
+            const glm::dvec3& e = track.direction[k];
+            if (cosTheta[k] * e.x + sinTheta[k] * e.y <= 0.0) {
+                continue;
+            }
+            double jd = refine(site, track, nullptr, k, f[k], f[k + 1]);
+            double day = std::floor(jd - midnight);
+            if (day >= 0.0 && day < m_days && cells[size_t(day) * columns + column].empty()) {
+                cells[size_t(day) * columns + column] = formatMinutes(jd - midnight - day);
+            }
+        }
+    }
+
+    char date[16];
+    for (int d = 0; d < m_days; d++) {
+        int day, month, year;
+        TimeOps::toDMY(m_jdStart + d + 0.5, day, month, year);
+        std::snprintf(date, sizeof(date), "%04d-%02d-%02d", year, month, day);
+        appendCsvField(_out, _site.name);
+        _out += ",";
+        _out += date;
+        for (size_t c = 0; c < columns; c++) {
+            _out += ",";
+            _out += cells[d * columns + c];
+        }
+        _out += "\n";
+    }
+}
+
+size_t Almanac::run(const std::vector<AlmanacSite>& _sites, const std::function<bool(const std::string&)>& _write) {
+    if (!m_prepared) {
+        prepare();
+    }
+
+    const size_t total = _sites.size();
+    const unsigned int threads = (unsigned int)std::min<size_t>(m_threads, std::max<size_t>(1, total));
+    const size_t window = threads * 4;      // sites done ahead of the writer
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> stop(false);
+    std::mutex mutex;
+    std::condition_variable ready, gate;
+    std::map<size_t, std::string> done;
+    size_t written = 0;
+
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < total && !stop; i = next++) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    gate.wait(lock, [&]() { return stop || i < written + window; });
+                }
+                std::string rows;
+                tabulate(_sites[i], rows);
+                std::lock_guard<std::mutex> lock(mutex);
+                done[i].swap(rows);
+                ready.notify_all();
+            }
+        }));
+    }
+
+    // Sites finish out of order, they are written back in order
+    while (written < total && !stop) {
+        std::string rows;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&]() { return done.count(written) > 0; });
+            rows.swap(done[written]);
+            done.erase(written);
+        }
+        bool ok = _write(rows);
+        {
+            // Under the gate's mutex, so a worker can't check the predicate,
+            // miss the change and then sleep through the notification
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ok) {
+                written++;
+            }
+            else {
+                stop = true;
+            }
+        }
+        gate.notify_all();
+    }
+
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    return written;
+}
+
+bool Almanac::loadSites(const std::string& _path, std::vector<AlmanacSite>& _sites) {
+    std::ifstream file(_path.c_str());
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::vector<std::string> fields = splitCsvRecord(line);
+        if (fields.size() < 3) {
+            continue;
+        }
+
+        // Skips headers and anything else that is not a number
+        char* end = nullptr;
+        AlmanacSite site;
+        site.lat = std::strtod(fields[1].c_str(), &end);
+        if (end == fields[1].c_str() || std::fabs(site.lat) > 90.0) {
+            continue;
+        }
+        site.lng = std::strtod(fields[2].c_str(), &end);
+        if (end == fields[2].c_str()) {
+            continue;
+        }
+        site.timezone = (fields.size() > 3)? std::atof(fields[3].c_str()) : std::floor(site.lng / 15.0 + 0.5);
+        site.name = fields[0];
+        _sites.push_back(site);
+    }
+    return true;
+}
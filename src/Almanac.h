@@ -0,0 +1,104 @@
+//
+//  Almanac.h
+//  Solar
+//
+//  Rise, set, twilight and transit tables for many places at once.
+//
+//  The geocentric part does not depend on where the observer is, so it is
+//  computed once: the apparent sidereal time and the true equatorial
+//  direction of every body, sampled hourly over the window. A site then
+//  only needs dot products with its zenith and east vectors: every hour
+//  where altitude minus the body's standard altitude (or the hour angle for
+//  transits) changes sign is bracketed and the crossing refined with a
+//  regula falsi. Sites are spread across threads.
+//
+//  Events closer than the sampling step (grazing rises at high latitudes)
+//  can be missed. Geocentric directions: the Moon's parallax is folded
+//  into its standard altitude, as in Meeus ch. 15.
+//
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "Astro/src/Body.h"
+
+struct AlmanacSite {
+    std::string name;
+    double      lng = 0.0;          // degrees, East positive
+    double      lat = 0.0;
+    double      timezone = 0.0;     // hours from UTC, days and times in the tables are local
+};
+
+class Almanac {
+public:
+    Almanac();
+
+    // Whole local calendar year, or _days local days from the one containing _jd
+    void        setYear(int _year);
+    void        setWindow(double _jd, int _days);
+    // Bodies whose upper transit is tabulated (the Sun and the Moon always are)
+    void        setTransits(const std::vector<BodyId>& _bodies);
+    void        setThreads(unsigned int _threads);
+    // Sampling step of the shared ephemeris, in days (clamped to 1 minute - 6 hours)
+    void        setStep(double _days);
+
+    // Samples the shared ephemeris, done by run() when needed
+    void        prepare();
+
+    std::string header() const;
+    // CSV rows, one per local day: HH:MM local times, "**" all day above the
+    // horizon (or twilight level), "--" all day below, empty when there is no event
+    void        tabulate(const AlmanacSite& _site, std::string& _out) const;
+
+    // Every site in parallel; _write receives the rows of each site in order
+    // and can stop the run by returning false. Returns the sites written
+    size_t      run(const std::vector<AlmanacSite>& _sites, const std::function<bool(const std::string&)>& _write);
+
+    // "name,lat,lng[,timezone]" CSV lines (RFC 4180 quoting), '#' comments. Without a timezone the
+    // nearest whole hour to the longitude is used
+    static bool loadSites(const std::string& _path, std::vector<AlmanacSite>& _sites);
+
+protected:
+    struct Track {
+        BodyId              body;
+        std::string         name;
+        std::vector<glm::dvec3> direction;  // unit vectors, true equator of date
+        std::vector<double> sinH0;          // sine of the standard altitude per sample
+    };
+
+    // Rise/set style columns: a track crossing its standard altitude or a fixed one (twilights)
+    struct Crossing {
+        int                 track;
+        bool                standard;
+        double              sinAltitude;
+        std::string         up, down;
+    };
+
+    // What a site sees at fraction _s of sample interval _k: altitude above the
+    // crossing level (sine) or, for transits, minus the sine of the hour angle
+    struct SiteView {
+        double              cosLng, sinLng;
+        double              cosLat, sinLat;
+    };
+    double      evaluate(const SiteView& _site, const Track& _track, const Crossing* _crossing, size_t _k, double _s) const;
+    double      refine(const SiteView& _site, const Track& _track, const Crossing* _crossing, size_t _k, double _fa, double _fb) const;
+
+    std::vector<Track>      m_tracks;
+    std::vector<Crossing>   m_crossings;
+    std::vector<int>        m_transits;         // tracks
+    std::vector<double>     m_gast;             // radians, unwrapped
+    std::vector<double>     m_cosGast, m_sinGast;
+    std::vector<BodyId>     m_transitBodies;
+
+    double                  m_jdStart;          // first local day, 0h UTC
+    int                     m_days;
+    double                  m_sampleStart;
+    double                  m_step;             // days
+    size_t                  m_samples;
+    unsigned int            m_threads;
+    bool                    m_prepared;
+};
@@ -0,0 +1,239 @@
+//
+//  Benchmark.cpp
+//  Solar
+//
+
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <random>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#define BENCHMARK_MU_KM3_S2         398600.4418
+#define BENCHMARK_EARTH_RADIUS_KM   6378.137
+#define BENCHMARK_TAU               6.283185307179586
+
+namespace {
+
+struct OrbitClass {
+    const char* name;
+    double      share;          // of the catalog
+    double      minAlt, maxAlt; // km, semi-major axis over the equatorial radius
+    double      inclinations[4];// picked at random, negative ends the list, 0 sun-synchronous
+    double      eccentricity;   // upper bound
+    bool        frozen;         // exactly that eccentricity, perigee at 270 degrees
+};
+
+// Roughly the make up of today's public catalog
+const OrbitClass orbitClasses[] = {
+    { "STARLINK",   0.40,   540.0,  570.0,  { 53.0, 53.2, 70.0, 97.6 },     0.0002, false },
+    { "ONEWEB",     0.15,   1190.0, 1210.0, { 87.9, -1.0 },                 0.0002, false },
+    { "SSO",        0.15,   480.0,  820.0,  { 0.0, -1.0 },                  0.0015, false },
+    { "DEB",        0.10,   350.0,  1500.0, { -1.0 },                       0.02,   false },    // any inclination
+    { "NAVSTAR",    0.08,   19100.0,23222.0,{ 55.0, 56.0, 64.8, -1.0 },     0.01,   false },
+    { "GEO",        0.09,   35776.0,35796.0,{ 0.05, 1.5, 4.5, -1.0 },       0.0004, false },
+    { "MOLNIYA",    0.03,   20222.0,20222.0,{ 63.4, -1.0 },                 0.74,   true },
+};
+
+double julianYearStart(int _year) {
+    int y = _year - 1;
+    return 1721425.5 + 365.0 * y + std::floor(y / 4.0) - std::floor(y / 100.0) + std::floor(y / 400.0);
+}
+
+int checksum(const std::string& _line) {
+    int sum = 0;
+    for (size_t i = 0; i < _line.size(); i++) {
+        char c = _line[i];
+        if (c >= '0' && c <= '9') {
+            sum += c - '0';
+        }
+        else if (c == '-') {
+            sum += 1;
+        }
+    }
+    return sum % 10;
+}
+
+}
+
+double BenchmarkSeries::percentile(double _p) const {
+    if (m_values.empty()) {
+        return 0.0;
+    }
+    std::vector<double> sorted(m_values);
+    std::sort(sorted.begin(), sorted.end());
+    size_t rank = size_t(std::ceil(_p / 100.0 * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0? rank - 1 : 0)];
+}
+
+double BenchmarkSeries::mean() const {
+    if (m_values.empty()) {
+        return 0.0;
+    }
+    return std::accumulate(m_values.begin(), m_values.end(), 0.0) / m_values.size();
+}
+
+double BenchmarkSeries::max() const {
+    return m_values.empty()? 0.0 : *std::max_element(m_values.begin(), m_values.end());
+}
+
+void BenchmarkSeries::writeJson(std::ostream& _out) const {
+    _out << "{\"p50\":" << percentile(50.0) << ",\"p95\":" << percentile(95.0) << ",\"p99\":" << percentile(99.0);
+    _out << ",\"mean\":" << mean() << ",\"max\":" << max() << "}";
+}
+
+Benchmark::Benchmark() :
+    m_frames(0),
+    m_warmup(0),
+    m_frame(0),
+    m_updateMs(0.0) {
+}
+
+void Benchmark::setup(size_t _frames, size_t _warmup) {
+    m_frames = _frames;
+    m_warmup = _warmup;
+    m_frame = 0;
+    m_update = m_draw = m_frameTotal = m_drawCalls = m_vertices = BenchmarkSeries();
+}
+
+void Benchmark::beginUpdate() {
+    m_updateStart = Clock::now();
+}
+
+void Benchmark::endUpdate() {
+    m_updateMs = std::chrono::duration<double, std::milli>(Clock::now() - m_updateStart).count();
+}
+
+void Benchmark::beginDraw() {
+    m_drawStart = Clock::now();
+}
+
+void Benchmark::endDraw(size_t _drawCalls, size_t _vertices) {
+    double drawMs = std::chrono::duration<double, std::milli>(Clock::now() - m_drawStart).count();
+    if (isRecording()) {
+        m_update.add(m_updateMs);
+        m_draw.add(drawMs);
+        m_frameTotal.add(m_updateMs + drawMs);
+        m_drawCalls.add(double(_drawCalls));
+        m_vertices.add(double(_vertices));
+    }
+    m_frame++;
+}
+
+void Benchmark::writeJson(std::ostream& _out) const {
+    _out << "{\"frames\":" << m_update.size() << ",\"warmup\":" << m_warmup;
+    for (std::map<std::string, std::string>::const_iterator it = m_info.begin(); it != m_info.end(); ++it) {
+        _out << ",\"" << it->first << "\":" << it->second;
+    }
+    _out << ",\"update_ms\":";
+    m_update.writeJson(_out);
+    _out << ",\"draw_ms\":";
+    m_draw.writeJson(_out);
+    _out << ",\"frame_ms\":";
+    m_frameTotal.writeJson(_out);
+    _out << ",\"draw_calls\":";
+    m_drawCalls.writeJson(_out);
+    _out << ",\"vertices\":";
+    m_vertices.writeJson(_out);
+    _out << ",\"peak_memory_bytes\":" << getPeakMemory() << "}" << std::endl;
+}
+
+bool Benchmark::writeCatalog(const std::string& _path, size_t _objects, double _jd, unsigned int _seed) {
+    std::ofstream file(_path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::mt19937 rng(_seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    // TLE epoch: two digit year and fractional day of the year
+    int year = int(std::floor((_jd - 1721425.5) / 365.2425)) + 1;
+    while (_jd < julianYearStart(year)) {
+        year--;
+    }
+    while (_jd >= julianYearStart(year + 1)) {
+        year++;
+    }
+    double day = _jd - julianYearStart(year) + 1.0;
+
+    // NORAD ids only have five digits
+    size_t total = std::min<size_t>(_objects, 99999);
+    size_t classes = sizeof(orbitClasses) / sizeof(orbitClasses[0]);
+    char line[128];
+    for (size_t i = 0; i < total; i++) {
+        // Pick the class by its share of the catalog
+        double pick = unit(rng);
+        size_t c = 0;
+        while (c + 1 < classes && pick > orbitClasses[c].share) {
+            pick -= orbitClasses[c].share;
+            c++;
+        }
+        const OrbitClass& orbit = orbitClasses[c];
+
+        double alt = orbit.minAlt + unit(rng) * (orbit.maxAlt - orbit.minAlt);
+        double a = BENCHMARK_EARTH_RADIUS_KM + alt;
+        double e = orbit.frozen? orbit.eccentricity : unit(rng) * orbit.eccentricity;
+
+        double inc = 0.0;
+        if (orbit.inclinations[0] < 0.0) {
+            inc = unit(rng) * 100.0;
+        }
+        else if (orbit.inclinations[0] == 0.0) {
+            // Sun-synchronous: the J2 precession matches the mean motion of the Sun
+            inc = std::acos(-std::pow(a / 12352.0, 3.5)) * 360.0 / BENCHMARK_TAU;
+        }
+        else {
+            size_t choices = 0;
+            while (choices < 4 && orbit.inclinations[choices] >= 0.0) {
+                choices++;
+            }
+            inc = orbit.inclinations[std::min(choices - 1, size_t(unit(rng) * choices))];
+        }
+
+        double raan = unit(rng) * 360.0;
+        double argp = orbit.frozen? 270.0 : unit(rng) * 360.0;
+        double anomaly = unit(rng) * 360.0;
+        double revsPerDay = std::sqrt(BENCHMARK_MU_KM3_S2 / (a * a * a)) * 86400.0 / BENCHMARK_TAU;
+
+        unsigned int norad = unsigned(i + 1);
+        char designator[16];
+        std::snprintf(designator, sizeof(designator), "%02d%03u%c", year % 100, unsigned(i / 26 % 999 + 1), char('A' + i % 26));
+
+        file << orbit.name << " " << norad << "\n";
+
+        std::snprintf(line, sizeof(line), "1 %05uU %-8s %02d%012.8f  .00000000  00000-0 %s 0 %4u",
+                      norad, designator, year % 100, day, (alt < 2000.0)? " 10000-3" : " 00000+0", unsigned(i % 1000));
+        std::string line1(line);
+        file << line1 << checksum(line1) << "\n";
+
+        std::snprintf(line, sizeof(line), "2 %05u %8.4f %8.4f %07d %8.4f %8.4f %11.8f%5u",
+                      norad, inc, raan, int(e * 1e7 + 0.5), argp, anomaly, revsPerDay, unsigned(i % 100000));
+        std::string line2(line);
+        file << line2 << checksum(line2) << "\n";
+    }
+    return file.good();
+}
+
+size_t Benchmark::getPeakMemory() {
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);         // bytes
+#else
+    return size_t(usage.ru_maxrss) * 1024;  // kilobytes
+#endif
+#endif
+}
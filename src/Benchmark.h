@@ -0,0 +1,88 @@
+//
+//  Benchmark.h
+//  Solar
+//
+//  Frame time benchmark, without openFrameworks.
+//
+//  writeCatalog() synthesizes a TLE file with a plausible mix of orbits:
+//  mostly LEO shells (ISS-like, Starlink-like, sun-synchronous), then
+//  MEO navigation constellations, GEO and a few Molniya orbits. The
+//  elements are deterministic for a given seed, so runs can be compared.
+//
+//  Benchmark times update and draw of every frame after a warm up,
+//  collects the draw calls the renderer counted and writes percentiles,
+//  the peak resident memory and anything added with setInfo() as JSON.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class BenchmarkSeries {
+public:
+    void        add(double _value) { m_values.push_back(_value); }
+    size_t      size() const { return m_values.size(); }
+
+    // Nearest rank, _p in [0, 100]
+    double      percentile(double _p) const;
+    double      mean() const;
+    double      max() const;
+
+    // {"p50":..,"p95":..,"p99":..,"mean":..,"max":..}
+    void        writeJson(std::ostream& _out) const;
+
+protected:
+    std::vector<double> m_values;
+};
+
+class Benchmark {
+public:
+    Benchmark();
+
+    // _frames are recorded after _warmup frames that are not
+    void        setup(size_t _frames, size_t _warmup);
+    bool        isRunning() const { return m_frames > 0; }
+    bool        isDone() const { return isRunning() && m_frame >= m_warmup + m_frames; }
+    // Frames so far and in the whole run, warm up included
+    size_t      getFrame() const { return m_frame; }
+    size_t      getTotalFrames() const { return m_warmup + m_frames; }
+
+    void        beginUpdate();
+    void        endUpdate();
+    void        beginDraw();
+    // Closes the frame, with what the renderer submitted during the draw
+    void        endDraw(size_t _drawCalls, size_t _vertices);
+
+    // Extra top level field, _json already formatted ("\"llvmpipe\"", "12000")
+    void        setInfo(const std::string& _key, const std::string& _json) { m_info[_key] = _json; }
+    void        writeJson(std::ostream& _out) const;
+
+    // _objects synthetic TLEs at epoch _jd into _path
+    static bool     writeCatalog(const std::string& _path, size_t _objects, double _jd, unsigned int _seed);
+    // Resident set high-water mark of the process, bytes (0 when unknown)
+    static size_t   getPeakMemory();
+
+protected:
+    typedef std::chrono::steady_clock Clock;
+
+    bool        isRecording() const { return m_frame >= m_warmup && !isDone(); }
+
+    size_t      m_frames;
+    size_t      m_warmup;
+    size_t      m_frame;
+    Clock::time_point m_updateStart;
+    Clock::time_point m_drawStart;
+    double      m_updateMs;
+
+    BenchmarkSeries m_update;
+    BenchmarkSeries m_draw;
+    BenchmarkSeries m_frameTotal;
+    BenchmarkSeries m_drawCalls;
+    BenchmarkSeries m_vertices;
+    std::map<std::string, std::string> m_info;
+};
@@ -0,0 +1,61 @@
+//
+//  BoundedQueue.h
+//  Solar
+//
+//  Fixed capacity multi-producer / multi-consumer queue. Producers block
+//  while it is full, so a fast stage can never run ahead of a slow one by
+//  more than the capacity and memory stays flat however long the stream.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t _capacity) : m_capacity(_capacity > 0? _capacity : 1), m_closed(false) {}
+
+    // Blocks while full. Returns false (and drops _item) once the queue is closed
+    bool push(T _item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this]() { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(_item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while empty. Returns false once the queue is closed and drained
+    bool pop(T& _item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this]() { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) {
+            return false;
+        }
+        _item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    // Wakes everyone up; items already queued can still be popped
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+private:
+    std::mutex              m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+    std::deque<T>           m_items;
+    size_t                  m_capacity;
+    bool                    m_closed;
+};
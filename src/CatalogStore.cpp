@@ -0,0 +1,200 @@
+//
+//  CatalogStore.cpp
+//  Solar
+//
+
+#include "CatalogStore.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace {
+
+// FNV-1a
+uint64_t hashText(const std::string& _text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < _text.size(); i++) {
+        hash ^= uint64_t((unsigned char)_text[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string trim(const std::string& _text) {
+    size_t begin = _text.find_first_not_of(' ');
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = _text.find_last_not_of(' ');
+    return _text.substr(begin, end - begin + 1);
+}
+
+template<typename A>
+size_t capacityBytes(const A& _array) {
+    return _array.capacity() * sizeof(typename A::value_type);
+}
+
+#ifdef __linux__
+// One counter per thread, opened on first use and closed when the thread ends
+struct MissCounter {
+    int fd;
+
+    MissCounter() : fd(-1) {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~MissCounter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+MissCounter& missCounter() {
+    static thread_local MissCounter counter;
+    return counter;
+}
+#endif
+
+}
+
+ArenaRef StringArena::intern(const std::string& _text) {
+    uint64_t hash = hashText(_text);
+    auto range = m_interned.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (equals(it->second, _text)) {
+            return it->second;
+        }
+    }
+
+    ArenaRef ref = store(_text);
+    m_interned.insert(std::make_pair(hash, ref));
+    return ref;
+}
+
+ArenaRef StringArena::store(const std::string& _text) {
+    ArenaRef ref;
+    ref.offset = uint32_t(m_data.size());
+    ref.length = uint32_t(_text.size());
+    m_data.insert(m_data.end(), _text.begin(), _text.end());
+    m_data.push_back('\0');
+    return ref;
+}
+
+bool StringArena::equals(ArenaRef _ref, const std::string& _text) const {
+    return _ref.length == _text.size() && std::memcmp(m_data.data() + _ref.offset, _text.data(), _text.size()) == 0;
+}
+
+void StringArena::clear() {
+    m_data.clear();
+    m_interned.clear();
+}
+
+void StringArena::shrink() {
+    m_data.shrink_to_fit();
+    std::unordered_multimap<uint64_t, ArenaRef>().swap(m_interned);
+}
+
+size_t StringArena::bytes() const {
+    // Buckets and nodes of the intern table, roughly
+    return m_data.capacity() + m_interned.bucket_count() * sizeof(void*) +
+           m_interned.size() * (sizeof(uint64_t) + sizeof(ArenaRef) + 2 * sizeof(void*));
+}
+
+void CatalogMetadata::clear() {
+    m_records.clear();
+    m_arena.clear();
+}
+
+size_t CatalogMetadata::add(unsigned int _norad, const TleText& _tle) {
+    Record record;
+    record.norad = _norad;
+    record.name = m_arena.intern(_tle.name);
+    record.designator = m_arena.intern((_tle.line1.size() >= 17)? trim(_tle.line1.substr(9, 8)) : "");
+    record.line1 = m_arena.store(_tle.line1);
+    record.line2 = m_arena.store(_tle.line2);
+    m_records.push_back(record);
+    return m_records.size() - 1;
+}
+
+void CatalogMetadata::shrink() {
+    m_records.shrink_to_fit();
+    m_arena.shrink();
+}
+
+int CatalogMetadata::find(unsigned int _norad) const {
+    std::vector<Record>::const_iterator it = std::lower_bound(m_records.begin(), m_records.end(), _norad,
+        [](const Record& _record, unsigned int _id) { return _record.norad < _id; });
+    if (it != m_records.end() && it->norad == _norad) {
+        return int(it - m_records.begin());
+    }
+    return -1;
+}
+
+bool CatalogMetadata::same(size_t _index, const TleText& _tle) const {
+    const Record& record = m_records[_index];
+    return  m_arena.equals(record.line1, _tle.line1) &&
+            m_arena.equals(record.line2, _tle.line2) &&
+            m_arena.equals(record.name, _tle.name);
+}
+
+size_t CatalogMetadata::bytes() const {
+    return capacityBytes(m_records) + m_arena.bytes();
+}
+
+void CatalogHot::resize(size_t _total, bool _float) {
+    if (_float) {
+        eciF.resize(_total);
+        HotArray< EquatorialVector<Unit::KM, double> >().swap(eciD);
+    }
+    else {
+        eciD.resize(_total);
+        HotArray< EquatorialVector<Unit::KM, float> >().swap(eciF);
+    }
+    equat.resize(_total);
+    geo.resize(_total);
+    helio.resize(_total);
+    bound.resize(_total);
+    boundRadius.resize(_total);
+    light.resize(_total);
+    magnitude.resize(_total);
+}
+
+size_t CatalogHot::bytes() const {
+    return  capacityBytes(eciF) + capacityBytes(eciD) +
+            capacityBytes(equat) + capacityBytes(geo) + capacityBytes(helio) +
+            capacityBytes(bound) + capacityBytes(boundRadius) +
+            capacityBytes(light) + capacityBytes(magnitude);
+}
+
+bool CacheMisses::available() {
+#ifdef __linux__
+    return missCounter().fd >= 0;
+#else
+    return false;
+#endif
+}
+
+uint64_t CacheMisses::read() {
+#ifdef __linux__
+    MissCounter& counter = missCounter();
+    uint64_t value = 0;
+    if (counter.fd >= 0 && ::read(counter.fd, &value, sizeof(value)) == ssize_t(sizeof(value))) {
+        return value;
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,169 @@
+//
+//  CatalogStore.h
+//  Solar
+//
+//  Catalog storage split by how often it is touched.
+//
+//  Cold metadata (names, international designators, TLE lines) is read a
+//  handful of times per reload, so it is packed into one string arena and
+//  looked up by NORAD id. Identical names ("FENGYUN 1C DEB", ...) are
+//  stored once.
+//
+//  Hot per-tick data (interpolated ECI positions, scene positions,
+//  illumination flags and magnitudes) lives in dense arrays aligned to
+//  cache lines, one entry per object in catalog order, so a tick walks
+//  memory front to back.
+//
+//  CacheMisses reads the hardware counter of the calling thread
+//  (perf_event_open on Linux) to report per-tick misses per object.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "FrameVector.h"
+#include "TleFile.h"
+
+#define STORE_CACHE_LINE    64
+
+template<typename T>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    AlignedAllocator() {}
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t _n) {
+        void* memory = nullptr;
+#ifdef _WIN32
+        memory = _aligned_malloc(_n * sizeof(T), STORE_CACHE_LINE);
+#else
+        if (posix_memalign(&memory, STORE_CACHE_LINE, _n * sizeof(T)) != 0) {
+            memory = nullptr;
+        }
+#endif
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    void deallocate(T* _memory, size_t) {
+#ifdef _WIN32
+        _aligned_free(_memory);
+#else
+        free(_memory);
+#endif
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using HotArray = std::vector<T, AlignedAllocator<T> >;
+
+// A string inside a StringArena
+struct ArenaRef {
+    uint32_t    offset = 0;
+    uint32_t    length = 0;
+};
+
+class StringArena {
+public:
+    // Identical strings share their bytes
+    ArenaRef    intern(const std::string& _text);
+    // Always appended, for strings that never repeat
+    ArenaRef    store(const std::string& _text);
+
+    // Null terminated, valid until the arena changes
+    const char* get(ArenaRef _ref) const { return m_data.data() + _ref.offset; }
+    bool        equals(ArenaRef _ref, const std::string& _text) const;
+
+    void        clear();
+    // Done adding: drops the intern table and the spare capacity
+    void        shrink();
+    size_t      bytes() const;
+
+protected:
+    std::vector<char>                           m_data;
+    std::unordered_multimap<uint64_t, ArenaRef> m_interned;
+};
+
+// Cold side: one record per object, appended in NORAD order
+class CatalogMetadata {
+public:
+    void        clear();
+    void        reserve(size_t _total) { m_records.reserve(_total); }
+    size_t      add(unsigned int _norad, const TleText& _tle);
+    // Once everything is added, gives back the spare capacity
+    void        shrink();
+
+    size_t      size() const { return m_records.size(); }
+    int         find(unsigned int _norad) const;
+
+    unsigned int getNorad(size_t _index) const { return m_records[_index].norad; }
+    const char* getName(size_t _index) const { return m_arena.get(m_records[_index].name); }
+    const char* getDesignator(size_t _index) const { return m_arena.get(m_records[_index].designator); }
+    const char* getLine1(size_t _index) const { return m_arena.get(m_records[_index].line1); }
+    const char* getLine2(size_t _index) const { return m_arena.get(m_records[_index].line2); }
+
+    // Same name and elements as _tle, to tell which objects a reload changed
+    bool        same(size_t _index, const TleText& _tle) const;
+
+    size_t      bytes() const;
+    size_t      getArenaBytes() const { return m_arena.bytes(); }
+
+protected:
+    struct Record {
+        uint32_t    norad;
+        ArenaRef    name;
+        ArenaRef    designator;     // international designator, "98067A"
+        ArenaRef    line1;
+        ArenaRef    line2;
+    };
+
+    std::vector<Record> m_records;
+    StringArena         m_arena;
+};
+
+// Hot side: what every tick reads or writes, in catalog order
+struct CatalogHot {
+    HotArray< EquatorialVector<Unit::KM, float> >  eciF;
+    HotArray< EquatorialVector<Unit::KM, double> > eciD;
+    HotArray<glm::vec3>     equat;
+    HotArray<glm::vec3>     geo;
+    HotArray<glm::vec3>     helio;
+    HotArray<glm::vec3>     bound;      // sphere around marker, tether and label (ofxSatellite::getBounds)
+    HotArray<float>         boundRadius;
+    HotArray<uint8_t>       light;      // ILLUMINATION_* flags
+    HotArray<float>         magnitude;
+
+    // Filled by the tick, from every thread that worked on it
+    std::atomic<uint64_t>   misses{0};
+
+    // Positions of the precision in use only, the other array is released
+    void        resize(size_t _total, bool _float);
+    size_t      size() const { return light.size(); }
+    size_t      bytes() const;
+};
+
+class CacheMisses {
+public:
+    // False where the counter can not be opened (other systems, perf_event_paranoid)
+    static bool     available();
+    // Cache misses of the calling thread so far, 0 when not available
+    static uint64_t read();
+};
@@ -0,0 +1,224 @@
+//
+//  CoverageMap.cpp
+//  Solar
+//
+
+#include "CoverageMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "EarthOrientation.h"
+#include "GroundTrack.h"
+#include "SatelliteCache.h"
+
+#define COVERAGE_EARTH_RADIUS_KM    6378.137
+#define COVERAGE_EARTH_FLATTENING   0.0033528106647474805
+#define COVERAGE_DEG_TO_RAD         0.017453292519943295
+#define COVERAGE_PI                 3.141592653589793
+#define COVERAGE_CHUNK_STEPS        32
+#define COVERAGE_SATELLITES_GRAIN   8       // satellites per task, each for a whole chunk
+
+CoverageMap::CoverageMap() :
+    m_jdStart(0.0),
+    m_jdEnd(0.0),
+    m_step(60.0 / 86400.0),
+    m_minElevation(10.0),
+    m_width(0),
+    m_height(0),
+    m_tileRows(8),
+    m_steps(0),
+    m_tests(0) {
+    setGrid(360, 180);
+}
+
+void CoverageMap::setGrid(size_t _width, size_t _height) {
+    m_width = std::max<size_t>(1, _width);
+    m_height = std::max<size_t>(1, _height);
+
+    const double b = 1.0 - COVERAGE_EARTH_FLATTENING;
+    m_rowLat.resize(m_height);
+    m_sites.resize(m_width * m_height);
+    m_ups.resize(m_width * m_height);
+    for (size_t r = 0; r < m_height; r++) {
+        double phi = (90.0 - (r + 0.5) * 180.0 / m_height) * COVERAGE_DEG_TO_RAD;
+        double C = 1.0 / std::sqrt(std::cos(phi) * std::cos(phi) + b * b * std::sin(phi) * std::sin(phi));
+        m_rowLat[r] = phi;
+        for (size_t c = 0; c < m_width; c++) {
+            double lambda = (-180.0 + (c + 0.5) * 360.0 / m_width) * COVERAGE_DEG_TO_RAD;
+            glm::dvec3 up(std::cos(phi) * std::cos(lambda), std::cos(phi) * std::sin(lambda), std::sin(phi));
+            m_ups[r * m_width + c] = up;
+            m_sites[r * m_width + c] = glm::dvec3(up.x * COVERAGE_EARTH_RADIUS_KM * C,
+                                                  up.y * COVERAGE_EARTH_RADIUS_KM * C,
+                                                  up.z * COVERAGE_EARTH_RADIUS_KM * C * b * b);
+        }
+    }
+}
+
+void CoverageMap::setWindow(double _jdStart, double _jdEnd, double _step) {
+    m_jdStart = _jdStart;
+    m_jdEnd = _jdEnd;
+    m_step = _step;
+}
+
+void CoverageMap::setTileRows(size_t _rows) {
+    m_tileRows = std::max<size_t>(1, _rows);
+}
+
+void CoverageMap::locate(size_t _first, size_t _steps, double _jd0, TaskScheduler& _scheduler) {
+    // Earth rotation once per step, shared by every satellite
+    EarthOrientation eop;
+    std::vector<glm::dmat3> rotations(_steps);
+    for (size_t s = 0; s < _steps; s++) {
+        eop.update(_jd0 + (_first + s) * m_step);
+        rotations[s] = eop.getEquatorialToTerrestrial();
+    }
+
+    size_t total = m_satellites.size();
+    m_caps.resize(_steps * total);
+
+    // Each satellite (and its propagator) belongs to one task at a time
+    _scheduler.parallelFor(0, total, COVERAGE_SATELLITES_GRAIN, [&](size_t _begin, size_t _end) {
+        for (size_t i = _begin; i < _end; i++) {
+            for (size_t s = 0; s < _steps; s++) {
+                Cap& cap = m_caps[s * total + i];
+                double jd = _jd0 + (_first + s) * m_step;
+                try {
+                    cap.position = rotations[s] * SatelliteCache::evaluate(m_satellites[i], jd).position;
+                    GroundSample ground = GroundTrack::toGround(cap.position, jd, m_minElevation);
+                    cap.lat = ground.lat * COVERAGE_DEG_TO_RAD;
+                    cap.lng = ground.lng * COVERAGE_DEG_TO_RAD;
+                    cap.radius = ground.footprint / COVERAGE_EARTH_RADIUS_KM;
+                }
+                catch (...) {
+                    cap.radius = -1.0;
+                }
+            }
+        }
+    });
+}
+
+void CoverageMap::accumulate(size_t _tile, size_t _steps, std::vector<unsigned short>& _frames, size_t& _tests) {
+    const size_t cells = m_width * m_height;
+    const size_t total = m_satellites.size();
+    const size_t rowBegin = _tile * m_tileRows;
+    const size_t rowEnd = std::min(rowBegin + m_tileRows, m_height);
+    const double rowSize = COVERAGE_PI / m_height;
+    const double colSize = 2.0 * COVERAGE_PI / m_width;
+    const double sinMin = std::sin(m_minElevation * COVERAGE_DEG_TO_RAD);
+
+    // The tile's band in latitude, padded by a row for cells straddling the cap edge
+    const double bandNorth = m_rowLat[rowBegin] + rowSize;
+    const double bandSouth = m_rowLat[rowEnd - 1] - rowSize;
+
+    for (size_t s = 0; s < _steps; s++) {
+        unsigned short* frame = &_frames[s * cells];
+        for (size_t r = rowBegin; r < rowEnd; r++) {
+            std::fill(frame + r * m_width, frame + (r + 1) * m_width, 0);
+        }
+
+        for (size_t i = 0; i < total; i++) {
+            const Cap& cap = m_caps[s * total + i];
+            if (cap.radius <= 0.0 || cap.lat - cap.radius > bandNorth || cap.lat + cap.radius < bandSouth) {
+                continue;
+            }
+
+            double radius = cap.radius + rowSize;
+            double cosRadius = std::cos(radius);
+            bool polar = std::abs(cap.lat) + radius >= COVERAGE_PI * 0.5;
+
+            for (size_t r = rowBegin; r < rowEnd; r++) {
+                double phi = m_rowLat[r];
+                if (std::abs(phi - cap.lat) > radius) {
+                    continue;
+                }
+
+                // Longitudes of this row inside the cap
+                size_t span = m_width;
+                long first = 0;
+                if (!polar) {
+                    double c = (cosRadius - std::sin(phi) * std::sin(cap.lat)) / (std::cos(phi) * std::cos(cap.lat));
+                    if (c > 1.0) {
+                        continue;
+                    }
+                    if (c > -1.0) {
+                        double half = std::acos(c) + colSize;
+                        first = long(std::floor((cap.lng - half + COVERAGE_PI) / colSize));
+                        span = std::min(m_width, size_t(std::ceil(2.0 * half / colSize)) + 1);
+                    }
+                }
+
+                unsigned short* row = frame + r * m_width;
+                const glm::dvec3* sites = &m_sites[r * m_width];
+                const glm::dvec3* ups = &m_ups[r * m_width];
+                for (size_t k = 0; k < span; k++) {
+                    size_t c = size_t(((first + long(k)) % long(m_width) + long(m_width)) % long(m_width));
+                    glm::dvec3 look = cap.position - sites[c];
+                    if (glm::dot(ups[c], look) >= sinMin * glm::length(look)) {
+                        row[c]++;
+                    }
+                }
+                _tests += span;
+            }
+        }
+
+        // Fold this step into the tile's statistics
+        for (size_t r = rowBegin; r < rowEnd; r++) {
+            for (size_t c = 0; c < m_width; c++) {
+                size_t cell = r * m_width + c;
+                float count = frame[cell];
+                m_mean[cell] += count;
+                m_maximum[cell] = std::max(m_maximum[cell], count);
+                m_coverage[cell] += (count > 0.0f)? 1.0f : 0.0f;
+            }
+        }
+    }
+}
+
+bool CoverageMap::run(TaskScheduler& _scheduler) {
+    m_tests = 0;
+    if (m_step <= 0.0 || m_jdEnd < m_jdStart || m_satellites.empty()) {
+        m_steps = 0;
+        return false;
+    }
+
+    const size_t cells = m_width * m_height;
+    const size_t tiles = (m_height + m_tileRows - 1) / m_tileRows;
+    m_steps = size_t(std::floor((m_jdEnd - m_jdStart) / m_step)) + 1;
+    m_mean.assign(cells, 0.0f);
+    m_maximum.assign(cells, 0.0f);
+    m_coverage.assign(cells, 0.0f);
+
+    std::vector<unsigned short> frames(COVERAGE_CHUNK_STEPS * cells);
+    std::vector<float> counts;
+    std::vector<size_t> tests(tiles, 0);
+
+    for (size_t first = 0; first < m_steps; first += COVERAGE_CHUNK_STEPS) {
+        size_t steps = std::min<size_t>(COVERAGE_CHUNK_STEPS, m_steps - first);
+        locate(first, steps, m_jdStart, _scheduler);
+
+        // Tiles own disjoint rows of every frame and of the statistics
+        _scheduler.parallelFor(0, tiles, 1, [&](size_t _begin, size_t _end) {
+            for (size_t tile = _begin; tile < _end; tile++) {
+                accumulate(tile, steps, frames, tests[tile]);
+            }
+        });
+
+        if (m_callback) {
+            counts.resize(cells);
+            for (size_t s = 0; s < steps; s++) {
+                std::copy(frames.begin() + s * cells, frames.begin() + (s + 1) * cells, counts.begin());
+                m_callback(m_jdStart + (first + s) * m_step, counts);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < cells; i++) {
+        m_mean[i] /= m_steps;
+        m_coverage[i] /= m_steps;
+    }
+    for (size_t i = 0; i < tiles; i++) {
+        m_tests += tests[i];
+    }
+    return true;
+}
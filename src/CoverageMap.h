@@ -0,0 +1,94 @@
+//
+//  CoverageMap.h
+//  Solar
+//
+//  How many catalog satellites each cell of a global latitude/longitude
+//  grid sees above a minimum elevation, step by step over a window.
+//
+//  Instead of testing every cell against every satellite, each satellite
+//  only visits the cells under its footprint cap (a latitude band and the
+//  longitudes it spans there) and runs the exact elevation test on those.
+//  The grid is cut in bands of rows that tasks own, so every tile keeps
+//  its own histogram and nothing is shared while accumulating. Both the
+//  propagation and the tiles run on a TaskScheduler.
+//
+//  Row 0 is the northernmost band and column 0 starts at -180 degrees,
+//  the same layout as the equirectangular earth texture.
+//
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "Astro/src/Satellite.h"
+
+#include "TaskScheduler.h"
+
+class CoverageMap {
+public:
+    CoverageMap();
+
+    void        setGrid(size_t _width, size_t _height);
+    void        setWindow(double _jdStart, double _jdEnd, double _step);
+    void        setMinElevation(double _degrees) { m_minElevation = _degrees; }
+    // Rows per tile
+    void        setTileRows(size_t _rows);
+
+    void        setSatellites(const std::vector<Satellite>& _satellites) { m_satellites = _satellites; }
+
+    // Called for every step with the visible count of each cell, when set
+    typedef std::function<void(double _jd, const std::vector<float>& _counts)> FrameCallback;
+    void        setFrameCallback(const FrameCallback& _callback) { m_callback = _callback; }
+
+    // Runs the whole window, returns false when there was nothing to do
+    bool        run(TaskScheduler& _scheduler);
+
+    size_t      getWidth() const { return m_width; }
+    size_t      getHeight() const { return m_height; }
+    size_t      getSteps() const { return m_steps; }
+
+    // Float rasters, width x height, row major
+    const std::vector<float>& getMean() const { return m_mean; }           // satellites in view on average
+    const std::vector<float>& getMaximum() const { return m_maximum; }     // most satellites in view at once
+    const std::vector<float>& getCoverage() const { return m_coverage; }   // fraction of steps with one or more in view
+
+    // Cell-satellite pairs that went through the exact test, for statistics
+    size_t      getTests() const { return m_tests; }
+
+protected:
+    struct Cap {
+        glm::dvec3  position;   // Earth fixed, km
+        double      lat;        // sub-satellite point, radians
+        double      lng;
+        double      radius;     // footprint central angle, radians
+    };
+
+    void        locate(size_t _first, size_t _steps, double _jd0, TaskScheduler& _scheduler);
+    void        accumulate(size_t _tile, size_t _steps, std::vector<unsigned short>& _frames, size_t& _tests);
+
+    std::vector<Satellite>  m_satellites;
+    std::vector<Cap>        m_caps;         // steps x satellites of the current chunk
+
+    // Per cell geometry, computed once per grid
+    std::vector<double>     m_rowLat;
+    std::vector<glm::dvec3> m_sites;
+    std::vector<glm::dvec3> m_ups;
+
+    std::vector<float>      m_mean;
+    std::vector<float>      m_maximum;
+    std::vector<float>      m_coverage;
+
+    FrameCallback           m_callback;
+
+    double      m_jdStart;
+    double      m_jdEnd;
+    double      m_step;
+    double      m_minElevation;
+    size_t      m_width;
+    size_t      m_height;
+    size_t      m_tileRows;
+    size_t      m_steps;
+    size_t      m_tests;
+};
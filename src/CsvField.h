@@ -0,0 +1,63 @@
+//
+//  CsvField.h
+//  Solar
+//
+//  RFC 4180 fields, shared by the almanac and the ephemeris exporter so
+//  names with commas or quotes survive a round trip through a spreadsheet.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Quoted, with quotes doubled, only when it has to be
+inline void appendCsvField(std::string& _out, const std::string& _text) {
+    if (_text.find_first_of(",\"\r\n") == std::string::npos) {
+        _out += _text;
+        return;
+    }
+    _out += '"';
+    for (size_t i = 0; i < _text.size(); i++) {
+        if (_text[i] == '"') {
+            _out += '"';
+        }
+        _out += _text[i];
+    }
+    _out += '"';
+}
+
+// Splits one record. A trailing CR (CRLF files) is dropped
+inline std::vector<std::string> splitCsvRecord(const std::string& _line) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    size_t end = _line.size();
+    if (end > 0 && _line[end - 1] == '\r') {
+        end--;
+    }
+    for (size_t i = 0; i < end; i++) {
+        char c = _line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < end && _line[i + 1] == '"') {
+                fields.back() += '"';
+                i++;
+            }
+            else if (c == '"') {
+                quoted = false;
+            }
+            else {
+                fields.back() += c;
+            }
+        }
+        else if (c == '"') {
+            quoted = true;
+        }
+        else if (c == ',') {
+            fields.push_back("");
+        }
+        else {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
@@ -0,0 +1,263 @@
+//
+//  EarthOrientation.cpp
+//  Solar
+//
+
+#include "EarthOrientation.h"
+
+#include <cmath>
+
+#define EO_J2000            2451545.0
+#define EO_DEG_TO_RAD       0.017453292519943295
+#define EO_ARCSEC_TO_RAD    4.84813681109536e-6
+#define EO_TAU              6.283185307179586
+
+namespace {
+
+// Multiples of D, M, M', F, Omega and coefficients in 0.0001"
+struct NutationTerm {
+    signed char d, m, mp, f, om;
+    double      psi, psiT;
+    double      eps, epsT;
+};
+
+const NutationTerm NUTATION_TERMS[] = {
+    {  0, 0, 0, 0, 1, -171996, -174.2, 92025,  8.9 },
+    { -2, 0, 0, 2, 2,  -13187,   -1.6,  5736, -3.1 },
+    {  0, 0, 0, 2, 2,   -2274,   -0.2,   977, -0.5 },
+    {  0, 0, 0, 0, 2,    2062,    0.2,  -895,  0.5 },
+    {  0, 1, 0, 0, 0,    1426,   -3.4,    54, -0.1 },
+    {  0, 0, 1, 0, 0,     712,    0.1,    -7,  0.0 },
+    { -2, 1, 0, 2, 2,    -517,    1.2,   224, -0.6 },
+    {  0, 0, 0, 2, 1,    -386,   -0.4,   200,  0.0 },
+    {  0, 0, 1, 2, 2,    -301,    0.0,   129, -0.1 },
+    { -2,-1, 0, 2, 2,     217,   -0.5,   -95,  0.3 },
+    { -2, 0, 1, 0, 0,    -158,    0.0,     0,  0.0 },
+    { -2, 0, 0, 2, 1,     129,    0.1,   -70,  0.0 },
+    {  0, 0,-1, 2, 2,     123,    0.0,   -53,  0.0 },
+    {  2, 0, 0, 0, 0,      63,    0.0,     0,  0.0 },
+    {  0, 0, 1, 0, 1,      63,    0.1,   -33,  0.0 },
+    {  2, 0,-1, 2, 2,     -59,    0.0,    26,  0.0 },
+    {  0, 0,-1, 0, 1,     -58,   -0.1,    32,  0.0 },
+    {  0, 0, 1, 2, 1,     -51,    0.0,    27,  0.0 },
+    { -2, 0, 2, 0, 0,      48,    0.0,     0,  0.0 },
+    {  0, 0,-2, 2, 1,      46,    0.0,   -24,  0.0 },
+    {  2, 0, 0, 2, 2,     -38,    0.0,    16,  0.0 },
+    {  0, 0, 2, 2, 2,     -31,    0.0,    13,  0.0 },
+    {  0, 0, 2, 0, 0,      29,    0.0,     0,  0.0 },
+    { -2, 0, 1, 2, 2,      29,    0.0,   -12,  0.0 },
+    {  0, 0, 0, 2, 0,      26,    0.0,     0,  0.0 },
+    { -2, 0, 0, 2, 0,     -22,    0.0,     0,  0.0 },
+    {  0, 0,-1, 2, 1,      21,    0.0,   -10,  0.0 },
+    {  0, 2, 0, 0, 0,      17,   -0.1,     0,  0.0 },
+    {  2, 0,-1, 0, 1,      16,    0.0,    -8,  0.0 },
+    { -2, 2, 0, 2, 2,     -16,    0.1,     7,  0.0 },
+    {  0, 1, 0, 0, 1,     -15,    0.0,     9,  0.0 },
+    { -2, 0, 1, 0, 1,     -13,    0.0,     7,  0.0 },
+    {  0,-1, 0, 0, 1,     -12,    0.0,     6,  0.0 },
+    {  0, 0, 2,-2, 0,      11,    0.0,     0,  0.0 },
+    {  2, 0,-1, 2, 1,     -10,    0.0,     5,  0.0 },
+    {  2, 0, 1, 2, 2,      -8,    0.0,     3,  0.0 },
+    {  0, 1, 0, 2, 2,       7,    0.0,    -3,  0.0 },
+    { -2, 1, 1, 0, 0,      -7,    0.0,     0,  0.0 },
+    {  0,-1, 0, 2, 2,      -7,    0.0,     3,  0.0 },
+    {  2, 0, 0, 2, 1,      -7,    0.0,     3,  0.0 },
+    {  2, 0, 1, 0, 0,       6,    0.0,     0,  0.0 },
+    { -2, 0, 2, 2, 2,       6,    0.0,    -3,  0.0 },
+    { -2, 0, 1, 2, 1,       6,    0.0,    -3,  0.0 },
+    {  2, 0,-2, 0, 1,      -6,    0.0,     3,  0.0 },
+    {  2, 0, 0, 0, 1,      -6,    0.0,     3,  0.0 },
+    {  0,-1, 1, 0, 0,       5,    0.0,     0,  0.0 },
+    { -2,-1, 0, 2, 1,      -5,    0.0,     3,  0.0 },
+    { -2, 0, 0, 0, 1,      -5,    0.0,     3,  0.0 },
+    {  0, 0, 2, 2, 1,      -5,    0.0,     3,  0.0 },
+    { -2, 0, 2, 0, 1,       4,    0.0,     0,  0.0 },
+    { -2, 1, 0, 2, 1,       4,    0.0,     0,  0.0 },
+    {  0, 0, 1,-2, 0,       4,    0.0,     0,  0.0 },
+    { -1, 0, 1, 0, 0,      -4,    0.0,     0,  0.0 },
+    { -2, 1, 0, 0, 0,      -4,    0.0,     0,  0.0 },
+    {  1, 0, 0, 0, 0,      -4,    0.0,     0,  0.0 },
+    {  0, 0, 1, 2, 0,       3,    0.0,     0,  0.0 },
+    {  0, 0,-2, 2, 2,      -3,    0.0,     0,  0.0 },
+    { -1,-1, 1, 0, 0,      -3,    0.0,     0,  0.0 },
+    {  0, 1, 1, 0, 0,      -3,    0.0,     0,  0.0 },
+    {  0,-1, 1, 2, 2,      -3,    0.0,     0,  0.0 },
+    {  2,-1,-1, 2, 2,      -3,    0.0,     0,  0.0 },
+    {  0, 0, 3, 2, 2,      -3,    0.0,     0,  0.0 },
+    {  2,-1, 0, 2, 2,      -3,    0.0,     0,  0.0 }
+};
+
+const size_t NUTATION_TOTAL = sizeof(NUTATION_TERMS) / sizeof(NUTATION_TERMS[0]);
+
+double polynomial(double _t, double _a, double _b, double _c, double _d) {
+    return _a + _t * (_b + _t * (_c + _t * _d));
+}
+
+}
+
+EarthOrientation::EarthOrientation() :
+    m_jd(0.0),
+    m_gmst(0.0),
+    m_gast(0.0),
+    m_meanObliquity(0.0),
+    m_obliquity(0.0),
+    m_dPsi(0.0),
+    m_dEps(0.0),
+    m_nutationStep(0.5) {
+    m_nodeIndex[0] = m_nodeIndex[1] = -1;
+    m_nodePsi[0] = m_nodePsi[1] = 0.0;
+    m_nodeEps[0] = m_nodeEps[1] = 0.0;
+}
+
+void EarthOrientation::setNutationStep(double _days) {
+    m_nutationStep = _days;
+    m_nodeIndex[0] = m_nodeIndex[1] = -1;
+    m_jd = 0.0;
+}
+
+glm::dmat3 EarthOrientation::rotateX(double _rad) {
+    double c = cos(_rad), s = sin(_rad);
+    return glm::dmat3(  glm::dvec3(1.0, 0.0, 0.0),
+                        glm::dvec3(0.0,   c,   s),
+                        glm::dvec3(0.0,  -s,   c));
+}
+
+glm::dmat3 EarthOrientation::rotateY(double _rad) {
+    double c = cos(_rad), s = sin(_rad);
+    return glm::dmat3(  glm::dvec3(  c, 0.0,  -s),
+                        glm::dvec3(0.0, 1.0, 0.0),
+                        glm::dvec3(  s, 0.0,   c));
+}
+
+glm::dmat3 EarthOrientation::rotateZ(double _rad) {
+    double c = cos(_rad), s = sin(_rad);
+    return glm::dmat3(  glm::dvec3(  c,   s, 0.0),
+                        glm::dvec3( -s,   c, 0.0),
+                        glm::dvec3(0.0, 0.0, 1.0));
+}
+
+void EarthOrientation::nutation(double _jd, double& _dPsi, double& _dEps) {
+    double t = (_jd - EO_J2000) / 36525.0;
+
+    double d    = polynomial(t, 297.85036, 445267.111480, -0.0019142,  1.0 / 189474.0) * EO_DEG_TO_RAD;
+    double m    = polynomial(t, 357.52772,  35999.050340, -0.0001603, -1.0 / 300000.0) * EO_DEG_TO_RAD;
+    double mp   = polynomial(t, 134.96298, 477198.867398,  0.0086972,  1.0 / 56250.0) * EO_DEG_TO_RAD;
+    double f    = polynomial(t,  93.27191, 483202.017538, -0.0036825,  1.0 / 327270.0) * EO_DEG_TO_RAD;
+    double om   = polynomial(t, 125.04452, -1934.136261,   0.0020708,  1.0 / 450000.0) * EO_DEG_TO_RAD;
+
+    double psi = 0.0, eps = 0.0;
+    for (size_t i = 0; i < NUTATION_TOTAL; i++) {
+        const NutationTerm& n = NUTATION_TERMS[i];
+        double arg = n.d * d + n.m * m + n.mp * mp + n.f * f + n.om * om;
+        psi += (n.psi + n.psiT * t) * sin(arg);
+        eps += (n.eps + n.epsT * t) * cos(arg);
+    }
+
+    _dPsi = psi * 0.0001 * EO_ARCSEC_TO_RAD;
+    _dEps = eps * 0.0001 * EO_ARCSEC_TO_RAD;
+}
+
+void EarthOrientation::interpolateNutation(double _jd) {
+    if (m_nutationStep <= 0.0) {
+        nutation(_jd, m_dPsi, m_dEps);
+        return;
+    }
+
+    double x = _jd / m_nutationStep;
+    long index = long(floor(x));
+
+    for (int i = 0; i < 2; i++) {
+        long wanted = index + i;
+        if (m_nodeIndex[i] == wanted) {
+            continue;
+        }
+        // Playing forward the old upper node becomes the new lower one
+        int other = 1 - i;
+        if (m_nodeIndex[other] == wanted) {
+            m_nodePsi[i] = m_nodePsi[other];
+            m_nodeEps[i] = m_nodeEps[other];
+        }
+        else {
+            nutation(wanted * m_nutationStep, m_nodePsi[i], m_nodeEps[i]);
+        }
+        m_nodeIndex[i] = wanted;
+    }
+
+    double pct = x - double(index);
+    m_dPsi = m_nodePsi[0] + (m_nodePsi[1] - m_nodePsi[0]) * pct;
+    m_dEps = m_nodeEps[0] + (m_nodeEps[1] - m_nodeEps[0]) * pct;
+}
+
+void EarthOrientation::update(double _jd) {
+    if (_jd == m_jd) {
+        return;
+    }
+    m_jd = _jd;
+
+    double d = _jd - EO_J2000;
+    double t = d / 36525.0;
+
+    // Meeus 22.2 and 12.4
+    m_meanObliquity = (84381.448 + t * (-46.8150 + t * (-0.00059 + t * 0.001813))) * EO_ARCSEC_TO_RAD;
+    m_gmst = (280.46061837 + 360.98564736629 * d + t * t * (0.000387933 - t / 38710000.0)) * EO_DEG_TO_RAD;
+    m_gmst = fmod(m_gmst, EO_TAU);
+    if (m_gmst < 0.0) {
+        m_gmst += EO_TAU;
+    }
+
+    interpolateNutation(_jd);
+    m_obliquity = m_meanObliquity + m_dEps;
+    m_gast = m_gmst + m_dPsi * cos(m_obliquity);
+
+    // IAU 1976 precession angles (Meeus 21.3)
+    double zeta  = t * (2306.2181 + t * (0.30188 + t * 0.017998)) * EO_ARCSEC_TO_RAD;
+    double z     = t * (2306.2181 + t * (1.09468 + t * 0.018203)) * EO_ARCSEC_TO_RAD;
+    double theta = t * (2004.3109 + t * (-0.42665 - t * 0.041833)) * EO_ARCSEC_TO_RAD;
+
+    m_precession = rotateZ(z) * rotateY(-theta) * rotateZ(zeta);
+    m_nutation = rotateX(m_obliquity) * rotateZ(m_dPsi) * rotateX(-m_meanObliquity);
+    m_eclipticToEquatorial = rotateX(m_obliquity) * rotateZ(m_dPsi);
+    m_equatorialToTerrestrial = rotateZ(-m_gast);
+}
+
+glm::dmat3 EarthOrientation::getEquatorialToHorizontal(double _lng, double _lat) const {
+    double lst = m_gast + _lng * EO_DEG_TO_RAD;
+    double phi = _lat * EO_DEG_TO_RAD;
+    double cl = cos(lst), sl = sin(lst);
+    double cp = cos(phi), sp = sin(phi);
+
+    // Rows are the local East, North and Up axes
+    glm::dvec3 east(-sl, cl, 0.0);
+    glm::dvec3 north(-sp * cl, -sp * sl, cp);
+    glm::dvec3 up(cp * cl, cp * sl, sp);
+    return glm::transpose(glm::dmat3(east, north, up));
+}
+
+void EarthOrientation::toEquatorial(const glm::dvec3* _ecliptic, glm::dvec3* _equatorial, size_t _total) const {
+    const glm::dmat3& m = m_eclipticToEquatorial;
+    for (size_t i = 0; i < _total; i++) {
+        _equatorial[i] = m * _ecliptic[i];
+    }
+}
+
+void EarthOrientation::toTerrestrial(const glm::dvec3* _equatorial, glm::dvec3* _terrestrial, size_t _total) const {
+    const glm::dmat3& m = m_equatorialToTerrestrial;
+    for (size_t i = 0; i < _total; i++) {
+        _terrestrial[i] = m * _equatorial[i];
+    }
+}
+
+void EarthOrientation::toHorizontal(const glm::dvec3* _equatorial, glm::dvec3* _enu, size_t _total, const glm::dmat3& _local) const {
+    for (size_t i = 0; i < _total; i++) {
+        _enu[i] = _local * _equatorial[i];
+    }
+}
+
+void EarthOrientation::toAltAz(const glm::dvec3& _enu, double& _alt, double& _az) {
+    double r = glm::length(_enu);
+    _alt = asin(_enu.z / r);
+    _az = atan2(_enu.x, _enu.y);
+    if (_az < 0.0) {
+        _az += EO_TAU;
+    }
+}
@@ -0,0 +1,100 @@
+//
+//  EarthOrientation.h
+//  Solar
+//
+//  Sidereal time, obliquity, nutation and precession computed once per JD
+//  and kept as a shared set of rotation matrices, so converting thousands
+//  of positions costs one matrix product each.
+//
+//  Nutation uses the 63 term IAU 1980 series (Meeus, table 22.A). The
+//  series is only evaluated at fixed nodes and linearly interpolated in
+//  between, which stays well under 0.01" for the default half day spacing.
+//
+
+#pragma once
+
+#include <cstddef>
+
+#include "glm/glm.hpp"
+#include "FrameVector.h"
+
+class EarthOrientation {
+public:
+    EarthOrientation();
+
+    // Recomputes everything when _jd changed, otherwise returns right away
+    void        update(double _jd);
+    // Spacing of the interpolated nutation nodes, 0 evaluates the series every time
+    void        setNutationStep(double _days);
+
+    double      getJD() const { return m_jd; }
+
+    // Radians
+    double      getGMST() const { return m_gmst; }
+    double      getGAST() const { return m_gast; }
+    double      getMeanObliquity() const { return m_meanObliquity; }
+    double      getObliquity() const { return m_obliquity; }
+    double      getNutationLongitude() const { return m_dPsi; }
+    double      getNutationObliquity() const { return m_dEps; }
+
+    // Vernal equinox direction in true equatorial coordinates of date
+    glm::dvec3  getEquinox() const { return m_eclipticToEquatorial[0]; }
+
+    // Mean ecliptic of date -> true equator of date
+    const glm::dmat3& getEclipticToEquatorial() const { return m_eclipticToEquatorial; }
+    // J2000 mean equator -> mean equator of date
+    const glm::dmat3& getPrecession() const { return m_precession; }
+    // Mean equator of date -> true equator of date
+    const glm::dmat3& getNutation() const { return m_nutation; }
+    // True equator of date -> Earth fixed (rotated by GAST)
+    const glm::dmat3& getEquatorialToTerrestrial() const { return m_equatorialToTerrestrial; }
+
+    // True equator of date -> local East/North/Up for an observer (degrees)
+    glm::dmat3  getEquatorialToHorizontal(double _lng, double _lat) const;
+
+    glm::dvec3  toEquatorial(const glm::dvec3& _ecliptic) const { return m_eclipticToEquatorial * _ecliptic; }
+
+    template<Unit U, typename T>
+    EquatorialVector<U, T> toEquatorial(const GeoVector<U, T>& _ecliptic) const {
+        return rotateFrame<Frame::EQUATORIAL>(m_eclipticToEquatorial, _ecliptic);
+    }
+    template<Unit U, typename T>
+    GeoVector<U, T> toEcliptic(const EquatorialVector<U, T>& _equatorial) const {
+        return rotateFrame<Frame::GEOCENTRIC>(glm::transpose(m_eclipticToEquatorial), _equatorial);
+    }
+    void        toEquatorial(const glm::dvec3* _ecliptic, glm::dvec3* _equatorial, size_t _total) const;
+    void        toTerrestrial(const glm::dvec3* _equatorial, glm::dvec3* _terrestrial, size_t _total) const;
+    void        toHorizontal(const glm::dvec3* _equatorial, glm::dvec3* _enu, size_t _total, const glm::dmat3& _local) const;
+
+    // Altitude and azimuth (from North through East) in radians of an East/North/Up vector
+    static void toAltAz(const glm::dvec3& _enu, double& _alt, double& _az);
+
+    static glm::dmat3 rotateX(double _rad);
+    static glm::dmat3 rotateY(double _rad);
+    static glm::dmat3 rotateZ(double _rad);
+
+    // Direct evaluation of the series, in radians
+    static void nutation(double _jd, double& _dPsi, double& _dEps);
+
+protected:
+    void        interpolateNutation(double _jd);
+
+    glm::dmat3  m_eclipticToEquatorial;
+    glm::dmat3  m_precession;
+    glm::dmat3  m_nutation;
+    glm::dmat3  m_equatorialToTerrestrial;
+
+    double      m_jd;
+    double      m_gmst;
+    double      m_gast;
+    double      m_meanObliquity;
+    double      m_obliquity;
+    double      m_dPsi;
+    double      m_dEps;
+
+    // Nutation nodes currently bracketing m_jd
+    double      m_nutationStep;
+    long        m_nodeIndex[2];
+    double      m_nodePsi[2];
+    double      m_nodeEps[2];
+};
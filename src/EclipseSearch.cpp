@@ -0,0 +1,483 @@
+//
+//  EclipseSearch.cpp
+//  Solar
+//
+
+#include "EclipseSearch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+#include "Astro/src/Body.h"
+
+#include "EarthOrientation.h"
+#include "FrameVector.h"
+
+#define ECLIPSE_SUN_RADIUS_KM       696000.0
+#define ECLIPSE_MOON_RADIUS_KM      1737.4
+#define ECLIPSE_EARTH_RADIUS_KM     6378.137
+#define ECLIPSE_EARTH_FLATTENING    0.0033528106647474805
+#define ECLIPSE_EARTH_SHADOW        (1.0 + 1.0 / 85.0)      // Danjon's atmospheric enlargement
+#define ECLIPSE_EARTH_SHADOW_RADIUS 0.998340                // Earth radius at 45deg, for the shadow
+#define ECLIPSE_NODE_LIMIT          0.40                    // |sin F| above this can't eclipse (Meeus uses 0.36)
+#define ECLIPSE_SEARCH_SPAN         1.0                     // days around the mean phase to find greatest eclipse
+#define ECLIPSE_CONTACT_STEP        0.01                    // days, bracket step for contacts
+#define ECLIPSE_CONTACT_SPAN        0.5                     // days, farthest contact from greatest eclipse
+#define ECLIPSE_SYNODIC_MONTH       29.530588861
+#define ECLIPSE_DEG_TO_RAD          0.017453292519943295
+#define ECLIPSE_RAD_TO_DEG          57.29577951308232
+#define ECLIPSE_PI                  3.141592653589793
+
+namespace {
+
+// Sun, Moon and Earth orientation for one thread, evaluated at a UT JD
+struct Syzygy {
+    Observer            obs;
+    Body                sun;
+    Body                moon;
+    EarthOrientation    eop;
+    glm::dvec3          S;      // geocentric true equatorial of date, km
+    glm::dvec3          M;
+
+    Syzygy() : sun(SUN), moon(LUNA) {}
+
+    void at(double _jd) {
+        // Orbits run in dynamical time, the Earth turns in universal time
+        obs.setJD(_jd + EclipseSearch::deltaT(_jd) / 86400.0);
+        sun.compute(obs);
+        moon.compute(obs);
+        eop.update(_jd);
+        S = eop.toEquatorial(GeoVector<Unit::AU>(sun.getEclipticGeocentric().getVector(AU)).to<Unit::KM>()).toDvec3();
+        M = eop.toEquatorial(GeoVector<Unit::AU>(moon.getEclipticGeocentric().getVector(AU)).to<Unit::KM>()).toDvec3();
+    }
+};
+
+// Moon's shadow on the fundamental plane through the Earth's center
+struct MoonShadow {
+    double  p;      // Earth center to shadow axis, km
+    double  L;      // Moon to fundamental plane along the axis, km
+    double  l1;     // penumbra radius on the plane, km
+    double  l2;     // umbra radius on the plane, km (negative: antumbra)
+    double  tanU;
+
+    MoonShadow(const glm::dvec3& _S, const glm::dvec3& _M) {
+        glm::dvec3 axis = _M - _S;
+        double D = glm::length(axis);
+        axis = axis * (1.0 / D);
+        double fp = std::asin((ECLIPSE_SUN_RADIUS_KM + ECLIPSE_MOON_RADIUS_KM) / D);
+        double fu = std::asin((ECLIPSE_SUN_RADIUS_KM - ECLIPSE_MOON_RADIUS_KM) / D);
+        glm::dvec3 E = -_M;
+        L = glm::dot(E, axis);
+        p = glm::length(E - axis * L);
+        tanU = std::tan(fu);
+        l1 = ECLIPSE_MOON_RADIUS_KM / std::cos(fp) + L * std::tan(fp);
+        l2 = ECLIPSE_MOON_RADIUS_KM / std::cos(fu) - L * tanU;
+    }
+
+    // Umbra radius where the axis meets the surface (only meaningful when p < R)
+    double surfaceUmbra() const {
+        double h = std::sqrt(std::max(0.0, ECLIPSE_EARTH_RADIUS_KM * ECLIPSE_EARTH_RADIUS_KM - p * p));
+        return l2 + h * tanU;
+    }
+};
+
+// Earth's shadow at the distance of the Moon
+struct EarthShadow {
+    double  p;      // Moon center to shadow axis, km
+    double  umbra;  // radii at the Moon, km
+    double  penumbra;
+
+    EarthShadow(const glm::dvec3& _S, const glm::dvec3& _M) {
+        double ds = glm::length(_S);
+        glm::dvec3 axis = -_S / ds;
+        double re = ECLIPSE_EARTH_RADIUS_KM * ECLIPSE_EARTH_SHADOW_RADIUS;
+        double fp = std::asin((ECLIPSE_SUN_RADIUS_KM + re) / ds);
+        double fu = std::asin((ECLIPSE_SUN_RADIUS_KM - re) / ds);
+        double L = glm::dot(_M, axis);
+        p = glm::length(_M - axis * L);
+        umbra = (re / std::cos(fu) - L * std::tan(fu)) * ECLIPSE_EARTH_SHADOW;
+        penumbra = (re / std::cos(fp) + L * std::tan(fp)) * ECLIPSE_EARTH_SHADOW;
+    }
+};
+
+// Golden section search for the minimum of _f in [_a, _b]
+double minimize(const std::function<double(double)>& _f, double _a, double _b, double _tolerance = 1e-7) {
+    const double r = 0.6180339887498949;
+    double c = _b - (_b - _a) * r;
+    double d = _a + (_b - _a) * r;
+    double fc = _f(c);
+    double fd = _f(d);
+    while (_b - _a > _tolerance) {
+        if (fc < fd) {
+            _b = d; d = c; fd = fc;
+            c = _b - (_b - _a) * r;
+            fc = _f(c);
+        }
+        else {
+            _a = c; c = d; fc = fd;
+            d = _a + (_b - _a) * r;
+            fd = _f(d);
+        }
+    }
+    return (_a + _b) * 0.5;
+}
+
+// First root of _f walking from _t (where _f < 0) in _direction, 0.0 if none
+// within _span days
+double contact(const std::function<double(double)>& _f, double _t, double _direction, double _span) {
+    double a = _t;
+    double fa = _f(a);
+    if (fa >= 0.0) {
+        return 0.0;
+    }
+    for (double walked = ECLIPSE_CONTACT_STEP; walked <= _span + 1e-9; walked += ECLIPSE_CONTACT_STEP) {
+        double b = _t + _direction * walked;
+        double fb = _f(b);
+        if (fb >= 0.0) {
+            // Bisect down to ~0.01s
+            for (int i = 0; i < 24 && std::abs(b - a) > 1e-7; i++) {
+                double m = (a + b) * 0.5;
+                if (_f(m) < 0.0) {
+                    a = m;
+                }
+                else {
+                    b = m;
+                }
+            }
+            return (a + b) * 0.5;
+        }
+        a = b;
+    }
+    return 0.0;
+}
+
+// Area of the Sun's disk (radius _s) covered by the Moon's (radius _m) at separation _d
+double obscuration(double _s, double _m, double _d) {
+    if (_d >= _s + _m) {
+        return 0.0;
+    }
+    if (_d <= std::abs(_s - _m)) {
+        return std::min(1.0, (_m * _m) / (_s * _s));
+    }
+    double a = std::acos((_d * _d + _s * _s - _m * _m) / (2.0 * _d * _s));
+    double b = std::acos((_d * _d + _m * _m - _s * _s) / (2.0 * _d * _m));
+    double area = _s * _s * (a - std::sin(2.0 * a) * 0.5) + _m * _m * (b - std::sin(2.0 * b) * 0.5);
+    return area / (ECLIPSE_PI * _s * _s);
+}
+
+}
+
+std::string Eclipse::getTypeName() const {
+    switch (type) {
+        case EclipseType::PENUMBRAL:    return "penumbral";
+        case EclipseType::PARTIAL:      return "partial";
+        case EclipseType::ANNULAR:      return "annular";
+        case EclipseType::TOTAL:        return "total";
+        default:                        return "none";
+    }
+}
+
+EclipseSearch::EclipseSearch() :
+    m_lng(0.0),
+    m_lat(0.0),
+    m_altitude(0.0),
+    m_threads(std::max(1u, std::thread::hardware_concurrency())),
+    m_solar(true),
+    m_lunar(true),
+    m_candidates(0) {
+}
+
+void EclipseSearch::setObserver(double _lng, double _lat, double _altitude) {
+    m_lng = _lng;
+    m_lat = _lat;
+    m_altitude = _altitude;
+}
+
+void EclipseSearch::setThreads(unsigned int _threads) {
+    m_threads = std::max(1u, _threads);
+}
+
+double EclipseSearch::deltaT(double _jd) {
+    double y = 2000.0 + (_jd - 2451544.5) / 365.2425;
+    double u, t;
+
+    if (y < -500.0 || y >= 2150.0) {
+        u = (y - 1820.0) / 100.0;
+        return -20.0 + 32.0 * u * u;
+    }
+    else if (y < 500.0) {
+        u = y / 100.0;
+        return 10583.6 + u * (-1014.41 + u * (33.78311 + u * (-5.952053 + u * (-0.1798452 + u * (0.022174192 + u * 0.0090316521)))));
+    }
+    else if (y < 1600.0) {
+        u = (y - 1000.0) / 100.0;
+        return 1574.2 + u * (-556.01 + u * (71.23472 + u * (0.319781 + u * (-0.8503463 + u * (-0.005050998 + u * 0.0083572073)))));
+    }
+    else if (y < 1700.0) {
+        t = y - 1600.0;
+        return 120.0 + t * (-0.9808 + t * (-0.01532 + t / 7129.0));
+    }
+    else if (y < 1800.0) {
+        t = y - 1700.0;
+        return 8.83 + t * (0.1603 + t * (-0.0059285 + t * (0.00013336 - t / 1174000.0)));
+    }
+    else if (y < 1860.0) {
+        t = y - 1800.0;
+        return 13.72 + t * (-0.332447 + t * (0.0068612 + t * (0.0041116 + t * (-0.00037436 + t * (0.0000121272 + t * (-0.0000001699 + t * 0.000000000875))))));
+    }
+    else if (y < 1900.0) {
+        t = y - 1860.0;
+        return 7.62 + t * (0.5737 + t * (-0.251754 + t * (0.01680668 + t * (-0.0004473624 + t / 233174.0))));
+    }
+    else if (y < 1920.0) {
+        t = y - 1900.0;
+        return -2.79 + t * (1.494119 + t * (-0.0598939 + t * (0.0061966 - t * 0.000197)));
+    }
+    else if (y < 1941.0) {
+        t = y - 1920.0;
+        return 21.20 + t * (0.84493 + t * (-0.076100 + t * 0.0020936));
+    }
+    else if (y < 1961.0) {
+        t = y - 1950.0;
+        return 29.07 + t * (0.407 + t * (-1.0 / 233.0 + t / 2547.0));
+    }
+    else if (y < 1986.0) {
+        t = y - 1975.0;
+        return 45.45 + t * (1.067 + t * (-1.0 / 260.0 - t / 718.0));
+    }
+    else if (y < 2005.0) {
+        t = y - 2000.0;
+        return 63.86 + t * (0.3345 + t * (-0.060374 + t * (0.0017275 + t * (0.000651814 + t * 0.00002373599))));
+    }
+    else if (y < 2050.0) {
+        t = y - 2000.0;
+        return 62.92 + t * (0.32217 + t * 0.005589);
+    }
+    u = (y - 1820.0) / 100.0;
+    return -20.0 + 32.0 * u * u - 0.5628 * (2150.0 - y);
+}
+
+double EclipseSearch::meanPhase(double _k, double& _F) {
+    double T = _k / 1236.85;
+    double T2 = T * T;
+    _F = (160.7108 + 390.67050284 * _k - 0.0016118 * T2 - 0.00000227 * T2 * T + 0.000000011 * T2 * T2) * ECLIPSE_DEG_TO_RAD;
+    return 2451550.09766 + ECLIPSE_SYNODIC_MONTH * _k + 0.00015437 * T2 - 0.000000150 * T2 * T + 0.00000000073 * T2 * T2;
+}
+
+bool EclipseSearch::compute(long _k, double _phase, Eclipse& _eclipse) const {
+    double F;
+    double jde = meanPhase(_k + _phase, F);
+    if (std::abs(std::sin(F)) > ECLIPSE_NODE_LIMIT) {
+        return false;
+    }
+    double jd = jde - deltaT(jde) / 86400.0;
+
+    Syzygy sz;
+    _eclipse = Eclipse();
+    _eclipse.lunation = _k;
+
+    if (_phase < 0.25) {
+        // SOLAR
+        // ------------------------------------------------------------------
+        _eclipse.kind = EclipseKind::SOLAR;
+        auto axis = [&](double _t) { sz.at(_t); return MoonShadow(sz.S, sz.M).p; };
+        double greatest = minimize(axis, jd - ECLIPSE_SEARCH_SPAN, jd + ECLIPSE_SEARCH_SPAN);
+
+        sz.at(greatest);
+        MoonShadow shadow(sz.S, sz.M);
+        if (shadow.p >= ECLIPSE_EARTH_RADIUS_KM + shadow.l1) {
+            return false;
+        }
+
+        _eclipse.greatest = greatest;
+        _eclipse.gamma = shadow.p / ECLIPSE_EARTH_RADIUS_KM;
+        if (shadow.p < ECLIPSE_EARTH_RADIUS_KM) {
+            // Central: what the point under the axis sees decides total or annular
+            double umbra = shadow.surfaceUmbra();
+            double h = std::sqrt(ECLIPSE_EARTH_RADIUS_KM * ECLIPSE_EARTH_RADIUS_KM - shadow.p * shadow.p);
+            double toMoon = shadow.L - h;
+            double toSun = toMoon + glm::length(sz.M - sz.S);
+            _eclipse.type = (umbra > 0.0)? EclipseType::TOTAL : EclipseType::ANNULAR;
+            _eclipse.magnitude = (ECLIPSE_MOON_RADIUS_KM / toMoon) / (ECLIPSE_SUN_RADIUS_KM / toSun);
+        }
+        else if (shadow.p < ECLIPSE_EARTH_RADIUS_KM + std::abs(shadow.l2)) {
+            // Non central: the shadow cone only grazes the limb
+            _eclipse.type = (shadow.l2 > 0.0)? EclipseType::TOTAL : EclipseType::ANNULAR;
+            _eclipse.magnitude = (shadow.l1 - (shadow.p - ECLIPSE_EARTH_RADIUS_KM)) / (shadow.l1 + shadow.l2);
+        }
+        else {
+            _eclipse.type = EclipseType::PARTIAL;
+            _eclipse.magnitude = (shadow.l1 - (shadow.p - ECLIPSE_EARTH_RADIUS_KM)) / (shadow.l1 + shadow.l2);
+        }
+        _eclipse.penumbralMagnitude = _eclipse.magnitude;
+
+        auto penumbra = [&](double _t) { sz.at(_t); MoonShadow s(sz.S, sz.M); return s.p - (ECLIPSE_EARTH_RADIUS_KM + s.l1); };
+        _eclipse.p1 = contact(penumbra, greatest, -1.0, ECLIPSE_CONTACT_SPAN);
+        _eclipse.p4 = contact(penumbra, greatest, 1.0, ECLIPSE_CONTACT_SPAN);
+        if (_eclipse.type != EclipseType::PARTIAL) {
+            auto umbra = [&](double _t) { sz.at(_t); MoonShadow s(sz.S, sz.M); return s.p - (ECLIPSE_EARTH_RADIUS_KM + std::abs(s.l2)); };
+            _eclipse.u1 = contact(umbra, greatest, -1.0, ECLIPSE_CONTACT_SPAN);
+            _eclipse.u4 = contact(umbra, greatest, 1.0, ECLIPSE_CONTACT_SPAN);
+        }
+
+        // LOCAL CIRCUMSTANCES
+        // ------------------------------------------------------------------
+        double phi = m_lat * ECLIPSE_DEG_TO_RAD;
+        double lambda = m_lng * ECLIPSE_DEG_TO_RAD;
+        double b = 1.0 - ECLIPSE_EARTH_FLATTENING;
+        double C = 1.0 / std::sqrt(std::cos(phi) * std::cos(phi) + b * b * std::sin(phi) * std::sin(phi));
+        double alt = m_altitude / 1000.0;
+        glm::dvec3 site((ECLIPSE_EARTH_RADIUS_KM * C + alt) * std::cos(phi) * std::cos(lambda),
+                        (ECLIPSE_EARTH_RADIUS_KM * C + alt) * std::cos(phi) * std::sin(lambda),
+                        (ECLIPSE_EARTH_RADIUS_KM * C * b * b + alt) * std::sin(phi));
+
+        // Separation and apparent radii of the Sun and the Moon seen from the site
+        double as = 0.0, am = 0.0;
+        auto separation = [&](double _t) {
+            sz.at(_t);
+            glm::dvec3 o = glm::transpose(sz.eop.getEquatorialToTerrestrial()) * site;
+            glm::dvec3 s = sz.S - o;
+            glm::dvec3 m = sz.M - o;
+            as = std::asin(ECLIPSE_SUN_RADIUS_KM / glm::length(s));
+            am = std::asin(ECLIPSE_MOON_RADIUS_KM / glm::length(m));
+            return std::atan2(glm::length(glm::cross(s, m)), glm::dot(s, m));
+        };
+
+        double start = (_eclipse.p1 > 0.0)? _eclipse.p1 : greatest - ECLIPSE_CONTACT_SPAN;
+        double end = (_eclipse.p4 > 0.0)? _eclipse.p4 : greatest + ECLIPSE_CONTACT_SPAN;
+        double maximum = minimize(separation, start, end);
+        double theta = separation(maximum);
+
+        EclipseLocal& local = _eclipse.local;
+        if (theta < as + am) {
+            local.maximum = maximum;
+            local.magnitude = (as + am - theta) / (2.0 * as);
+            local.obscuration = obscuration(as, am, theta);
+            if (theta < std::abs(as - am)) {
+                local.type = (am > as)? EclipseType::TOTAL : EclipseType::ANNULAR;
+            }
+            else {
+                local.type = EclipseType::PARTIAL;
+            }
+
+            glm::dvec3 enu = sz.eop.getEquatorialToHorizontal(m_lng, m_lat) * glm::normalize(sz.S);
+            double sunAlt, sunAz;
+            EarthOrientation::toAltAz(enu, sunAlt, sunAz);
+            local.sunAltitude = sunAlt * ECLIPSE_RAD_TO_DEG;
+            local.sunAzimuth = sunAz * ECLIPSE_RAD_TO_DEG;
+
+            auto outer = [&](double _t) { double d = separation(_t); return d - (as + am); };
+            local.c1 = contact(outer, maximum, -1.0, ECLIPSE_CONTACT_SPAN);
+            local.c4 = contact(outer, maximum, 1.0, ECLIPSE_CONTACT_SPAN);
+            if (local.type != EclipseType::PARTIAL) {
+                auto inner = [&](double _t) { double d = separation(_t); return d - std::abs(as - am); };
+                local.c2 = contact(inner, maximum, -1.0, ECLIPSE_CONTACT_SPAN);
+                local.c3 = contact(inner, maximum, 1.0, ECLIPSE_CONTACT_SPAN);
+            }
+        }
+    }
+    else {
+        // LUNAR
+        // ------------------------------------------------------------------
+        _eclipse.kind = EclipseKind::LUNAR;
+        auto axis = [&](double _t) { sz.at(_t); return EarthShadow(sz.S, sz.M).p; };
+        double greatest = minimize(axis, jd - ECLIPSE_SEARCH_SPAN, jd + ECLIPSE_SEARCH_SPAN);
+
+        sz.at(greatest);
+        EarthShadow shadow(sz.S, sz.M);
+        double umbral = (shadow.umbra + ECLIPSE_MOON_RADIUS_KM - shadow.p) / (2.0 * ECLIPSE_MOON_RADIUS_KM);
+        double penumbral = (shadow.penumbra + ECLIPSE_MOON_RADIUS_KM - shadow.p) / (2.0 * ECLIPSE_MOON_RADIUS_KM);
+        if (penumbral <= 0.0) {
+            return false;
+        }
+
+        _eclipse.greatest = greatest;
+        _eclipse.gamma = shadow.p / ECLIPSE_EARTH_RADIUS_KM;
+        _eclipse.magnitude = umbral;
+        _eclipse.penumbralMagnitude = penumbral;
+        if (umbral >= 1.0) {
+            _eclipse.type = EclipseType::TOTAL;
+        }
+        else if (umbral > 0.0) {
+            _eclipse.type = EclipseType::PARTIAL;
+        }
+        else {
+            _eclipse.type = EclipseType::PENUMBRAL;
+        }
+
+        auto penumbra = [&](double _t) { sz.at(_t); EarthShadow s(sz.S, sz.M); return s.p - (s.penumbra + ECLIPSE_MOON_RADIUS_KM); };
+        _eclipse.p1 = contact(penumbra, greatest, -1.0, ECLIPSE_CONTACT_SPAN);
+        _eclipse.p4 = contact(penumbra, greatest, 1.0, ECLIPSE_CONTACT_SPAN);
+        if (_eclipse.type != EclipseType::PENUMBRAL) {
+            auto umbra = [&](double _t) { sz.at(_t); EarthShadow s(sz.S, sz.M); return s.p - (s.umbra + ECLIPSE_MOON_RADIUS_KM); };
+            _eclipse.u1 = contact(umbra, greatest, -1.0, ECLIPSE_CONTACT_SPAN);
+            _eclipse.u4 = contact(umbra, greatest, 1.0, ECLIPSE_CONTACT_SPAN);
+        }
+        if (_eclipse.type == EclipseType::TOTAL) {
+            auto totality = [&](double _t) { sz.at(_t); EarthShadow s(sz.S, sz.M); return s.p - (s.umbra - ECLIPSE_MOON_RADIUS_KM); };
+            _eclipse.u2 = contact(totality, greatest, -1.0, ECLIPSE_CONTACT_SPAN);
+            _eclipse.u3 = contact(totality, greatest, 1.0, ECLIPSE_CONTACT_SPAN);
+        }
+    }
+
+    return true;
+}
+
+void EclipseSearch::work(   const std::vector< std::pair<long, double> >& _lunations,
+                            std::atomic<size_t>& _next, std::vector<Eclipse>& _out) const {
+    Eclipse eclipse;
+    for (size_t i = _next++; i < _lunations.size(); i = _next++) {
+        if (compute(_lunations[i].first, _lunations[i].second, eclipse)) {
+            _out.push_back(eclipse);
+        }
+    }
+}
+
+std::vector<Eclipse> EclipseSearch::search(double _jdStart, double _jdEnd) {
+    // Only lunations close enough to a node are worth handing to a thread
+    std::vector< std::pair<long, double> > lunations;
+    long first = long(std::floor((_jdStart - 2451550.09766) / ECLIPSE_SYNODIC_MONTH)) - 1;
+    long last = long(std::ceil((_jdEnd - 2451550.09766) / ECLIPSE_SYNODIC_MONTH)) + 1;
+    for (long k = first; k <= last; k++) {
+        double F;
+        if (m_solar) {
+            meanPhase(k, F);
+            if (std::abs(std::sin(F)) <= ECLIPSE_NODE_LIMIT) {
+                lunations.push_back(std::make_pair(k, 0.0));
+            }
+        }
+        if (m_lunar) {
+            meanPhase(k + 0.5, F);
+            if (std::abs(std::sin(F)) <= ECLIPSE_NODE_LIMIT) {
+                lunations.push_back(std::make_pair(k, 0.5));
+            }
+        }
+    }
+    m_candidates = lunations.size();
+
+    std::atomic<size_t> next(0);
+    unsigned int threads = std::max(1u, std::min<unsigned int>(m_threads, lunations.size()));
+    std::vector< std::vector<Eclipse> > partial(threads);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threads; i++) {
+        workers.push_back(std::thread(&EclipseSearch::work, this, std::cref(lunations), std::ref(next), std::ref(partial[i])));
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    std::vector<Eclipse> eclipses;
+    for (size_t i = 0; i < partial.size(); i++) {
+        for (size_t j = 0; j < partial[i].size(); j++) {
+            if (partial[i][j].greatest >= _jdStart && partial[i][j].greatest < _jdEnd) {
+                eclipses.push_back(partial[i][j]);
+            }
+        }
+    }
+    std::sort(eclipses.begin(), eclipses.end(), [](const Eclipse& _a, const Eclipse& _b) {
+        return _a.greatest < _b.greatest;
+    });
+    return eclipses;
+}
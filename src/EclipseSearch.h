@@ -0,0 +1,111 @@
+//
+//  EclipseSearch.h
+//  Solar
+//
+//  Finds solar and lunar eclipses over any range of years. Mean new and
+//  full moons (Meeus, ch. 49) close enough to a lunar node are refined to
+//  the true syzygy and to the instant of greatest eclipse, then classified
+//  from the shadow cones of the Moon and the Earth. Lunations are handed
+//  out to worker threads, each with its own bodies and Earth orientation.
+//
+//  Bodies are evaluated in dynamical time (JD + delta T), every time the
+//  search returns is a UT Julian Day like the rest of the app uses.
+//
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+enum class EclipseKind {
+    SOLAR,
+    LUNAR
+};
+
+enum class EclipseType {
+    NONE,
+    PENUMBRAL,      // lunar only
+    PARTIAL,
+    ANNULAR,        // solar only
+    TOTAL
+};
+
+// Observer's view of a solar eclipse. Contacts are 0.0 when they don't happen
+struct EclipseLocal {
+    EclipseType type = EclipseType::NONE;
+    double      c1 = 0.0;
+    double      c2 = 0.0;
+    double      maximum = 0.0;
+    double      c3 = 0.0;
+    double      c4 = 0.0;
+    double      magnitude = 0.0;    // fraction of the Sun's diameter covered
+    double      obscuration = 0.0;  // fraction of the Sun's disk covered
+    double      sunAltitude = 0.0;  // degrees, at maximum
+    double      sunAzimuth = 0.0;   // degrees, at maximum
+
+    bool        visible() const { return type != EclipseType::NONE && sunAltitude > 0.0; }
+};
+
+struct Eclipse {
+    EclipseKind kind;
+    EclipseType type = EclipseType::NONE;
+    long        lunation = 0;       // Meeus k, 0 is the new moon of 2000/01/06
+    double      greatest = 0.0;     // UT JD
+
+    // Solar: P1/P4 penumbra and U1/U4 umbra (or antumbra) touching the Earth.
+    // Lunar: P1/P4 penumbra, U1/U4 umbra, U2/U3 totality. 0.0 when not reached
+    double      p1 = 0.0;
+    double      u1 = 0.0;
+    double      u2 = 0.0;
+    double      u3 = 0.0;
+    double      u4 = 0.0;
+    double      p4 = 0.0;
+
+    double      gamma = 0.0;        // shadow axis to Earth (solar) or Moon (lunar) center, in Earth radii
+    double      magnitude = 0.0;    // solar: Moon/Sun size ratio on the axis; lunar: umbral
+    double      penumbralMagnitude = 0.0;
+
+    EclipseLocal local;             // solar only
+
+    std::string getTypeName() const;
+};
+
+class EclipseSearch {
+public:
+    EclipseSearch();
+
+    // Degrees and meters, used for the local circumstances of solar eclipses
+    void        setObserver(double _lng, double _lat, double _altitude = 0.0);
+    void        setThreads(unsigned int _threads);
+    void        setSolar(bool _solar) { m_solar = _solar; }
+    void        setLunar(bool _lunar) { m_lunar = _lunar; }
+
+    // All eclipses whose greatest instant falls in [_jdStart, _jdEnd), sorted in time
+    std::vector<Eclipse> search(double _jdStart, double _jdEnd);
+
+    // Single lunation: _phase 0.0 for the new moon (solar), 0.5 for the full moon (lunar).
+    // Returns false when there is no eclipse
+    bool        compute(long _k, double _phase, Eclipse& _eclipse) const;
+
+    // Lunations searched by the last call, for progress and statistics
+    size_t      getCandidates() const { return m_candidates; }
+
+    // Terrestrial minus universal time in seconds (Espenak & Meeus polynomials)
+    static double deltaT(double _jd);
+
+    // Meeus 49.1 mean phase (JDE) and the Moon's argument of latitude F (radians)
+    static double meanPhase(double _k, double& _F);
+
+protected:
+    void        work(const std::vector< std::pair<long, double> >& _lunations,
+                     std::atomic<size_t>& _next, std::vector<Eclipse>& _out) const;
+
+    double      m_lng;
+    double      m_lat;
+    double      m_altitude;
+    unsigned int m_threads;
+    bool        m_solar;
+    bool        m_lunar;
+    size_t      m_candidates;
+};
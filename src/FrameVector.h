@@ -0,0 +1,95 @@
+//
+//  FrameVector.h
+//  Solar
+//
+//  3D vectors tagged at compile time with their reference frame and
+//  distance unit. Unit changes are constexpr factors that fold into the
+//  surrounding arithmetic, and adding vectors of different frames or units
+//  does not compile.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+
+enum class Frame {
+    HELIOCENTRIC,   // ecliptic, centered on the Sun
+    GEOCENTRIC,     // ecliptic, centered on the Earth
+    EQUATORIAL,     // true equator of date, centered on the Earth
+    HORIZONTAL      // East/North/Up, centered on the observer
+};
+
+enum class Unit {
+    AU,
+    KM,
+    EARTH_RADII
+};
+
+template<Unit U> struct UnitTraits;
+template<> struct UnitTraits<Unit::AU>          { static constexpr double KM = 149597870.7; };
+template<> struct UnitTraits<Unit::KM>          { static constexpr double KM = 1.0; };
+template<> struct UnitTraits<Unit::EARTH_RADII> { static constexpr double KM = 6378.137; };
+
+template<Unit FROM, Unit TO>
+constexpr double unitFactor() {
+    return UnitTraits<FROM>::KM / UnitTraits<TO>::KM;
+}
+
+template<Frame F, Unit U, typename T = double>
+struct FrameVector {
+    T x, y, z;
+
+    constexpr FrameVector() : x(0), y(0), z(0) {}
+    constexpr FrameVector(T _x, T _y, T _z) : x(_x), y(_y), z(_z) {}
+    template<typename V>
+    explicit FrameVector(const V& _v) : x(T(_v.x)), y(T(_v.y)), z(T(_v.z)) {}
+
+    template<Unit TO>
+    FrameVector<F, TO, T> to() const {
+        const T k = T(unitFactor<U, TO>());
+        return FrameVector<F, TO, T>(x * k, y * k, z * k);
+    }
+
+    template<typename S>
+    FrameVector<F, U, S> as() const { return FrameVector<F, U, S>(S(x), S(y), S(z)); }
+
+    // Scene position, scaled by a render factor
+    glm::vec3   toGlm(float _scale = 1.0f) const { return glm::vec3(float(x) * _scale, float(y) * _scale, float(z) * _scale); }
+    glm::dvec3  toDvec3() const { return glm::dvec3(x, y, z); }
+
+    FrameVector operator+(const FrameVector& _v) const { return FrameVector(x + _v.x, y + _v.y, z + _v.z); }
+    FrameVector operator-(const FrameVector& _v) const { return FrameVector(x - _v.x, y - _v.y, z - _v.z); }
+    FrameVector operator*(T _s) const { return FrameVector(x * _s, y * _s, z * _s); }
+    FrameVector& operator+=(const FrameVector& _v) { x += _v.x; y += _v.y; z += _v.z; return *this; }
+    FrameVector& operator-=(const FrameVector& _v) { x -= _v.x; y -= _v.y; z -= _v.z; return *this; }
+
+    T           dot(const FrameVector& _v) const { return x * _v.x + y * _v.y + z * _v.z; }
+    T           length() const { return std::sqrt(dot(*this)); }
+};
+
+template<Unit U, typename T = double> using HelioVector       = FrameVector<Frame::HELIOCENTRIC, U, T>;
+template<Unit U, typename T = double> using GeoVector         = FrameVector<Frame::GEOCENTRIC, U, T>;
+template<Unit U, typename T = double> using EquatorialVector  = FrameVector<Frame::EQUATORIAL, U, T>;
+template<Unit U, typename T = double> using HorizontalVector  = FrameVector<Frame::HORIZONTAL, U, T>;
+
+// Same frame, new unit. The factor is a compile time constant so the loop has no branches
+template<Frame F, Unit FROM, Unit TO, typename T>
+void convertUnits(const FrameVector<F, FROM, T>* _in, FrameVector<F, TO, T>* _out, size_t _total) {
+    const T k = T(unitFactor<FROM, TO>());
+    for (size_t i = 0; i < _total; i++) {
+        _out[i].x = _in[i].x * k;
+        _out[i].y = _in[i].y * k;
+        _out[i].z = _in[i].z * k;
+    }
+}
+
+// Rotates between frames sharing an origin (geocentric ecliptic, equatorial, horizontal)
+template<Frame TO, Frame FROM, Unit U, typename T>
+FrameVector<TO, U, T> rotateFrame(const glm::dmat3& _m, const FrameVector<FROM, U, T>& _v) {
+    static_assert(FROM != Frame::HELIOCENTRIC && TO != Frame::HELIOCENTRIC, "heliocentric vectors need a translation, not a rotation");
+    glm::dvec3 r = _m * glm::dvec3(_v.x, _v.y, _v.z);
+    return FrameVector<TO, U, T>(T(r.x), T(r.y), T(r.z));
+}
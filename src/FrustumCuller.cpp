@@ -0,0 +1,161 @@
+//
+//  FrustumCuller.cpp
+//  Solar
+//
+
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#define CULL_BATCH          16
+#define CULL_PER_TASK       16384   // fewer objects than this are not worth a task
+#define CULL_MIN_W          1e-6f
+
+FrustumCuller::FrustumCuller() :
+    m_pixelScale(1.0f) {
+    for (int i = 0; i < 6; i++) {
+        m_a[i] = m_b[i] = m_c[i] = 0.0f;
+        m_d[i] = 1.0f;
+    }
+    m_w[0] = m_w[1] = m_w[2] = 0.0f;
+    m_w[3] = 1.0f;
+}
+
+void FrustumCuller::setView(const glm::mat4& _modelViewProjection, const glm::mat4& _projection, float _viewportHeight) {
+    // Gribb & Hartmann: the planes are sums and differences of the rows of the matrix
+    const glm::mat4& m = _modelViewProjection;
+    float row[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            row[r][c] = m[c][r];
+        }
+    }
+
+    for (int i = 0; i < 6; i++) {
+        int axis = i / 2;
+        float sign = (i % 2 == 0)? 1.0f : -1.0f;
+        float p[4];
+        for (int c = 0; c < 4; c++) {
+            p[c] = row[3][c] + sign * row[axis][c];
+        }
+        float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        length = (length > 0.0f)? 1.0f / length : 0.0f;
+        m_a[i] = p[0] * length;
+        m_b[i] = p[1] * length;
+        m_c[i] = p[2] * length;
+        m_d[i] = p[3] * length;
+    }
+
+    for (int c = 0; c < 4; c++) {
+        m_w[c] = row[3][c];
+    }
+    m_pixelScale = _projection[1][1] * _viewportHeight * 0.5f;
+}
+
+void FrustumCuller::setAll() {
+    for (int i = 0; i < 6; i++) {
+        m_a[i] = m_b[i] = m_c[i] = 0.0f;
+        m_d[i] = 1.0f;
+    }
+    m_w[0] = m_w[1] = m_w[2] = 0.0f;
+    m_w[3] = 1.0f;
+    m_pixelScale = std::numeric_limits<float>::infinity();
+}
+
+bool FrustumCuller::isVisible(const glm::vec3& _center, float _radius, float _minPixels) const {
+    for (int i = 0; i < 6; i++) {
+        if (m_a[i] * _center.x + m_b[i] * _center.y + m_c[i] * _center.z + m_d[i] < -_radius) {
+            return false;
+        }
+    }
+    float w = std::max(CULL_MIN_W, m_w[0] * _center.x + m_w[1] * _center.y + m_w[2] * _center.z + m_w[3]);
+    return _radius * m_pixelScale >= _minPixels * w;
+}
+
+void FrustumCuller::cullRange(const CullQuery& _query, size_t _begin, size_t _end, std::vector<uint32_t>& _visible, std::vector<uint32_t>* _labeled) const {
+    float x[CULL_BATCH], y[CULL_BATCH], z[CULL_BATCH], r[CULL_BATCH];
+    float bx[CULL_BATCH], by[CULL_BATCH], bz[CULL_BATCH], br[CULL_BATCH];
+    bool bounded = _query.boundCenters && _query.boundRadii;
+    uint8_t inside[CULL_BATCH], label[CULL_BATCH];
+
+    for (size_t base = _begin; base < _end; base += CULL_BATCH) {
+        size_t count = std::min<size_t>(CULL_BATCH, _end - base);
+
+        // Gather into lanes; the tail of the last batch is padded and ignored
+        for (size_t k = 0; k < CULL_BATCH; k++) {
+            size_t i = base + std::min(k, count - 1);
+            x[k] = _query.centers[i].x;
+            y[k] = _query.centers[i].y;
+            z[k] = _query.centers[i].z;
+            r[k] = _query.radii? _query.radii[i] : _query.radius;
+            if (bounded) {
+                bx[k] = _query.boundCenters[i].x;
+                by[k] = _query.boundCenters[i].y;
+                bz[k] = _query.boundCenters[i].z;
+                br[k] = _query.boundRadii[i] + _query.boundPadding;
+            }
+            else {
+                bx[k] = x[k];
+                by[k] = y[k];
+                bz[k] = z[k];
+                br[k] = r[k];
+            }
+        }
+
+        for (size_t k = 0; k < CULL_BATCH; k++) {
+            uint8_t in = 1;
+            for (int p = 0; p < 6; p++) {
+                in &= uint8_t(m_a[p] * bx[k] + m_b[p] * by[k] + m_c[p] * bz[k] + m_d[p] >= -br[k]);
+            }
+            // Projected radius in pixels is r * scale / w, compared without dividing
+            float w = std::max(CULL_MIN_W, m_w[0] * x[k] + m_w[1] * y[k] + m_w[2] * z[k] + m_w[3]);
+            float size = r[k] * m_pixelScale;
+            inside[k] = in & uint8_t(size >= _query.minPixels * w);
+            label[k] = inside[k] & uint8_t(size >= _query.labelPixels * w);
+        }
+
+        for (size_t k = 0; k < count; k++) {
+            if (inside[k]) {
+                _visible.push_back(uint32_t(base + k));
+                if (_labeled && label[k]) {
+                    _labeled->push_back(uint32_t(base + k));
+                }
+            }
+        }
+    }
+}
+
+void FrustumCuller::cull(const CullQuery& _query, TaskScheduler& _scheduler, std::vector<uint32_t>& _visible, std::vector<uint32_t>* _labeled) const {
+    _visible.clear();
+    if (_labeled) {
+        _labeled->clear();
+    }
+    if (_query.total == 0 || !_query.centers) {
+        return;
+    }
+
+    size_t chunks = (_query.total + CULL_PER_TASK - 1) / CULL_PER_TASK;
+    if (chunks <= 1 || _scheduler.getWorkers() == 0) {
+        cullRange(_query, 0, _query.total, _visible, _labeled);
+        return;
+    }
+
+    // Contiguous chunks keep every partial list sorted, so they are concatenated in order
+    std::vector< std::vector<uint32_t> > visible(chunks), labeled(chunks);
+    _scheduler.parallelFor(0, chunks, 1, [&](size_t _begin, size_t _end) {
+        for (size_t c = _begin; c < _end; c++) {
+            size_t begin = c * CULL_PER_TASK;
+            size_t end = std::min(_query.total, begin + CULL_PER_TASK);
+            cullRange(_query, begin, end, visible[c], _labeled? &labeled[c] : nullptr);
+        }
+    });
+
+    for (size_t c = 0; c < chunks; c++) {
+        _visible.insert(_visible.end(), visible[c].begin(), visible[c].end());
+        if (_labeled) {
+            _labeled->insert(_labeled->end(), labeled[c].begin(), labeled[c].end());
+        }
+    }
+}
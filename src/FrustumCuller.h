@@ -0,0 +1,62 @@
+//
+//  FrustumCuller.h
+//  Solar
+//
+//  Decides which objects are worth drawing: bounding spheres are tested
+//  against the six planes of the camera frustum and against their
+//  projected size in pixels. Positions are read in fixed size batches
+//  with branch free masks (so the compiler can vectorize the loop) and
+//  large arrays are split in chunks across the task scheduler. The result
+//  is a compact list of indices for the draw paths to walk.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "TaskScheduler.h"
+
+struct CullQuery {
+    const glm::vec3*    centers = nullptr;
+    const float*        radii = nullptr;        // per object, or nullptr to use radius for all
+    size_t              total = 0;
+    float               radius = 0.0f;
+    float               minPixels = 0.5f;       // smaller spheres are not drawn
+    float               labelPixels = 2.0f;     // smaller ones are drawn without label
+
+    // Spheres around everything drawn with each object (a tether, a label),
+    // for the frustum test only. The pixel tests keep using centers and radius
+    const glm::vec3*    boundCenters = nullptr;
+    const float*        boundRadii = nullptr;
+    float               boundPadding = 0.0f;    // added to every bound radius
+};
+
+class FrustumCuller {
+public:
+    FrustumCuller();
+
+    // _modelViewProjection takes centers to clip space. _viewportHeight is in pixels
+    void        setView(const glm::mat4& _modelViewProjection, const glm::mat4& _projection, float _viewportHeight);
+    // Everything passes, for views all around the camera (dome)
+    void        setAll();
+
+    // Replaces _visible with the indices (ascending) of the objects that pass, and
+    // _labeled (when given) with the subset that is also big enough for a label
+    void        cull(const CullQuery& _query, TaskScheduler& _scheduler, std::vector<uint32_t>& _visible, std::vector<uint32_t>* _labeled = nullptr) const;
+
+    // Single sphere, for the few objects that are not in arrays
+    bool        isVisible(const glm::vec3& _center, float _radius, float _minPixels = 0.5f) const;
+
+protected:
+    void        cullRange(const CullQuery& _query, size_t _begin, size_t _end, std::vector<uint32_t>& _visible, std::vector<uint32_t>* _labeled) const;
+
+    // Planes as a x + b y + c z + d, normalized, left right bottom top near far
+    float       m_a[6], m_b[6], m_c[6], m_d[6];
+    // Clip w of a point (its view depth in perspective)
+    float       m_w[4];
+    float       m_pixelScale;   // pixels covered by a unit radius at w = 1
+};
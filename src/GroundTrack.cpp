@@ -0,0 +1,336 @@
+//
+//  GroundTrack.cpp
+//  Solar
+//
+
+#include "GroundTrack.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include "EarthOrientation.h"
+#include "SatelliteCache.h"
+
+#define GROUND_EARTH_RADIUS_KM      6378.137
+#define GROUND_EARTH_FLATTENING     0.0033528106647474805
+#define GROUND_DEG_TO_RAD           0.017453292519943295
+#define GROUND_RAD_TO_DEG           57.29577951308232
+#define GROUND_OBJECTS_PER_THREAD   4
+
+namespace {
+
+bool bigEndianHost() {
+    const uint16_t probe = 1;
+    return *(const unsigned char*)&probe == 0;
+}
+
+// Appends _value to _out in little endian byte order, whatever the host uses
+template<typename T>
+void putLittleEndian(std::vector<char>& _out, T _value) {
+    const char* bytes = (const char*)&_value;
+    size_t at = _out.size();
+    _out.insert(_out.end(), bytes, bytes + sizeof(T));
+    if (bigEndianHost()) {
+        std::reverse(_out.begin() + at, _out.end());
+    }
+}
+
+}
+
+// GEOJSON
+// --------------------------------------------------------------------------
+
+GeoJsonWriter::GeoJsonWriter() : m_first(true) {
+}
+
+GeoJsonWriter::~GeoJsonWriter() {
+    close();
+}
+
+bool GeoJsonWriter::open(const std::string& _path) {
+    close();
+    m_file.open(_path.c_str(), std::ios::out | std::ios::trunc);
+    if (!m_file.is_open()) {
+        return false;
+    }
+    m_first = true;
+    m_file << "{\"type\":\"FeatureCollection\",\"features\":[\n";
+    return true;
+}
+
+void GeoJsonWriter::write(const GroundSegment& _segment) {
+    if (!m_file.is_open() || _segment.samples.size() < 2) {
+        return;
+    }
+
+    if (!m_first) {
+        m_file << ",\n";
+    }
+    m_first = false;
+
+    std::string name;
+    for (size_t i = 0; i < _segment.name.size(); i++) {
+        char c = _segment.name[i];
+        if (c == '"' || c == '\\') {
+            name += '\\';
+        }
+        if (c >= ' ') {
+            name += c;
+        }
+    }
+
+    const std::vector<GroundSample>& s = _segment.samples;
+    m_file << "{\"type\":\"Feature\",\"properties\":{";
+    m_file << "\"norad\":" << _segment.norad << ",\"name\":\"" << name << "\",";
+    // Julian Days to the millisecond (1e-8 day)
+    m_file << std::fixed << std::setprecision(8);
+    m_file << "\"start\":" << s.front().jd << ",\"end\":" << s.back().jd << ",\"footprint\":[";
+    m_file << std::defaultfloat << std::setprecision(6);
+    for (size_t i = 0; i < s.size(); i++) {
+        m_file << (i? "," : "") << s[i].footprint;
+    }
+    m_file << "]},\"geometry\":{\"type\":\"LineString\",\"coordinates\":[";
+    for (size_t i = 0; i < s.size(); i++) {
+        m_file << (i? ",[" : "[") << std::setprecision(8) << s[i].lng << "," << s[i].lat << "," << std::setprecision(7) << s[i].alt * 1000.0 << "]";
+    }
+    m_file << "]}}";
+}
+
+void GeoJsonWriter::close() {
+    if (m_file.is_open()) {
+        m_file << "\n]}\n";
+        m_file.close();
+    }
+}
+
+// BINARY
+// --------------------------------------------------------------------------
+
+GroundTrackBinaryWriter::~GroundTrackBinaryWriter() {
+    close();
+}
+
+bool GroundTrackBinaryWriter::open(const std::string& _path) {
+    close();
+    m_file.open(_path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!m_file.is_open()) {
+        return false;
+    }
+    m_file.write("SGT1", 4);
+    return true;
+}
+
+void GroundTrackBinaryWriter::write(const GroundSegment& _segment) {
+    if (!m_file.is_open() || _segment.samples.size() < 2) {
+        return;
+    }
+
+    const std::vector<GroundSample>& s = _segment.samples;
+    uint32_t norad = _segment.norad;
+    uint16_t length = uint16_t(std::min<size_t>(_segment.name.size(), 0xFFFF));
+    double jd0 = s.front().jd;
+    uint32_t count = uint32_t(s.size());
+
+    std::vector<char> record;
+    record.reserve(18 + length + s.size() * 5 * sizeof(float));
+    putLittleEndian(record, norad);
+    putLittleEndian(record, length);
+    record.insert(record.end(), _segment.name.begin(), _segment.name.begin() + length);
+    putLittleEndian(record, jd0);
+    putLittleEndian(record, count);
+
+    for (size_t i = 0; i < s.size(); i++) {
+        putLittleEndian(record, float((s[i].jd - jd0) * 86400.0));
+        putLittleEndian(record, float(s[i].lng));
+        putLittleEndian(record, float(s[i].lat));
+        putLittleEndian(record, float(s[i].alt));
+        putLittleEndian(record, float(s[i].footprint));
+    }
+    m_file.write(record.data(), record.size());
+}
+
+void GroundTrackBinaryWriter::close() {
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+}
+
+// GROUND TRACK
+// --------------------------------------------------------------------------
+
+GroundTrack::GroundTrack() :
+    m_jdStart(0.0),
+    m_jdEnd(0.0),
+    m_step(60.0 / 86400.0),
+    m_minElevation(0.0),
+    m_chunk(1440) {
+}
+
+void GroundTrack::add(unsigned int _norad, const Satellite& _satellite) {
+    Object object;
+    object.norad = _norad;
+    object.name = _satellite.getName();
+    object.satellite = _satellite;
+    m_objects.push_back(object);
+}
+
+void GroundTrack::clear() {
+    m_objects.clear();
+}
+
+void GroundTrack::setWindow(double _jdStart, double _jdEnd, double _step) {
+    m_jdStart = _jdStart;
+    m_jdEnd = _jdEnd;
+    m_step = _step;
+}
+
+void GroundTrack::setChunk(size_t _samples) {
+    m_chunk = std::max<size_t>(2, _samples);
+}
+
+double GroundTrack::footprint(double _altitude, double _minElevation) {
+    double e = _minElevation * GROUND_DEG_TO_RAD;
+    double ratio = GROUND_EARTH_RADIUS_KM / (GROUND_EARTH_RADIUS_KM + std::max(0.0, _altitude));
+    double angle = std::acos(ratio * std::cos(e)) - e;
+    return std::max(0.0, angle) * GROUND_EARTH_RADIUS_KM;
+}
+
+GroundSample GroundTrack::toGround(const glm::dvec3& _terrestrial, double _jd, double _minElevation) {
+    const double a = GROUND_EARTH_RADIUS_KM;
+    const double e2 = GROUND_EARTH_FLATTENING * (2.0 - GROUND_EARTH_FLATTENING);
+
+    double p = std::sqrt(_terrestrial.x * _terrestrial.x + _terrestrial.y * _terrestrial.y);
+    double lat = std::atan2(_terrestrial.z, p * (1.0 - e2));
+    double h = 0.0;
+
+    // Converges to well under a meter in three rounds for anything above the ground
+    for (int i = 0; i < 3; i++) {
+        double sl = std::sin(lat);
+        double N = a / std::sqrt(1.0 - e2 * sl * sl);
+        h = (std::abs(lat) < 1.5)? p / std::cos(lat) - N : _terrestrial.z / sl - N * (1.0 - e2);
+        lat = std::atan2(_terrestrial.z, p * (1.0 - e2 * N / (N + h)));
+    }
+
+    GroundSample sample;
+    sample.jd = _jd;
+    sample.lng = std::atan2(_terrestrial.y, _terrestrial.x) * GROUND_RAD_TO_DEG;
+    sample.lat = lat * GROUND_RAD_TO_DEG;
+    sample.alt = h;
+    sample.footprint = footprint(h, _minElevation);
+    return sample;
+}
+
+void GroundTrack::split(const std::vector<GroundSample>& _samples, std::vector< std::vector<GroundSample> >& _out) {
+    if (_samples.empty()) {
+        return;
+    }
+
+    _out.push_back(std::vector<GroundSample>());
+    _out.back().push_back(_samples[0]);
+    for (size_t i = 1; i < _samples.size(); i++) {
+        const GroundSample& a = _samples[i - 1];
+        const GroundSample& b = _samples[i];
+
+        double delta = b.lng - a.lng;
+        if (std::abs(delta) > 180.0) {
+            // Crossing the antimeridian: close at one edge, reopen at the other
+            double edge = (a.lng > 0.0)? 180.0 : -180.0;
+            double unwrapped = b.lng + ((delta < 0.0)? 360.0 : -360.0);
+            double f = (edge - a.lng) / (unwrapped - a.lng);
+
+            GroundSample cross;
+            cross.jd = a.jd + (b.jd - a.jd) * f;
+            cross.lat = a.lat + (b.lat - a.lat) * f;
+            cross.alt = a.alt + (b.alt - a.alt) * f;
+            cross.footprint = a.footprint + (b.footprint - a.footprint) * f;
+
+            cross.lng = edge;
+            _out.back().push_back(cross);
+            _out.push_back(std::vector<GroundSample>());
+            cross.lng = -edge;
+            _out.back().push_back(cross);
+        }
+        _out.back().push_back(b);
+    }
+}
+
+void GroundTrack::track( Object& _object, size_t _first, size_t _total,
+                         const std::vector<glm::dmat3>& _rotations, std::vector<GroundSegment>& _out) const {
+    std::vector<GroundSample> samples;
+    std::vector< std::vector<GroundSample> > pieces;
+    samples.reserve(_total);
+
+    for (size_t i = 0; i < _total; i++) {
+        double jd = m_jdStart + (_first + i) * m_step;
+        try {
+            glm::dvec3 eci = SatelliteCache::evaluate(_object.satellite, jd).position;
+            samples.push_back(toGround(_rotations[i] * eci, jd, m_minElevation));
+        }
+        catch (...) {
+            // Decayed or outside the TLE's range: break the line here
+            split(samples, pieces);
+            samples.clear();
+        }
+    }
+    split(samples, pieces);
+
+    for (size_t i = 0; i < pieces.size(); i++) {
+        GroundSegment segment;
+        segment.norad = _object.norad;
+        segment.name = _object.name;
+        segment.samples.swap(pieces[i]);
+        _out.push_back(segment);
+    }
+}
+
+size_t GroundTrack::run(GroundTrackWriter& _writer, TaskScheduler& _scheduler) {
+    if (m_step <= 0.0 || m_jdEnd < m_jdStart || m_objects.empty()) {
+        return 0;
+    }
+
+    size_t total = size_t(std::floor((m_jdEnd - m_jdStart) / m_step)) + 1;
+    size_t written = 0;
+    size_t batch = (_scheduler.getWorkers() + 1) * GROUND_OBJECTS_PER_THREAD;
+
+    EarthOrientation eop;
+    std::vector<glm::dmat3> rotations;
+    std::vector< std::vector<GroundSegment> > results;
+
+    // Consecutive chunks share their edge sample so lines stay connected
+    for (size_t first = 0; first + 1 < total || first == 0; first += m_chunk) {
+        size_t count = std::min(m_chunk + 1, total - first);
+
+        // Earth rotation once per sample time, shared by every object
+        rotations.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            eop.update(m_jdStart + (first + i) * m_step);
+            rotations[i] = eop.getEquatorialToTerrestrial();
+        }
+
+        for (size_t begin = 0; begin < m_objects.size(); begin += batch) {
+            size_t end = std::min(begin + batch, m_objects.size());
+            results.assign(end - begin, std::vector<GroundSegment>());
+
+            _scheduler.parallelFor(begin, end, 1, [&](size_t _begin, size_t _end) {
+                for (size_t i = _begin; i < _end; i++) {
+                    track(m_objects[i], first, count, rotations, results[i - begin]);
+                }
+            });
+
+            // Objects are written in catalog order whatever thread finished first
+            for (size_t i = 0; i < results.size(); i++) {
+                for (size_t j = 0; j < results[i].size(); j++) {
+                    _writer.write(results[i][j]);
+                    written += results[i][j].samples.size();
+                }
+            }
+        }
+
+        if (count < m_chunk + 1) {
+            break;
+        }
+    }
+
+    return written;
+}
@@ -0,0 +1,121 @@
+//
+//  GroundTrack.h
+//  Solar
+//
+//  Sub-satellite points (geodetic latitude, longitude and altitude over
+//  WGS84) and visibility footprints for catalog objects over a window.
+//  The window is walked in chunks: for every chunk the Earth rotation is
+//  computed once, objects are propagated in parallel (on a TaskScheduler)
+//  and their tracks,
+//  split at the antimeridian, are handed to a writer before the next
+//  chunk starts. Memory stays bounded by the chunk size, not the window.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "Astro/src/Satellite.h"
+
+#include "TaskScheduler.h"
+
+struct GroundSample {
+    double      jd;
+    double      lng;        // degrees, [-180, 180]
+    double      lat;        // degrees, geodetic
+    double      alt;        // km over the ellipsoid
+    double      footprint;  // km, ground radius seen above the minimum elevation
+};
+
+// A continuous piece of track, never crossing the antimeridian
+struct GroundSegment {
+    unsigned int    norad;
+    std::string     name;
+    std::vector<GroundSample> samples;
+};
+
+class GroundTrackWriter {
+public:
+    virtual ~GroundTrackWriter() {}
+
+    virtual bool    open(const std::string& _path) = 0;
+    virtual void    write(const GroundSegment& _segment) = 0;
+    virtual void    close() = 0;
+};
+
+// FeatureCollection of LineStrings ([lng, lat, alt in m]) written as it goes
+class GeoJsonWriter : public GroundTrackWriter {
+public:
+    GeoJsonWriter();
+    virtual ~GeoJsonWriter();
+
+    virtual bool    open(const std::string& _path);
+    virtual void    write(const GroundSegment& _segment);
+    virtual void    close();
+
+protected:
+    std::ofstream   m_file;
+    bool            m_first;
+};
+
+// "SGT1" header, then one record per segment:
+//   uint32 norad, uint16 name length, name, double jd0, uint32 count,
+//   count x { float seconds since jd0, lng, lat, alt km, footprint km }
+// Little endian on every host
+class GroundTrackBinaryWriter : public GroundTrackWriter {
+public:
+    virtual ~GroundTrackBinaryWriter();
+
+    virtual bool    open(const std::string& _path);
+    virtual void    write(const GroundSegment& _segment);
+    virtual void    close();
+
+protected:
+    std::ofstream   m_file;
+};
+
+class GroundTrack {
+public:
+    GroundTrack();
+
+    void        add(unsigned int _norad, const Satellite& _satellite);
+    void        clear();
+    size_t      size() const { return m_objects.size(); }
+
+    void        setWindow(double _jdStart, double _jdEnd, double _step);
+    // Footprint edge: where the object is seen this many degrees above the horizon
+    void        setMinElevation(double _degrees) { m_minElevation = _degrees; }
+    // Samples per object kept in memory at once
+    void        setChunk(size_t _samples);
+
+    // Streams every track to _writer, returns the number of samples written
+    size_t      run(GroundTrackWriter& _writer, TaskScheduler& _scheduler);
+
+    // Earth fixed position (km) to the point under it
+    static GroundSample toGround(const glm::dvec3& _terrestrial, double _jd, double _minElevation);
+    // Ground radius (km) of the area that sees an object at _altitude km above _minElevation degrees
+    static double footprint(double _altitude, double _minElevation);
+    // Splits _samples wherever consecutive longitudes jump over the antimeridian
+    static void split(const std::vector<GroundSample>& _samples, std::vector< std::vector<GroundSample> >& _out);
+
+protected:
+    struct Object {
+        unsigned int    norad;
+        std::string     name;
+        Satellite       satellite;
+    };
+
+    void        track(Object& _object, size_t _first, size_t _total,
+                      const std::vector<glm::dmat3>& _rotations, std::vector<GroundSegment>& _out) const;
+
+    std::vector<Object> m_objects;
+    double      m_jdStart;
+    double      m_jdEnd;
+    double      m_step;
+    double      m_minElevation;
+    size_t      m_chunk;
+};
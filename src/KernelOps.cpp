@@ -0,0 +1,321 @@
+//
+//  KernelOps.cpp
+//  Solar
+//
+
+#include "KernelOps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#define KERNEL_TAU              6.283185307179586
+#define KERNEL_RAD_TO_ARCSEC    206264.80624709636
+#define KERNEL_EARTH_RADIUS_KM  6378.137
+#define KERNEL_SUN_RADIUS_KM    696000.0
+
+PrecisionPolicy::PrecisionPolicy() {
+    // Pixels tolerate float, searches for events and passes do not
+    m_precision[int(Subsystem::BODY_POSITIONS)] = Precision::FLOAT;
+    m_precision[int(Subsystem::SATELLITE_POSITIONS)] = Precision::FLOAT;
+    m_precision[int(Subsystem::TRAILS)] = Precision::FLOAT;
+    m_precision[int(Subsystem::STARS)] = Precision::FLOAT;
+    m_precision[int(Subsystem::EVENT_SEARCH)] = Precision::DOUBLE;
+    m_precision[int(Subsystem::PASS_SEARCH)] = Precision::DOUBLE;
+}
+
+void PrecisionPolicy::set(Subsystem _subsystem, Precision _precision) {
+    m_precision[int(_subsystem)] = _precision;
+}
+
+Precision PrecisionPolicy::get(Subsystem _subsystem) const {
+    return m_precision[int(_subsystem)];
+}
+
+template<typename T>
+void KernelOps::hermite(const StateSegment* _segments, size_t _total, double _jd, EquatorialVector<Unit::KM, T>* _out) {
+    for (size_t i = 0; i < _total; i++) {
+        const StateKnot& k0 = _segments[i].k0;
+        const StateKnot& k1 = _segments[i].k1;
+
+        // Time stays in double (JDs need the bits), the rest runs in T
+        double span = k1.jd - k0.jd;
+        T h = T(span);
+        T s = (span > 0.0)? T((_jd - k0.jd) / span) : T(0);
+        T s2 = s * s;
+        T s3 = s2 * s;
+
+        T h00 = T(2) * s3 - T(3) * s2 + T(1);
+        T h10 = (s3 - T(2) * s2 + s) * h;
+        T h01 = T(3) * s2 - T(2) * s3;
+        T h11 = (s3 - s2) * h;
+
+        _out[i].x = h00 * T(k0.position.x) + h10 * T(k0.velocity.x) + h01 * T(k1.position.x) + h11 * T(k1.velocity.x);
+        _out[i].y = h00 * T(k0.position.y) + h10 * T(k0.velocity.y) + h01 * T(k1.position.y) + h11 * T(k1.velocity.y);
+        _out[i].z = h00 * T(k0.position.z) + h10 * T(k0.velocity.z) + h01 * T(k1.position.z) + h11 * T(k1.velocity.z);
+    }
+}
+
+template<typename T>
+void KernelOps::bodiesToScene(const HelioVector<Unit::AU>* _helio, size_t _total, double _scale, glm::vec3* _out) {
+    const T k = T(_scale);
+    for (size_t i = 0; i < _total; i++) {
+        _out[i] = glm::vec3(float(T(_helio[i].x) * k), float(T(_helio[i].y) * k), float(T(_helio[i].z) * k));
+    }
+}
+
+template<typename T>
+void KernelOps::satellitesToScene(  const EquatorialVector<Unit::KM, T>* _eci, size_t _total,
+                                    const glm::dmat3& _equatorialToEcliptic, double _earthSize, const glm::vec3& _earth,
+                                    glm::vec3* _equat, glm::vec3* _geo, glm::vec3* _helio) {
+    const T k = T(unitFactor<Unit::KM, Unit::EARTH_RADII>() * _earthSize);
+    const glm::dmat3& m = _equatorialToEcliptic;
+    const T m00 = T(m[0][0]), m01 = T(m[1][0]), m02 = T(m[2][0]);
+    const T m10 = T(m[0][1]), m11 = T(m[1][1]), m12 = T(m[2][1]);
+    const T m20 = T(m[0][2]), m21 = T(m[1][2]), m22 = T(m[2][2]);
+
+    for (size_t i = 0; i < _total; i++) {
+        T x = _eci[i].x * k;
+        T y = _eci[i].y * k;
+        T z = _eci[i].z * k;
+        _equat[i] = glm::vec3(float(x), float(y), float(z));
+        _geo[i] = glm::vec3(float(m00 * x + m01 * y + m02 * z),
+                            float(m10 * x + m11 * y + m12 * z),
+                            float(m20 * x + m21 * y + m22 * z));
+        _helio[i] = _geo[i] + _earth;
+    }
+}
+
+template<typename T>
+void KernelOps::illumination(   const EquatorialVector<Unit::KM, T>* _eci, size_t _total, const IlluminationQuery& _query,
+                                uint8_t* _flags, float* _magnitudes) {
+    // Sun direction, and how fast the umbra narrows and the penumbra
+    // widens with the distance behind the Earth (half angles of the cones)
+    double sunDistance = glm::length(_query.sun);
+    glm::dvec3 s = _query.sun / sunDistance;
+    const T sx = T(s.x), sy = T(s.y), sz = T(s.z);
+    const T umbra = T(std::tan(std::asin((KERNEL_SUN_RADIUS_KM - KERNEL_EARTH_RADIUS_KM) / sunDistance)));
+    const T penumbra = T(std::tan(std::asin((KERNEL_SUN_RADIUS_KM + KERNEL_EARTH_RADIUS_KM) / sunDistance)));
+    const T earth = T(KERNEL_EARTH_RADIUS_KM);
+
+    glm::dvec3 up = glm::normalize(_query.observer);
+    const T ox = T(_query.observer.x), oy = T(_query.observer.y), oz = T(_query.observer.z);
+    const T ux = T(up.x), uy = T(up.y), uz = T(up.z);
+
+    const T pi = T(KERNEL_TAU * 0.5);
+    const T tiny = T(1e-6);
+    const T stdMagnitude = T(_query.stdMagnitude);
+    const T limit = T(_query.limit);
+    const uint8_t dark = _query.observerDark? ILLUMINATION_VISIBLE : 0;
+
+    for (size_t i = 0; i < _total; i++) {
+        T x = _eci[i].x;
+        T y = _eci[i].y;
+        T z = _eci[i].z;
+
+        // Shadow: distance along the anti-sun axis and off it
+        T along = x * sx + y * sy + z * sz;
+        T px = x - along * sx;
+        T py = y - along * sy;
+        T pz = z - along * sz;
+        T off = std::sqrt(px * px + py * py + pz * pz);
+        T behind = std::max(-along, T(0));
+        T umbraRadius = earth - behind * umbra;
+        T penumbraRadius = earth + behind * penumbra;
+        // Fraction of the Sun seen, linear across the penumbra; the day side is always lit
+        T lit = std::min(std::max((off - umbraRadius) / std::max(penumbraRadius - umbraRadius, tiny), T(0)), T(1));
+        lit = (along >= T(0))? T(1) : lit;
+
+        // Phase angle between the Sun and the observer seen from the satellite
+        T dx = ox - x;
+        T dy = oy - y;
+        T dz = oz - z;
+        T range = std::sqrt(dx * dx + dy * dy + dz * dz);
+        T cosPhase = std::min(std::max((dx * sx + dy * sy + dz * sz) / range, T(-1)), T(1));
+        T phase = std::acos(cosPhase);
+        // Lambertian sphere, normalized to 1 at 90 degrees
+        T diffuse = std::sin(phase) + (pi - phase) * cosPhase;
+        T magnitude = stdMagnitude + T(5) * std::log10(range * T(0.001))
+                    - T(2.5) * std::log10(std::max(diffuse, tiny))
+                    - T(2.5) * std::log10(std::max(lit, tiny));
+        magnitude = (lit > T(0))? magnitude : T(ILLUMINATION_DARK_MAG);
+
+        // Above the horizon when the line of sight points away from the ground
+        T elevation = -(dx * ux + dy * uy + dz * uz);
+
+        uint8_t isLit = uint8_t(lit > T(0));
+        uint8_t isPenumbra = uint8_t(lit < T(1)) & isLit;
+        uint8_t isUp = uint8_t(elevation > T(0));
+        uint8_t isBright = uint8_t(magnitude <= limit);
+        _flags[i] = uint8_t(isLit * ILLUMINATION_LIT) |
+                    uint8_t(isPenumbra * ILLUMINATION_PENUMBRA) |
+                    uint8_t(isUp * ILLUMINATION_UP) |
+                    uint8_t((isLit & isUp & isBright) * dark);
+        _magnitudes[i] = float(magnitude);
+    }
+}
+
+size_t KernelOps::select(const uint8_t* _flags, size_t _total, uint8_t _mask, uint32_t* _out) {
+    size_t count = 0;
+    for (size_t i = 0; i < _total; i++) {
+        // Always written, only kept when it matches
+        _out[count] = uint32_t(i);
+        count += size_t((_flags[i] & _mask) == _mask);
+    }
+    return count;
+}
+
+template void KernelOps::hermite<float>(const StateSegment*, size_t, double, EquatorialVector<Unit::KM, float>*);
+template void KernelOps::hermite<double>(const StateSegment*, size_t, double, EquatorialVector<Unit::KM, double>*);
+template void KernelOps::bodiesToScene<float>(const HelioVector<Unit::AU>*, size_t, double, glm::vec3*);
+template void KernelOps::bodiesToScene<double>(const HelioVector<Unit::AU>*, size_t, double, glm::vec3*);
+template void KernelOps::satellitesToScene<float>(const EquatorialVector<Unit::KM, float>*, size_t, const glm::dmat3&, double, const glm::vec3&, glm::vec3*, glm::vec3*, glm::vec3*);
+template void KernelOps::satellitesToScene<double>(const EquatorialVector<Unit::KM, double>*, size_t, const glm::dmat3&, double, const glm::vec3&, glm::vec3*, glm::vec3*, glm::vec3*);
+template void KernelOps::illumination<float>(const EquatorialVector<Unit::KM, float>*, size_t, const IlluminationQuery&, uint8_t*, float*);
+template void KernelOps::illumination<double>(const EquatorialVector<Unit::KM, double>*, size_t, const IlluminationQuery&, uint8_t*, float*);
+
+namespace {
+
+struct ErrorStats {
+    double max = 0.0;
+    double sum2 = 0.0;
+    size_t total = 0;
+
+    void add(double _error) {
+        max = std::max(max, _error);
+        sum2 += _error * _error;
+        total++;
+    }
+    double rms() const { return (total > 0)? std::sqrt(sum2 / total) : 0.0; }
+};
+
+// Circular orbit state at _t (days) for radius _r (km) in the plane spanned by _u, _v
+StateKnot circular(double _t, double _r, const glm::dvec3& _u, const glm::dvec3& _v) {
+    double n = std::sqrt(398600.4418 / (_r * _r * _r)) * 86400.0;    // rad/day
+    double a = n * (_t - 2451545.0);
+    StateKnot knot;
+    knot.jd = _t;
+    knot.position = (_u * std::cos(a) + _v * std::sin(a)) * _r;
+    knot.velocity = (_v * std::cos(a) - _u * std::sin(a)) * (_r * n);
+    return knot;
+}
+
+}
+
+bool KernelOps::check(std::string& _report, PrecisionPolicy* _policy, size_t _samples) {
+    std::mt19937 rng(1969);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    std::vector<StateSegment> segments(_samples);
+    std::vector<HelioVector<Unit::AU> > helio(_samples);
+    double jd = 2458600.0 + unit(rng) * 3650.0;
+
+    for (size_t i = 0; i < _samples; i++) {
+        // Random orbit plane, radius between LEO and GEO, 32 knots per revolution
+        double lng = unit(rng) * KERNEL_TAU;
+        double inc = unit(rng) * KERNEL_TAU * 0.5;
+        glm::dvec3 u(std::cos(lng), std::sin(lng), 0.0);
+        glm::dvec3 v(-std::sin(lng) * std::cos(inc), std::cos(lng) * std::cos(inc), std::sin(inc));
+        double r = 6700.0 + unit(rng) * (42164.0 - 6700.0);
+        double period = KERNEL_TAU / (std::sqrt(398600.4418 / (r * r * r)) * 86400.0);
+        double h = period / 32.0;
+        double t0 = jd - unit(rng) * h;
+        segments[i].k0 = circular(t0, r, u, v);
+        segments[i].k1 = circular(t0 + h, r, u, v);
+
+        double d = 0.3 + unit(rng) * 50.0;
+        double z = unit(rng) * 2.0 - 1.0;
+        double a = unit(rng) * KERNEL_TAU;
+        double xy = std::sqrt(1.0 - z * z);
+        helio[i] = HelioVector<Unit::AU>(xy * std::cos(a) * d, xy * std::sin(a) * d, z * d);
+    }
+
+    // Satellites: interpolated + projected position, float against double, in km
+    const double earthSize = 1.7;
+    const double toKm = 1.0 / (unitFactor<Unit::KM, Unit::EARTH_RADII>() * earthSize);
+    glm::dmat3 ecliptic = glm::transpose(glm::dmat3(glm::dvec3(1.0, 0.0, 0.0),
+                                                    glm::dvec3(0.0, std::cos(0.409), std::sin(0.409)),
+                                                    glm::dvec3(0.0, -std::sin(0.409), std::cos(0.409))));
+    std::vector< EquatorialVector<Unit::KM, float> > eciF(_samples);
+    std::vector< EquatorialVector<Unit::KM, double> > eciD(_samples);
+    hermite<float>(segments.data(), _samples, jd, eciF.data());
+    hermite<double>(segments.data(), _samples, jd, eciD.data());
+
+    ErrorStats hermiteErr, sceneErr;
+    for (size_t i = 0; i < _samples; i++) {
+        hermiteErr.add((eciF[i].as<double>() - eciD[i]).length());
+    }
+
+    std::vector<glm::vec3> equat(_samples), geoF(_samples), helioScene(_samples);
+    satellitesToScene<float>(eciF.data(), _samples, ecliptic, earthSize, glm::vec3(0.0f), equat.data(), geoF.data(), helioScene.data());
+    for (size_t i = 0; i < _samples; i++) {
+        glm::dvec3 reference = ecliptic * eciD[i].toDvec3();
+        sceneErr.add(glm::length(glm::dvec3(geoF[i]) * toKm - reference));
+    }
+
+    // Bodies: direction error of the scene vector, float against exact, in arcsec
+    const double scale = 500.0;
+    std::vector<glm::vec3> bodies(_samples);
+    bodiesToScene<float>(helio.data(), _samples, scale, bodies.data());
+    ErrorStats bodiesErr;
+    for (size_t i = 0; i < _samples; i++) {
+        glm::dvec3 a = glm::normalize(glm::dvec3(bodies[i]));
+        glm::dvec3 b = glm::normalize(helio[i].toDvec3());
+        bodiesErr.add(glm::length(glm::cross(a, b)) * KERNEL_RAD_TO_ARCSEC);
+    }
+
+    // Illumination: magnitudes of objects both agree are lit, and how many flags differ
+    IlluminationQuery query;
+    query.sun = glm::dvec3(0.6, -0.7, 0.38) * 149597870.7;
+    query.observer = glm::normalize(glm::dvec3(-0.2, 0.9, 0.4)) * KERNEL_EARTH_RADIUS_KM;
+    std::vector<uint8_t> flagsF(_samples), flagsD(_samples);
+    std::vector<float> magF(_samples), magD(_samples);
+    illumination<float>(eciF.data(), _samples, query, flagsF.data(), magF.data());
+    illumination<double>(eciD.data(), _samples, query, flagsD.data(), magD.data());
+    ErrorStats magErr;
+    size_t flagsOff = 0;
+    for (size_t i = 0; i < _samples; i++) {
+        if (flagsF[i] != flagsD[i]) {
+            flagsOff++;
+        }
+        else if ((flagsD[i] & ILLUMINATION_LIT) && magD[i] < 10.0f) {
+            magErr.add(std::abs(double(magF[i]) - double(magD[i])));
+        }
+    }
+
+    // Flags may only flip for the odd object sitting on a boundary
+    bool satellitesPass =   hermiteErr.max <= KERNEL_FLOAT_BUDGET_KM &&
+                            sceneErr.max <= KERNEL_FLOAT_BUDGET_KM &&
+                            magErr.max <= KERNEL_FLOAT_BUDGET_MAG &&
+                            flagsOff * 1000 <= _samples;
+    bool bodiesPass = bodiesErr.max <= KERNEL_FLOAT_BUDGET_ARCSEC;
+    bool pass = satellitesPass && bodiesPass;
+
+    if (_policy != nullptr) {
+        if (!satellitesPass) {
+            _policy->set(Subsystem::SATELLITE_POSITIONS, Precision::DOUBLE);
+        }
+        if (!bodiesPass) {
+            _policy->set(Subsystem::BODY_POSITIONS, Precision::DOUBLE);
+        }
+    }
+
+    std::ostringstream report;
+    report << "float kernels over " << _samples << " samples: ";
+    report << "hermite max " << hermiteErr.max << " km (rms " << hermiteErr.rms() << "), ";
+    report << "satellite scene max " << sceneErr.max << " km (rms " << sceneErr.rms() << "), ";
+    report << "bodies max " << bodiesErr.max << "\" (rms " << bodiesErr.rms() << "), ";
+    report << "magnitude max " << magErr.max << " (rms " << magErr.rms() << ", " << flagsOff << " flags differ); ";
+    report << "budget " << KERNEL_FLOAT_BUDGET_KM << " km / " << KERNEL_FLOAT_BUDGET_ARCSEC << "\" / " << KERNEL_FLOAT_BUDGET_MAG << " mag ";
+    report << (pass? "PASS" : "FAIL");
+    if (!satellitesPass) {
+        report << ", satellites";
+    }
+    if (!bodiesPass) {
+        report << ", bodies";
+    }
+    _report = report.str();
+    return pass;
+}
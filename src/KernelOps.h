@@ -0,0 +1,113 @@
+//
+//  KernelOps.h
+//  Solar
+//
+//  Batch kernels for bodies and satellites, templated on the scalar type.
+//  Only float and double are instantiated (see KernelOps.cpp). Display
+//  paths can run in float for twice the SIMD width, while event and pass
+//  searches stay in double; PrecisionPolicy decides per subsystem.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "glm/glm.hpp"
+#include "FrameVector.h"
+
+struct StateKnot {
+    double      jd;
+    glm::dvec3  position;   // ECI, km
+    glm::dvec3  velocity;   // ECI, km per day
+};
+
+// A cubic Hermite segment. When both knots share the same jd the kernel returns k0
+struct StateSegment {
+    StateKnot   k0;
+    StateKnot   k1;
+};
+
+enum class Precision {
+    FLOAT,
+    DOUBLE
+};
+
+enum class Subsystem {
+    BODY_POSITIONS,
+    SATELLITE_POSITIONS,
+    TRAILS,
+    STARS,
+    EVENT_SEARCH,
+    PASS_SEARCH,
+    TOTAL
+};
+
+class PrecisionPolicy {
+public:
+    PrecisionPolicy();
+
+    void        set(Subsystem _subsystem, Precision _precision);
+    Precision   get(Subsystem _subsystem) const;
+    bool        useFloat(Subsystem _subsystem) const { return get(_subsystem) == Precision::FLOAT; }
+
+protected:
+    Precision   m_precision[int(Subsystem::TOTAL)];
+};
+
+// Largest float vs. double difference check() accepts
+#define KERNEL_FLOAT_BUDGET_KM      0.05    // satellite positions
+#define KERNEL_FLOAT_BUDGET_ARCSEC  0.5     // body directions seen from the Sun
+#define KERNEL_FLOAT_BUDGET_MAG     0.01    // satellite magnitudes
+
+// Per satellite flags written by illumination()
+#define ILLUMINATION_LIT        0x01    // some sunlight reaches it
+#define ILLUMINATION_PENUMBRA   0x02    // partly shadowed by the Earth
+#define ILLUMINATION_UP         0x04    // above the observer's horizon
+#define ILLUMINATION_VISIBLE    0x08    // lit, up, dark sky and bright enough
+#define ILLUMINATION_STATES     16      // flag combinations, for lookup tables
+#define ILLUMINATION_DARK_MAG   99.0f   // magnitude of objects in the umbra
+
+// Everything illumination() needs besides the positions, computed once per tick
+struct IlluminationQuery {
+    glm::dvec3  sun;                    // ECI km
+    glm::dvec3  observer;               // ECI km
+    bool        observerDark = true;    // Sun low enough below the observer's horizon
+    float       stdMagnitude = 5.0f;    // at 1000 km and half phase
+    float       limit = 4.5f;           // faintest magnitude counted as visible
+};
+
+class KernelOps {
+public:
+    // Cubic Hermite interpolation of _total segments at _jd
+    template<typename T>
+    static void hermite(const StateSegment* _segments, size_t _total, double _jd, EquatorialVector<Unit::KM, T>* _out);
+
+    // Heliocentric AU to scene units
+    template<typename T>
+    static void bodiesToScene(const HelioVector<Unit::AU>* _helio, size_t _total, double _scale, glm::vec3* _out);
+
+    // ECI km to scene: equatorial and ecliptic offsets around the Earth
+    // (Earth radii times _earthSize) and the heliocentric scene position
+    template<typename T>
+    static void satellitesToScene(  const EquatorialVector<Unit::KM, T>* _eci, size_t _total,
+                                    const glm::dmat3& _equatorialToEcliptic, double _earthSize, const glm::vec3& _earth,
+                                    glm::vec3* _equat, glm::vec3* _geo, glm::vec3* _helio);
+
+    // Conical Earth shadow and diffuse sphere magnitude seen from the
+    // observer. Straight line code, the branches are selects, so it
+    // vectorizes and costs the same for every object
+    template<typename T>
+    static void illumination(   const EquatorialVector<Unit::KM, T>* _eci, size_t _total, const IlluminationQuery& _query,
+                                uint8_t* _flags, float* _magnitudes);
+
+    // Indices of the flags that have every bit of _mask, without a branch
+    // per object. _out needs room for _total, returns how many were written
+    static size_t select(const uint8_t* _flags, size_t _total, uint8_t _mask, uint32_t* _out);
+
+    // Runs every float kernel against its double twin on synthetic data and
+    // returns false when one exceeds its error budget. Subsystems whose
+    // kernels failed are set to double in _policy, when given
+    static bool check(std::string& _report, PrecisionPolicy* _policy = nullptr, size_t _samples = 10000);
+};
@@ -0,0 +1,197 @@
+//
+//  SatelliteCache.cpp
+//  Solar
+//
+
+#include "SatelliteCache.h"
+
+#include <cmath>
+
+#include "Astro/src/TimeOps.h"
+
+// Earth gravitational parameter (km^3/s^2), only used to estimate the period
+#define SATELLITE_CACHE_MU 398600.4418
+#define SATELLITE_CACHE_TAU 6.283185307179586
+
+SatelliteCache::SatelliteCache() :
+    m_timeStep(0.0),
+    m_knotsPerRev(32),
+    m_requested(0),
+    m_running(false),
+    m_propagations(0),
+    m_lookups(0) {
+}
+
+SatelliteCache::~SatelliteCache() {
+    stop();
+}
+
+StateKnot SatelliteCache::evaluate(Satellite& _sat, double _jd) {
+    Observer obs;
+    obs.setJD(_jd);
+    _sat.compute(obs);
+
+    Vector p = _sat.getECI().getPosition(KM);
+    Vector v = _sat.getECI().getVelocity();
+
+    StateKnot knot;
+    knot.jd = _jd;
+    knot.position = glm::dvec3(p.x, p.y, p.z);
+    knot.velocity = glm::dvec3(v.x, v.y, v.z) * 86400.0;
+    return knot;
+}
+
+double SatelliteCache::estimateInterval(Satellite& _sat, double _jd, int _knotsPerRev) {
+    // Period from vis-viva on the current state, so no TLE parsing is needed
+    StateKnot now = evaluate(_sat, _jd);
+    double r = glm::length(now.position);
+    double v = glm::length(now.velocity) / 86400.0;
+    double a = 1.0 / (2.0 / r - v * v / SATELLITE_CACHE_MU);
+    if (a <= 0.0 || _knotsPerRev <= 0) {
+        return 0.0;
+    }
+    double period = SATELLITE_CACHE_TAU * std::sqrt(a * a * a / SATELLITE_CACHE_MU) / 86400.0;
+    return period / _knotsPerRev;
+}
+
+void SatelliteCache::add(const Satellite& _sat) {
+    std::unique_ptr<Track> track(new Track());
+    track->propagator = _sat;
+    track->seeder = _sat;
+    track->valid = false;
+    track->state = IDLE;
+    track->interval = estimateInterval(track->propagator, TimeOps::now(UTC), m_knotsPerRev);
+
+    m_tracks.push_back(std::move(track));
+    m_segments.push_back(StateSegment());
+}
+
+double SatelliteCache::getInterval(size_t _index) const {
+    return m_tracks[_index]->interval;
+}
+
+void SatelliteCache::seed(size_t _index, double _jd) {
+    Track& track = *m_tracks[_index];
+    StateSegment& segment = m_segments[_index];
+    double t0 = std::floor(_jd / track.interval) * track.interval;
+    segment.k0 = evaluate(track.seeder, t0);
+    segment.k1 = evaluate(track.seeder, t0 + track.interval);
+    track.valid = true;
+    m_propagations += 2;
+}
+
+void SatelliteCache::request(Track& _track, double _jd) {
+    if (_track.state.load(std::memory_order_acquire) != IDLE) {
+        return;
+    }
+    _track.ahead.jd = _jd;
+    _track.state.store(REQUESTED, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requested++;
+    }
+    m_wake.notify_one();
+}
+
+void SatelliteCache::prepare(size_t _index, double _jd) {
+    Track& track = *m_tracks[_index];
+    StateSegment& segment = m_segments[_index];
+
+    // Knots further apart than a frame step buy nothing. A zero length
+    // segment makes the kernel return k0 as is
+    if (track.interval <= std::abs(m_timeStep)) {
+        segment.k0 = segment.k1 = evaluate(track.seeder, _jd);
+        track.valid = false;
+        m_propagations++;
+        return;
+    }
+
+    bool forward = m_timeStep >= 0.0;
+    double tolerance = track.interval * 0.01;
+
+    if (track.valid && track.state.load(std::memory_order_acquire) == READY) {
+        const StateKnot& ahead = track.ahead;
+        bool next = std::abs(ahead.jd - (segment.k1.jd + track.interval)) < tolerance;
+        bool prev = std::abs(ahead.jd - (segment.k0.jd - track.interval)) < tolerance;
+
+        if (next && _jd > segment.k1.jd && _jd <= ahead.jd) {
+            segment.k0 = segment.k1;
+            segment.k1 = ahead;
+            track.state.store(IDLE, std::memory_order_release);
+        }
+        else if (prev && _jd < segment.k0.jd && _jd >= ahead.jd) {
+            segment.k1 = segment.k0;
+            segment.k0 = ahead;
+            track.state.store(IDLE, std::memory_order_release);
+        }
+        else if (!(next && forward) && !(prev && !forward)) {
+            // Stale (seek or direction change): drop it
+            track.state.store(IDLE, std::memory_order_release);
+        }
+    }
+
+    if (!track.valid || _jd < segment.k0.jd || _jd > segment.k1.jd) {
+        seed(_index, _jd);
+    }
+
+    request(track, forward? segment.k1.jd + track.interval : segment.k0.jd - track.interval);
+}
+
+glm::dvec3 SatelliteCache::getPosition(size_t _index, double _jd) {
+    prepare(_index, _jd);
+    m_lookups++;
+
+    EquatorialVector<Unit::KM> position;
+    KernelOps::hermite<double>(&m_segments[_index], 1, _jd, &position);
+    return position.toDvec3();
+}
+
+void SatelliteCache::getStats(size_t& _propagations, size_t& _lookups, bool _reset) {
+    _propagations = m_propagations;
+    _lookups = m_lookups;
+    if (_reset) {
+        m_propagations = 0;
+        m_lookups = 0;
+    }
+}
+
+void SatelliteCache::start() {
+    m_requested = 0;
+    m_running = true;
+    m_thread = std::thread(&SatelliteCache::work, this);
+}
+
+void SatelliteCache::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void SatelliteCache::work() {
+    while (true) {
+        {
+            // Sleep until request() counts new work. Requests made while the
+            // sweep below runs are either picked up by it or wake the next wait
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]{ return m_requested > 0 || !m_running; });
+            if (!m_running) {
+                return;
+            }
+            m_requested = 0;
+        }
+
+        for (size_t i = 0; i < m_tracks.size(); i++) {
+            Track& track = *m_tracks[i];
+            if (track.state.load(std::memory_order_acquire) == REQUESTED) {
+                track.ahead = evaluate(track.propagator, track.ahead.jd);
+                m_propagations++;
+                track.state.store(READY, std::memory_order_release);
+            }
+        }
+    }
+}
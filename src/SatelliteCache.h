@@ -0,0 +1,111 @@
+//
+//  SatelliteCache.h
+//  Solar
+//
+//  Evaluates SGP4 only at sparse knots and interpolates the ECI state in
+//  between with cubic Hermite splines. Knot spacing follows each orbit's
+//  period, and the next knot along the playhead is computed ahead of time
+//  on a worker thread. The cache propagates its own copies of every
+//  satellite, so the caller's objects keep the state of the current frame.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "glm/glm.hpp"
+#include "Astro/src/Satellite.h"
+
+#include "KernelOps.h"
+
+class SatelliteCache {
+public:
+    SatelliteCache();
+    virtual ~SatelliteCache();
+
+    // Takes a private copy of each propagator. Call again when the catalog changes
+    template<typename SAT>
+    void        setup(const std::vector<SAT>& _satellites) {
+        stop();
+        m_tracks.clear();
+        m_segments.clear();
+        for (size_t i = 0; i < _satellites.size(); i++) {
+            add(_satellites[i]);
+        }
+        start();
+    }
+
+    // Days per frame; negative when playing backwards
+    void        setTimeStep(double _days) { m_timeStep = _days; }
+    void        setKnotsPerRevolution(int _knots) { m_knotsPerRev = _knots; }
+
+    // ECI position (km) of satellite _index at _jd. SGP4 only runs when no
+    // cached segment covers _jd (seeks, first frame, fast playback)
+    glm::dvec3  getPosition(size_t _index, double _jd);
+
+    // Same for the whole catalog at once, interpolated in T precision
+    template<typename T, typename A>
+    void        getPositions(double _jd, std::vector< EquatorialVector<Unit::KM, T>, A >& _out) {
+        _out.resize(m_tracks.size());
+        getPositions(_jd, _out, 0, m_tracks.size());
+    }
+
+    // Only satellites [_begin, _end), into an _out already sized for the catalog.
+    // Disjoint ranges can run on different threads at the same time
+    template<typename T, typename A>
+    void        getPositions(double _jd, std::vector< EquatorialVector<Unit::KM, T>, A >& _out, size_t _begin, size_t _end) {
+        for (size_t i = _begin; i < _end; i++) {
+            prepare(i, _jd);
+        }
+        KernelOps::hermite<T>(m_segments.data() + _begin, _end - _begin, _jd, _out.data() + _begin);
+        m_lookups += _end - _begin;
+    }
+
+    double      getInterval(size_t _index) const;
+    size_t      size() const { return m_tracks.size(); }
+
+    // SGP4 evaluations vs. interpolated lookups since the last call
+    void        getStats(size_t& _propagations, size_t& _lookups, bool _reset = true);
+
+    static StateKnot    evaluate(Satellite& _sat, double _jd);
+    // Days between knots for _knotsPerRev knots per orbit, 0 when the orbit is not bound
+    static double       estimateInterval(Satellite& _sat, double _jd, int _knotsPerRev);
+
+protected:
+    enum { IDLE = 0, REQUESTED, READY };
+
+    struct Track {
+        Satellite       propagator;     // owned by the worker
+        Satellite       seeder;         // owned by whoever calls prepare() on this track
+        double          interval;       // days between knots
+        bool            valid;          // m_segments holds two cached knots
+        StateKnot       ahead;
+        std::atomic<int> state;
+    };
+
+    void        add(const Satellite& _sat);
+    void        prepare(size_t _index, double _jd);
+    void        request(Track& _track, double _jd);
+    void        seed(size_t _index, double _jd);
+    void        start();
+    void        stop();
+    void        work();
+
+    std::vector< std::unique_ptr<Track> > m_tracks;
+    std::vector<StateSegment>   m_segments;     // read by the interpolation kernel
+    double      m_timeStep;
+    int         m_knotsPerRev;
+
+    std::thread             m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    size_t                  m_requested;    // guarded by m_mutex
+    bool                    m_running;      // guarded by m_mutex
+    std::atomic<size_t>     m_propagations;
+    std::atomic<size_t>     m_lookups;
+};
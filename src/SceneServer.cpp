@@ -0,0 +1,601 @@
+//
+//  SceneServer.cpp
+//  Solar
+//
+
+#include "SceneServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Timeline.h"
+
+#define SERVER_MAX_CLIENTS      32
+#define SERVER_MAX_INPUT        65536
+#define SERVER_POLL_MS          250
+#define SERVER_DEFAULT_QUANTUM  0.0001f
+#define SERVER_SNAPSHOT         1
+#define SERVER_DELTA            2
+
+#ifdef MSG_NOSIGNAL
+#define SERVER_SEND_FLAGS       MSG_NOSIGNAL
+#else
+#define SERVER_SEND_FLAGS       0
+#endif
+
+namespace {
+
+// SHA-1 and base64, just enough for Sec-WebSocket-Accept
+uint32_t rotl(uint32_t _x, int _n) {
+    return (_x << _n) | (_x >> (32 - _n));
+}
+
+std::string sha1(const std::string& _message) {
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    std::string data = _message;
+    uint64_t bits = uint64_t(_message.size()) * 8;
+    data += char(0x80);
+    while (data.size() % 64 != 56) {
+        data += char(0);
+    }
+    for (int i = 7; i >= 0; i--) {
+        data += char((bits >> (i * 8)) & 0xFF);
+    }
+
+    for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* p = (const unsigned char*)data.data() + chunk + i * 4;
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20)         { f = (b & c) | (~b & d);           k = 0x5A827999; }
+            else if (i < 40)    { f = b ^ c ^ d;                    k = 0x6ED9EBA1; }
+            else if (i < 60)    { f = (b & c) | (b & d) | (c & d);  k = 0x8F1BBCDC; }
+            else                { f = b ^ c ^ d;                    k = 0xCA62C1D6; }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    std::string digest;
+    for (int i = 0; i < 5; i++) {
+        for (int j = 3; j >= 0; j--) {
+            digest += char((h[i] >> (j * 8)) & 0xFF);
+        }
+    }
+    return digest;
+}
+
+std::string base64(const std::string& _data) {
+    static const char* table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < _data.size(); i += 3) {
+        uint32_t n = uint32_t((unsigned char)_data[i]) << 16;
+        if (i + 1 < _data.size()) n |= uint32_t((unsigned char)_data[i + 1]) << 8;
+        if (i + 2 < _data.size()) n |= uint32_t((unsigned char)_data[i + 2]);
+        out += table[(n >> 18) & 63];
+        out += table[(n >> 12) & 63];
+        out += (i + 1 < _data.size())? table[(n >> 6) & 63] : '=';
+        out += (i + 2 < _data.size())? table[n & 63] : '=';
+    }
+    return out;
+}
+
+// Server frames are never masked
+std::string frame(uint8_t _opcode, const std::string& _payload) {
+    std::string out;
+    out += char(0x80 | _opcode);
+    uint64_t size = _payload.size();
+    if (size < 126) {
+        out += char(size);
+    }
+    else if (size < 65536) {
+        out += char(126);
+        out += char((size >> 8) & 0xFF);
+        out += char(size & 0xFF);
+    }
+    else {
+        out += char(127);
+        for (int i = 7; i >= 0; i--) {
+            out += char((size >> (i * 8)) & 0xFF);
+        }
+    }
+    return out + _payload;
+}
+
+bool bigEndianHost() {
+    const uint16_t probe = 1;
+    return *(const unsigned char*)&probe == 0;
+}
+
+// Appends _value in little endian byte order, whatever the host uses
+template<typename T>
+void put(std::string& _out, const T& _value) {
+    const char* bytes = (const char*)&_value;
+    size_t at = _out.size();
+    _out.append(bytes, sizeof(T));
+    if (bigEndianHost()) {
+        std::reverse(_out.begin() + at, _out.end());
+    }
+}
+
+// Same for a whole array, in one copy when the host is already little endian
+template<typename T>
+void put(std::string& _out, const std::vector<T>& _values) {
+    if (!bigEndianHost()) {
+        _out.append((const char*)_values.data(), _values.size() * sizeof(T));
+        return;
+    }
+    for (size_t i = 0; i < _values.size(); i++) {
+        put(_out, _values[i]);
+    }
+}
+
+std::string header(const std::string& _request, const std::string& _name) {
+    std::string lower = _request;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    size_t pos = lower.find("\r\n" + _name + ":");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    pos += _name.size() + 3;
+    size_t end = _request.find("\r\n", pos);
+    std::string value = _request.substr(pos, end - pos);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t") + 1);
+    return value;
+}
+
+void setNonBlocking(int _fd) {
+    fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+}
+
+SceneServer::SceneServer() :
+    m_tick(0),
+    m_hasPending(false),
+    m_eventsLost(false),
+    m_running(false),
+    m_wantsState(false),
+    m_clients(0),
+    m_listen(-1),
+    m_maxMessages(256),
+    m_maxBytes(8 * 1024 * 1024) {
+    m_wake[0] = m_wake[1] = -1;
+}
+
+SceneServer::~SceneServer() {
+    stop();
+}
+
+void SceneServer::setQueueLimit(size_t _messages, size_t _bytes) {
+    m_maxMessages = std::max<size_t>(2, _messages);
+    m_maxBytes = _bytes;
+}
+
+bool SceneServer::start(int _port, const std::string& _address) {
+    stop();
+    m_error = "";
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(uint16_t(_port));
+    if (inet_pton(AF_INET, _address.c_str(), &address.sin_addr) != 1) {
+        m_error = "invalid address " + _address;
+        return false;
+    }
+
+    m_listen = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (m_listen < 0 ||
+        bind(m_listen, (sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(m_listen, 16) != 0 ||
+        pipe(m_wake) != 0) {
+        m_error = std::strerror(errno);
+        stop();
+        return false;
+    }
+    setNonBlocking(m_listen);
+    setNonBlocking(m_wake[0]);
+    setNonBlocking(m_wake[1]);
+
+    m_tick = 0;
+    m_previous.clear();
+    m_quanta.clear();
+    m_running = true;
+    m_thread = std::thread(&SceneServer::run, this);
+    return true;
+}
+
+void SceneServer::stop() {
+    if (m_running) {
+        m_running = false;
+        char byte = 0;
+        if (write(m_wake[1], &byte, 1) < 0) {
+            // the thread still wakes up on its poll timeout
+        }
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    for (size_t i = 0; i < m_list.size(); i++) {
+        if (m_list[i].fd >= 0) {
+            close(m_list[i].fd);
+        }
+    }
+    m_list.clear();
+    m_clients = 0;
+    m_wantsState = false;
+
+    int* fds[] = { &m_listen, &m_wake[0], &m_wake[1] };
+    for (int i = 0; i < 3; i++) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hasPending = false;
+    m_events.clear();
+    m_eventsLost = false;
+}
+
+void SceneServer::publish(SceneFrame&& _frame) {
+    if (!m_running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // A state that was not sent yet describes an older frame and can't go
+        // out with this one: drop it and ask for a fresh one
+        if (m_hasPending && !m_pending.state.empty() && _frame.state.empty()) {
+            m_wantsState = true;
+        }
+        _frame.keyframe = _frame.keyframe || (m_hasPending && m_pending.keyframe);
+        m_pending = std::move(_frame);
+        m_hasPending = true;
+    }
+    char byte = 1;
+    if (write(m_wake[1], &byte, 1) < 0) {
+        // pipe full: a wake up is already pending
+    }
+}
+
+void SceneServer::publishEvent(const std::string& _json) {
+    if (!m_running) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_events.size() < m_maxMessages) {
+        m_events.push_back(_json);
+    }
+    else {
+        // Clients can't follow the HUD anymore, they resync from the next state
+        m_eventsLost = true;
+        m_wantsState = true;
+    }
+}
+
+bool SceneServer::enqueue(Client& _client, std::string&& _data) {
+    if (_client.output.size() >= m_maxMessages || _client.outputBytes + _data.size() > m_maxBytes) {
+        return false;
+    }
+    _client.outputBytes += _data.size();
+    _client.output.push_back(std::move(_data));
+    return true;
+}
+
+void SceneServer::broadcast(SceneFrame& _frame, std::vector<std::string>& _events, bool _eventsLost) {
+    if (_frame.quanta.size() != _frame.values.size()) {
+        _frame.quanta.assign(_frame.values.size(), SERVER_DEFAULT_QUANTUM);
+    }
+    std::vector<int32_t> q(_frame.values.size());
+    for (size_t i = 0; i < q.size(); i++) {
+        q[i] = Timeline::quantize(_frame.values[i], _frame.quanta[i]);
+    }
+    bool layoutChanged = _frame.keyframe || (_frame.quanta != m_quanta);
+    // Snapshots go out only with a state taken at the same frame
+    bool freshState = !_frame.state.empty();
+    if (freshState) {
+        m_state.swap(_frame.state);
+    }
+    m_tick++;
+
+    // Messages are built once and copied into the queues that want them
+    std::string snapshot, delta;
+    std::string head;
+    put(head, m_tick);
+    put(head, _frame.jd);
+    put(head, uint32_t(q.size()));
+
+    bool wants = false;
+    for (size_t c = 0; c < m_list.size(); c++) {
+        Client& client = m_list[c];
+        if (!client.open || client.closing || client.fd < 0) {
+            continue;
+        }
+        if (layoutChanged || _eventsLost) {
+            client.needsSnapshot = true;
+        }
+
+        if (!client.needsSnapshot) {
+            for (size_t e = 0; e < _events.size() && !client.needsSnapshot; e++) {
+                client.needsSnapshot = !enqueue(client, frame(0x1, _events[e]));
+            }
+            if (!client.needsSnapshot) {
+                if (delta.empty()) {
+                    std::string payload;
+                    payload += char(SERVER_DELTA);
+                    payload += head;
+                    for (size_t i = 0; i < q.size(); i++) {
+                        Timeline::putVarint(payload, q[i] - m_previous[i]);
+                    }
+                    delta = frame(0x2, payload);
+                }
+                // Behind: no more deltas until it drained and got a snapshot
+                client.needsSnapshot = !enqueue(client, std::string(delta));
+            }
+        }
+        else if (client.output.empty() && freshState) {
+            if (snapshot.empty()) {
+                std::string payload;
+                payload += char(SERVER_SNAPSHOT);
+                payload += head;
+                put(payload, _frame.quanta);
+                put(payload, q);
+                snapshot = frame(0x2, payload);
+            }
+            client.needsSnapshot = !(enqueue(client, frame(0x1, m_state)) && enqueue(client, std::string(snapshot)));
+        }
+        wants = wants || client.needsSnapshot;
+    }
+
+    m_previous.swap(q);
+    m_quanta = _frame.quanta;
+    m_wantsState = wants;
+}
+
+bool SceneServer::handshake(Client& _client) {
+    size_t end = _client.input.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        return _client.input.size() < SERVER_MAX_INPUT;
+    }
+    std::string request = _client.input.substr(0, end + 2);
+    _client.input.erase(0, end + 4);
+
+    std::string key = header(request, "sec-websocket-key");
+    if (request.compare(0, 4, "GET ") != 0 || key.empty()) {
+        std::string reply = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        enqueue(_client, std::move(reply));
+        _client.closing = true;
+        return true;
+    }
+
+    std::string accept = base64(sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+    std::string reply = "HTTP/1.1 101 Switching Protocols\r\n"
+                        "Upgrade: websocket\r\n"
+                        "Connection: Upgrade\r\n"
+                        "Sec-WebSocket-Accept: " + accept + "\r\n\r\n";
+    enqueue(_client, std::move(reply));
+    _client.open = true;
+    _client.needsSnapshot = true;
+    m_wantsState = true;
+    return true;
+}
+
+void SceneServer::readFrames(Client& _client) {
+    // Clients only matter for pings and closing, everything else is ignored
+    while (_client.input.size() >= 2) {
+        const unsigned char* p = (const unsigned char*)_client.input.data();
+        uint8_t opcode = p[0] & 0x0F;
+        bool masked = (p[1] & 0x80) != 0;
+        uint64_t size = p[1] & 0x7F;
+        size_t pos = 2;
+        if (size == 126) {
+            if (_client.input.size() < 4) return;
+            size = (uint64_t(p[2]) << 8) | p[3];
+            pos = 4;
+        }
+        else if (size == 127) {
+            if (_client.input.size() < 10) return;
+            size = 0;
+            for (int i = 0; i < 8; i++) {
+                size = (size << 8) | p[2 + i];
+            }
+            pos = 10;
+        }
+        if (size > SERVER_MAX_INPUT) {
+            _client.closing = true;
+            _client.input.clear();
+            return;
+        }
+        size_t total = pos + (masked? 4 : 0) + size_t(size);
+        if (_client.input.size() < total) {
+            return;
+        }
+
+        std::string payload = _client.input.substr(pos + (masked? 4 : 0), size_t(size));
+        if (masked) {
+            for (size_t i = 0; i < payload.size(); i++) {
+                payload[i] ^= char(p[pos + (i % 4)]);
+            }
+        }
+        _client.input.erase(0, total);
+
+        if (opcode == 0x8) {
+            _client.output.push_back(frame(0x8, payload.substr(0, 2)));
+            _client.outputBytes += _client.output.back().size();
+            _client.closing = true;
+            return;
+        }
+        else if (opcode == 0x9) {
+            enqueue(_client, frame(0xA, payload));
+        }
+    }
+}
+
+bool SceneServer::flush(Client& _client) {
+    while (!_client.output.empty()) {
+        const std::string& data = _client.output.front();
+        ssize_t n = send(_client.fd, data.data() + _client.sent, data.size() - _client.sent, SERVER_SEND_FLAGS);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        _client.sent += size_t(n);
+        if (_client.sent < data.size()) {
+            return true;
+        }
+        _client.outputBytes -= data.size();
+        _client.output.pop_front();
+        _client.sent = 0;
+    }
+    return true;
+}
+
+void SceneServer::run() {
+    std::vector<pollfd> fds;
+    SceneFrame frame;
+    std::vector<std::string> events;
+
+    while (m_running) {
+        fds.clear();
+        pollfd entry;
+        entry.fd = m_listen;
+        entry.events = POLLIN;
+        fds.push_back(entry);
+        entry.fd = m_wake[0];
+        fds.push_back(entry);
+        for (size_t i = 0; i < m_list.size(); i++) {
+            entry.fd = m_list[i].fd;
+            entry.events = POLLIN | (m_list[i].output.empty()? 0 : POLLOUT);
+            fds.push_back(entry);
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            fds[i].revents = 0;
+        }
+
+        if (poll(fds.data(), fds.size(), SERVER_POLL_MS) < 0 && errno != EINTR) {
+            break;
+        }
+        if (!m_running) {
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            char buffer[256];
+            while (read(m_wake[0], buffer, sizeof(buffer)) > 0) {}
+        }
+
+        // Take whatever the simulation left, without holding the lock while sending
+        bool hasFrame = false;
+        bool eventsLost = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_hasPending) {
+                frame = std::move(m_pending);
+                m_pending = SceneFrame();
+                m_hasPending = false;
+                hasFrame = true;
+                events.swap(m_events);
+                m_events.clear();
+                eventsLost = m_eventsLost;
+                m_eventsLost = false;
+            }
+        }
+        if (hasFrame) {
+            broadcast(frame, events, eventsLost);
+            events.clear();
+        }
+
+        const size_t polled = fds.size() - 2;
+        for (size_t i = 0; i < polled; i++) {
+            Client& client = m_list[i];
+            short revents = fds[i + 2].revents;
+            bool alive = !(revents & (POLLERR | POLLNVAL));
+
+            if (alive && (revents & (POLLIN | POLLHUP))) {
+                char buffer[4096];
+                ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+                if (n > 0) {
+                    client.input.append(buffer, size_t(n));
+                    if (!client.open) {
+                        alive = handshake(client);
+                    }
+                    if (client.open) {
+                        readFrames(client);
+                    }
+                }
+                else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    alive = false;
+                }
+            }
+
+            if (!alive) {
+                close(client.fd);
+                client.fd = -1;
+            }
+        }
+
+        // Write as much as each socket takes right now, never waiting on one
+        for (size_t i = 0; i < m_list.size(); i++) {
+            Client& client = m_list[i];
+            if (client.fd >= 0 && (!flush(client) || (client.closing && client.output.empty()))) {
+                close(client.fd);
+                client.fd = -1;
+            }
+        }
+        m_list.erase(std::remove_if(m_list.begin(), m_list.end(), [](const Client& _client) { return _client.fd < 0; }), m_list.end());
+
+        if (fds[0].revents & POLLIN) {
+            while (true) {
+                int fd = accept(m_listen, nullptr, nullptr);
+                if (fd < 0) {
+                    break;
+                }
+                if (m_list.size() >= SERVER_MAX_CLIENTS) {
+                    close(fd);
+                    continue;
+                }
+                setNonBlocking(fd);
+#ifdef SO_NOSIGPIPE
+                int yes = 1;
+                setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+                Client client;
+                client.fd = fd;
+                m_list.push_back(client);
+            }
+        }
+
+        size_t open = 0;
+        for (size_t i = 0; i < m_list.size(); i++) {
+            open += m_list[i].open? 1 : 0;
+        }
+        m_clients = open;
+    }
+}
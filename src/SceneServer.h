@@ -0,0 +1,108 @@
+//
+//  SceneServer.h
+//  Solar
+//
+//  Optional WebSocket server that mirrors the scene to dashboards. It runs
+//  on its own thread; publish() and publishEvent() only hand data over and
+//  never wait on the network.
+//
+//  Every client gets, on connect, the last state JSON (text frame, layout
+//  and HUD history) and a binary snapshot, then one binary delta per tick
+//  and HUD events as text frames. Binary messages, little endian:
+//
+//      uint8 type (1 snapshot, 2 delta), uint32 tick, float64 jd, uint32 count
+//      snapshot:   float32 quantum[count], int32 value[count]
+//      delta:      zigzag varint of the change of each quantized value
+//
+//  value = quantized * quantum, exactly as in Timeline. Each client has a
+//  bounded send queue; a client that falls behind stops receiving deltas
+//  and is sent a new snapshot once its queue drains. Events that overflow
+//  the server's own queue are dropped and every client resyncs from a
+//  snapshot, whose state already holds them.
+//
+//  POSIX sockets only. Binds to loopback unless told otherwise.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SceneFrame {
+    double              jd = 0.0;
+    std::vector<float>  values;
+    std::vector<float>  quanta;
+    // JSON with the layout and HUD history. Only needed when wantsState() or on keyframes
+    std::string         state;
+    // The meaning of the values changed: every client gets a new snapshot
+    bool                keyframe = false;
+};
+
+class SceneServer {
+public:
+    SceneServer();
+    virtual ~SceneServer();
+
+    bool        start(int _port, const std::string& _address = "127.0.0.1");
+    void        stop();
+    bool        isRunning() const { return m_running; }
+    const std::string& getError() const { return m_error; }
+
+    // Whether a client is waiting for a snapshot, so the next frame should carry its state
+    bool        wantsState() const { return m_wantsState; }
+    size_t      getClients() const { return m_clients; }
+
+    // Latest frame wins: frames published faster than the server sends are merged
+    void        publish(SceneFrame&& _frame);
+    // JSON text for every client in sync, sent before the next frame
+    void        publishEvent(const std::string& _json);
+
+    // Per client limits before it is considered behind
+    void        setQueueLimit(size_t _messages, size_t _bytes);
+
+protected:
+    struct Client {
+        int                     fd = -1;
+        bool                    open = false;       // handshake done
+        bool                    closing = false;
+        bool                    needsSnapshot = true;
+        std::string             input;
+        std::deque<std::string> output;
+        size_t                  outputBytes = 0;
+        size_t                  sent = 0;           // of output.front()
+    };
+
+    void        run();
+    void        broadcast(SceneFrame& _frame, std::vector<std::string>& _events, bool _eventsLost);
+    bool        enqueue(Client& _client, std::string&& _data);
+    bool        handshake(Client& _client);
+    void        readFrames(Client& _client);
+    bool        flush(Client& _client);
+
+    std::vector<Client>     m_list;
+    std::vector<int32_t>    m_previous;     // quantized values of the last tick
+    std::vector<float>      m_quanta;
+    std::string             m_state;
+    uint32_t                m_tick;
+
+    std::mutex              m_mutex;
+    SceneFrame              m_pending;
+    bool                    m_hasPending;
+    std::vector<std::string> m_events;
+    bool                    m_eventsLost;   // m_events overflowed since the last broadcast
+
+    std::thread             m_thread;
+    std::string             m_error;
+    std::atomic<bool>       m_running;
+    std::atomic<bool>       m_wantsState;
+    std::atomic<size_t>     m_clients;
+    int                     m_listen;
+    int                     m_wake[2];
+    size_t                  m_maxMessages;
+    size_t                  m_maxBytes;
+};
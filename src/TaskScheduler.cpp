@@ -0,0 +1,154 @@
+//
+//  TaskScheduler.cpp
+//  Solar
+//
+
+#include "TaskScheduler.h"
+
+#include <algorithm>
+
+TaskScheduler::TaskScheduler() :
+    m_pending(0),
+    m_sleeping(0),
+    m_running(false) {
+    unsigned int cores = std::thread::hardware_concurrency();
+    start((cores > 1)? cores - 1 : 0);
+}
+
+TaskScheduler::~TaskScheduler() {
+    stop();
+}
+
+void TaskScheduler::setWorkers(unsigned int _workers) {
+    if (_workers == m_threads.size()) {
+        return;
+    }
+    stop();
+    start(_workers);
+}
+
+void TaskScheduler::start(unsigned int _workers) {
+    m_queues.clear();
+    for (unsigned int i = 0; i <= _workers; i++) {
+        m_queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+
+    m_running = true;
+    for (unsigned int i = 0; i < _workers; i++) {
+        m_threads.push_back(std::thread(&TaskScheduler::work, this, i + 1));
+    }
+}
+
+void TaskScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wake.notify_all();
+    for (size_t i = 0; i < m_threads.size(); i++) {
+        m_threads[i].join();
+    }
+    m_threads.clear();
+}
+
+void TaskScheduler::parallelFor(size_t _begin, size_t _end, size_t _grain, const RangeBody& _body) {
+    if (_end <= _begin) {
+        return;
+    }
+    _grain = std::max<size_t>(1, _grain);
+    if (m_threads.empty() || _end - _begin <= _grain) {
+        _body(_begin, _end);
+        return;
+    }
+
+    Job job;
+    job.body = &_body;
+    job.grain = _grain;
+    job.remaining = _end - _begin;
+
+    Task task;
+    task.job = &job;
+    task.begin = _begin;
+    task.end = _end;
+    run(0, task);
+
+    // Help with whatever is left until the last chunk, maybe on a worker, is done
+    while (job.remaining.load(std::memory_order_acquire) > 0) {
+        if (pop(0, task) || steal(0, task)) {
+            run(0, task);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskScheduler::push(size_t _queue, const Task& _task) {
+    // Counted first, so m_pending never drops below the tasks really queued
+    m_pending++;
+    {
+        std::lock_guard<std::mutex> lock(m_queues[_queue]->mutex);
+        m_queues[_queue]->tasks.push_back(_task);
+    }
+
+    // A worker going to sleep counts itself before it checks m_pending
+    if (m_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake.notify_one();
+    }
+}
+
+bool TaskScheduler::pop(size_t _queue, Task& _task) {
+    Queue& queue = *m_queues[_queue];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    _task = queue.tasks.back();
+    queue.tasks.pop_back();
+    m_pending--;
+    return true;
+}
+
+bool TaskScheduler::steal(size_t _thief, Task& _task) {
+    size_t total = m_queues.size();
+    for (size_t i = 1; i < total; i++) {
+        Queue& queue = *m_queues[(_thief + i) % total];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            _task = queue.tasks.front();
+            queue.tasks.pop_front();
+            m_pending--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::run(size_t _queue, Task _task) {
+    Job& job = *_task.job;
+    while (_task.end - _task.begin > job.grain) {
+        Task upper = _task;
+        upper.begin = _task.begin + (_task.end - _task.begin) / 2;
+        _task.end = upper.begin;
+        push(_queue, upper);
+    }
+
+    (*job.body)(_task.begin, _task.end);
+    job.remaining.fetch_sub(_task.end - _task.begin, std::memory_order_acq_rel);
+}
+
+void TaskScheduler::work(size_t _index) {
+    Task task;
+    while (m_running) {
+        if (pop(_index, task) || steal(_index, task)) {
+            run(_index, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping++;
+        m_wake.wait(lock, [this]() { return m_pending.load() > 0 || !m_running; });
+        m_sleeping--;
+    }
+}
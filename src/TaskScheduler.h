@@ -0,0 +1,82 @@
+//
+//  TaskScheduler.h
+//  Solar
+//
+//  A small work-stealing pool for the data-parallel loops of the frame.
+//  parallelFor() hands a range to the pool as one task; whoever runs a
+//  task keeps splitting it in halves, pushing the upper half on the back
+//  of its own deque and working on the lower one until it is no bigger
+//  than the grain. Idle threads steal from the front of other deques, so
+//  they take the biggest pieces left and uneven work (an SGP4 seed here
+//  and there among interpolated satellites) balances itself.
+//
+//  The calling thread works too and parallelFor() only returns once the
+//  whole range is done. Ranges up to the grain, or a pool without
+//  workers, run inline on the caller.
+//
+//  Several threads may call parallelFor() at once (the frame update and
+//  an export in the background). While waiting, a caller can run chunks
+//  of the other loop, so background jobs should keep their grain small.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskScheduler {
+public:
+    // _workers threads besides the caller, by default one per extra core
+    TaskScheduler();
+    virtual ~TaskScheduler();
+
+    void        setWorkers(unsigned int _workers);
+    unsigned int getWorkers() const { return (unsigned int)m_threads.size(); }
+
+    typedef std::function<void(size_t _begin, size_t _end)> RangeBody;
+
+    // Calls _body over disjoint chunks of [_begin, _end) of at most _grain items
+    void        parallelFor(size_t _begin, size_t _end, size_t _grain, const RangeBody& _body);
+
+protected:
+    struct Job {
+        const RangeBody*    body;
+        size_t              grain;
+        std::atomic<size_t> remaining;  // items not done yet
+    };
+
+    struct Task {
+        Job*    job;
+        size_t  begin, end;
+    };
+
+    struct Queue {
+        std::mutex          mutex;
+        std::deque<Task>    tasks;
+    };
+
+    void        start(unsigned int _workers);
+    void        stop();
+    void        work(size_t _index);
+
+    void        push(size_t _queue, const Task& _task);
+    bool        pop(size_t _queue, Task& _task);
+    bool        steal(size_t _thief, Task& _task);
+    void        run(size_t _queue, Task _task);
+
+    // Queue 0 belongs to whoever calls parallelFor(), workers own the rest
+    std::vector< std::unique_ptr<Queue> > m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::atomic<size_t>     m_pending;      // tasks sitting in queues
+    std::atomic<unsigned int> m_sleeping;
+    std::atomic<bool>       m_running;
+};
@@ -0,0 +1,395 @@
+//
+//  Timeline.cpp
+//  Solar
+//
+
+#include "Timeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define TIMELINE_KEYFRAME       1
+#define TIMELINE_DELTA          2
+#define TIMELINE_HEADER_SIZE    8
+#define TIMELINE_FOOTER_SIZE    20
+#define TIMELINE_DEFAULT_QUANTUM 0.0001f
+
+namespace {
+
+template<typename T>
+void put(std::string& _out, const T& _value) {
+    _out.append((const char*)&_value, sizeof(T));
+}
+
+template<typename T>
+bool get(const std::string& _in, size_t& _pos, T& _value) {
+    if (_pos + sizeof(T) > _in.size()) {
+        return false;
+    }
+    std::memcpy(&_value, _in.data() + _pos, sizeof(T));
+    _pos += sizeof(T);
+    return true;
+}
+
+bool getVarint(const std::string& _in, size_t& _pos, int32_t& _value) {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (_pos >= _in.size()) {
+            return false;
+        }
+        uint8_t byte = uint8_t(_in[_pos++]);
+        v |= uint32_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            _value = int32_t(v >> 1) ^ -int32_t(v & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+int32_t Timeline::quantize(float _value, float _quantum) {
+    double q = std::round(double(_value) / _quantum);
+    if (!(q == q)) {
+        return 0;
+    }
+    return int32_t(std::max(-2147483647.0, std::min(2147483647.0, q)));
+}
+
+void Timeline::putVarint(std::string& _out, int32_t _value) {
+    uint32_t v = (uint32_t(_value) << 1) ^ uint32_t(_value >> 31);
+    while (v >= 0x80) {
+        _out += char((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    _out += char(v);
+}
+
+Timeline::Timeline() :
+    m_interval(120),
+    m_sinceKeyframe(0),
+    m_cursor(-1),
+    m_layoutChanged(true),
+    m_writing(false),
+    m_reading(false) {
+}
+
+Timeline::~Timeline() {
+    close();
+}
+
+bool Timeline::create(const std::string& _path, size_t _keyframeInterval) {
+    close();
+    m_file.open(_path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!m_file.is_open()) {
+        return false;
+    }
+
+    m_path = _path;
+    m_interval = std::max<size_t>(1, _keyframeInterval);
+    m_sinceKeyframe = m_interval;
+    m_layoutChanged = true;
+    m_index.clear();
+    m_current.clear();
+
+    uint32_t interval = uint32_t(m_interval);
+    m_file.write("STL1", 4);
+    m_file.write((const char*)&interval, sizeof(interval));
+    m_writing = true;
+    return true;
+}
+
+void Timeline::setLayout(const std::vector<float>& _quanta) {
+    if (_quanta != m_quanta) {
+        m_quanta = _quanta;
+        m_layoutChanged = true;
+    }
+}
+
+void Timeline::record(double _jd, const std::vector<float>& _values, const std::string& _snapshot, const std::string& _delta) {
+    if (!m_writing) {
+        return;
+    }
+
+    if (_values.size() != m_quanta.size()) {
+        setLayout(std::vector<float>(_values.size(), TIMELINE_DEFAULT_QUANTUM));
+    }
+
+    bool key = isKeyframeDue(_values.size());
+    std::vector<int32_t> q(_values.size());
+    for (size_t i = 0; i < _values.size(); i++) {
+        q[i] = quantize(_values[i], m_quanta[i]);
+    }
+
+    m_buffer.clear();
+    put(m_buffer, _jd);
+    if (key) {
+        put(m_buffer, uint32_t(q.size()));
+        m_buffer.append((const char*)m_quanta.data(), m_quanta.size() * sizeof(float));
+        m_buffer.append((const char*)q.data(), q.size() * sizeof(int32_t));
+        put(m_buffer, uint32_t(_snapshot.size()));
+        m_buffer += _snapshot;
+    }
+    else {
+        for (size_t i = 0; i < q.size(); i++) {
+            putVarint(m_buffer, q[i] - m_current[i]);
+        }
+        put(m_buffer, uint32_t(_delta.size()));
+        m_buffer += _delta;
+    }
+
+    Entry entry;
+    entry.jd = _jd;
+    entry.offset = uint64_t(m_file.tellp());
+    entry.keyframe = key? uint32_t(m_index.size()) : m_index.back().keyframe;
+    m_index.push_back(entry);
+
+    uint8_t type = key? TIMELINE_KEYFRAME : TIMELINE_DELTA;
+    uint32_t size = uint32_t(m_buffer.size());
+    m_file.write((const char*)&type, sizeof(type));
+    m_file.write((const char*)&size, sizeof(size));
+    m_file.write(m_buffer.data(), m_buffer.size());
+
+    m_current.swap(q);
+    m_sinceKeyframe = key? 1 : m_sinceKeyframe + 1;
+    m_layoutChanged = false;
+}
+
+void Timeline::close() {
+    if (m_writing) {
+        // Seek index: one entry per frame, then count, where it starts and a tag
+        uint64_t start = uint64_t(m_file.tellp());
+        for (size_t i = 0; i < m_index.size(); i++) {
+            m_file.write((const char*)&m_index[i].jd, sizeof(double));
+            m_file.write((const char*)&m_index[i].offset, sizeof(uint64_t));
+            m_file.write((const char*)&m_index[i].keyframe, sizeof(uint32_t));
+        }
+        uint32_t count = uint32_t(m_index.size());
+        m_file.write((const char*)&count, sizeof(count));
+        m_file.write((const char*)&start, sizeof(start));
+        m_file.write("STLX", 4);
+    }
+    if (m_file.is_open()) {
+        m_file.close();
+    }
+    m_writing = false;
+    m_reading = false;
+    m_cursor = -1;
+}
+
+bool Timeline::open(const std::string& _path) {
+    close();
+    m_file.open(_path.c_str(), std::ios::in | std::ios::binary);
+    if (!m_file.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    uint32_t interval = 0;
+    m_file.read(magic, 4);
+    m_file.read((char*)&interval, sizeof(interval));
+    if (!m_file || std::memcmp(magic, "STL1", 4) != 0) {
+        m_file.close();
+        return false;
+    }
+    m_path = _path;
+    m_interval = interval;
+    m_index.clear();
+
+    m_file.seekg(0, std::ios::end);
+    uint64_t length = uint64_t(m_file.tellg());
+    bool indexed = false;
+    if (length >= TIMELINE_HEADER_SIZE + TIMELINE_FOOTER_SIZE) {
+        char tag[4];
+        uint32_t count = 0;
+        uint64_t start = 0;
+        m_file.seekg(length - TIMELINE_FOOTER_SIZE);
+        m_file.read((char*)&count, sizeof(count));
+        m_file.read((char*)&start, sizeof(start));
+        m_file.read(tag, 4);
+        if (m_file && std::memcmp(tag, "STLX", 4) == 0 && start + count * 20ull + TIMELINE_FOOTER_SIZE == length) {
+            m_index.resize(count);
+            m_file.seekg(start);
+            for (size_t i = 0; i < count; i++) {
+                m_file.read((char*)&m_index[i].jd, sizeof(double));
+                m_file.read((char*)&m_index[i].offset, sizeof(uint64_t));
+                m_file.read((char*)&m_index[i].keyframe, sizeof(uint32_t));
+            }
+            indexed = bool(m_file);
+        }
+    }
+    m_file.clear();
+
+    if (!indexed && !scan()) {
+        m_file.close();
+        return false;
+    }
+
+    m_reading = true;
+    m_cursor = -1;
+    return m_index.size() > 0;
+}
+
+bool Timeline::scan() {
+    // No index: walk the records, stopping at the first incomplete one
+    m_index.clear();
+    m_file.clear();
+    m_file.seekg(0, std::ios::end);
+    uint64_t length = uint64_t(m_file.tellg());
+    m_file.seekg(TIMELINE_HEADER_SIZE);
+    while (true) {
+        uint64_t offset = uint64_t(m_file.tellg());
+        uint8_t type = 0;
+        uint32_t size = 0;
+        double jd = 0.0;
+        m_file.read((char*)&type, sizeof(type));
+        m_file.read((char*)&size, sizeof(size));
+        if (!m_file || (type != TIMELINE_KEYFRAME && type != TIMELINE_DELTA) || size < sizeof(double)) {
+            break;
+        }
+        m_file.read((char*)&jd, sizeof(jd));
+        if (!m_file || offset + 5 + size > length) {
+            break;
+        }
+        m_file.seekg(offset + 5 + size);
+        if (type == TIMELINE_DELTA && m_index.empty()) {
+            break;
+        }
+
+        Entry entry;
+        entry.jd = jd;
+        entry.offset = offset;
+        entry.keyframe = (type == TIMELINE_KEYFRAME)? uint32_t(m_index.size()) : m_index.back().keyframe;
+        m_index.push_back(entry);
+    }
+    m_file.clear();
+    return m_index.size() > 0;
+}
+
+size_t Timeline::find(double _jd) const {
+    if (m_index.empty()) {
+        return 0;
+    }
+    std::vector<Entry>::const_iterator it = std::upper_bound(m_index.begin(), m_index.end(), _jd,
+        [](double _value, const Entry& _entry) { return _value < _entry.jd; });
+    return (it == m_index.begin())? 0 : size_t(it - m_index.begin()) - 1;
+}
+
+bool Timeline::readRecord(size_t _frame, TimelineFrame& _out) {
+    uint8_t type = 0;
+    uint32_t size = 0;
+    m_file.seekg(m_index[_frame].offset);
+    m_file.read((char*)&type, sizeof(type));
+    m_file.read((char*)&size, sizeof(size));
+    m_buffer.resize(size);
+    m_file.read(&m_buffer[0], size);
+    if (!m_file) {
+        m_file.clear();
+        return false;
+    }
+
+    size_t pos = 0;
+    uint32_t length = 0;
+    get(m_buffer, pos, _out.jd);
+    _out.keyframe = (type == TIMELINE_KEYFRAME);
+    if (_out.keyframe) {
+        uint32_t count = 0;
+        get(m_buffer, pos, count);
+        if (pos + count * (sizeof(float) + sizeof(int32_t)) > m_buffer.size()) {
+            return false;
+        }
+        m_quanta.resize(count);
+        m_current.resize(count);
+        std::memcpy(m_quanta.data(), m_buffer.data() + pos, count * sizeof(float));
+        pos += count * sizeof(float);
+        std::memcpy(m_current.data(), m_buffer.data() + pos, count * sizeof(int32_t));
+        pos += count * sizeof(int32_t);
+    }
+    else {
+        for (size_t i = 0; i < m_current.size(); i++) {
+            int32_t delta = 0;
+            if (!getVarint(m_buffer, pos, delta)) {
+                return false;
+            }
+            m_current[i] += delta;
+        }
+    }
+    if (!get(m_buffer, pos, length) || pos + length > m_buffer.size()) {
+        return false;
+    }
+    _out.state.assign(m_buffer, pos, length);
+
+    _out.values.resize(m_current.size());
+    for (size_t i = 0; i < m_current.size(); i++) {
+        _out.values[i] = m_current[i] * m_quanta[i];
+    }
+    return true;
+}
+
+bool Timeline::readStates(const StateCallback& _callback) {
+    if (!m_reading) {
+        return false;
+    }
+
+    std::string buffer;
+    std::string state;
+    uint32_t count = 0;     // values per frame, from the last keyframe
+    for (size_t i = 0; i < m_index.size(); i++) {
+        uint8_t type = 0;
+        uint32_t size = 0;
+        m_file.seekg(m_index[i].offset);
+        m_file.read((char*)&type, sizeof(type));
+        m_file.read((char*)&size, sizeof(size));
+        buffer.resize(size);
+        m_file.read(&buffer[0], size);
+        if (!m_file) {
+            m_file.clear();
+            return false;
+        }
+
+        size_t pos = sizeof(double);
+        bool key = (type == TIMELINE_KEYFRAME);
+        if (key) {
+            if (!get(buffer, pos, count)) {
+                return false;
+            }
+            pos += count * (sizeof(float) + sizeof(int32_t));
+        }
+        else {
+            for (uint32_t v = 0; v < count; v++) {
+                int32_t delta = 0;
+                if (!getVarint(buffer, pos, delta)) {
+                    return false;
+                }
+            }
+        }
+
+        uint32_t length = 0;
+        if (pos > buffer.size() || !get(buffer, pos, length) || pos + length > buffer.size()) {
+            return false;
+        }
+        state.assign(buffer, pos, length);
+        _callback(i, key, state);
+    }
+    return true;
+}
+
+bool Timeline::play(size_t _first, size_t _last, const Callback& _callback) {
+    if (!m_reading || _first > _last || _last >= m_index.size()) {
+        return false;
+    }
+
+    size_t start = (m_cursor >= 0 && size_t(m_cursor) + 1 == _first)? _first : m_index[_first].keyframe;
+    TimelineFrame frame;
+    for (size_t i = start; i <= _last; i++) {
+        if (!readRecord(i, frame)) {
+            m_cursor = -1;
+            return false;
+        }
+        m_cursor = (long long)i;
+        _callback(i, frame);
+    }
+    return true;
+}
@@ -0,0 +1,132 @@
+//
+//  Timeline.h
+//  Solar
+//
+//  Compact recording of the scene, one frame per update. Every frame is a
+//  flat array of floats plus an opaque state blob. Values are quantized
+//  (each slot with its own step); keyframes store them whole and the
+//  frames in between only store zigzag varint deltas of the quantized
+//  integers, so decoding never drifts. A keyframe is forced every
+//  interval frames and whenever the layout changes.
+//
+//  State blobs are opaque: the caller decides what a keyframe's blob holds
+//  beyond the deltas. Reaching any frame means decoding at most one
+//  interval from its keyframe, and continuing playback one frame at a time
+//  only decodes that frame. readStates() walks the blobs alone, for state
+//  that is only recorded as deltas and has to be indexed on open.
+//
+//  File: "STL1" header, records { uint8 type, uint32 size, payload } and a
+//  seek index at the end. Files without an index (interrupted sessions)
+//  are scanned to rebuild it on open.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct TimelineFrame {
+    double              jd = 0.0;
+    bool                keyframe = false;
+    std::vector<float>  values;
+    std::string         state;
+};
+
+// Packs and unpacks the state blobs, host byte order
+struct TimelineState {
+    std::string data;
+    size_t      pos = 0;
+
+    template<typename T>
+    void put(const T& _value) { data.append((const char*)&_value, sizeof(T)); }
+    void putString(const std::string& _value) { put(uint32_t(_value.size())); data += _value; }
+
+    template<typename T>
+    bool get(T& _value) {
+        if (pos + sizeof(T) > data.size()) {
+            return false;
+        }
+        std::memcpy(&_value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+    bool getString(std::string& _value) {
+        uint32_t length = 0;
+        if (!get(length) || pos + length > data.size()) {
+            return false;
+        }
+        _value.assign(data, pos, length);
+        pos += length;
+        return true;
+    }
+};
+
+class Timeline {
+public:
+    Timeline();
+    virtual ~Timeline();
+
+    // RECORDING
+    bool        create(const std::string& _path, size_t _keyframeInterval = 120);
+    // Quantization step of every value slot. A different layout starts a keyframe
+    void        setLayout(const std::vector<float>& _quanta);
+    // Forces the next record() to be a keyframe
+    void        requestKeyframe() { m_layoutChanged = true; }
+    // Whether a record() of _count values now would be a keyframe (so only that blob has to be built)
+    bool        isKeyframeDue(size_t _count) const { return m_layoutChanged || m_sinceKeyframe >= m_interval || m_current.size() != _count; }
+    void        record(double _jd, const std::vector<float>& _values, const std::string& _snapshot, const std::string& _delta);
+    bool        isRecording() const { return m_writing; }
+
+    // PLAYBACK
+    bool        open(const std::string& _path);
+    bool        isOpen() const { return m_reading; }
+    void        close();
+
+    size_t      size() const { return m_index.size(); }
+    double      getJD(size_t _frame) const { return m_index[_frame].jd; }
+    size_t      getKeyframe(size_t _frame) const { return m_index[_frame].keyframe; }
+    // Last frame at or before _jd (the first one when _jd is earlier)
+    size_t      find(double _jd) const;
+
+    // Brings the decoder to _last, calling _callback for each decoded frame in
+    // order. Decoding continues from the previous call when that ended on
+    // _first - 1, otherwise it restarts at the keyframe covering _first.
+    typedef std::function<void(size_t _frame, const TimelineFrame& _data)> Callback;
+    bool        play(size_t _first, size_t _last, const Callback& _callback);
+
+    // Every frame's state blob in order, skipping the values without decoding them
+    typedef std::function<void(size_t _frame, bool _keyframe, const std::string& _state)> StateCallback;
+    bool        readStates(const StateCallback& _callback);
+
+    // The value encoding, also used to stream the scene (see SceneServer)
+    static int32_t  quantize(float _value, float _quantum);
+    static void     putVarint(std::string& _out, int32_t _value);
+
+protected:
+    struct Entry {
+        double      jd;
+        uint64_t    offset;
+        uint32_t    keyframe;
+    };
+
+    bool        readRecord(size_t _frame, TimelineFrame& _out);
+    bool        scan();
+
+    std::vector<Entry>      m_index;
+    std::vector<float>      m_quanta;
+    std::vector<int32_t>    m_current;      // quantized values of the last frame
+    std::string             m_buffer;
+
+    std::fstream            m_file;
+    std::string             m_path;
+    size_t                  m_interval;
+    size_t                  m_sinceKeyframe;
+    long long               m_cursor;       // last decoded frame, -1 for none
+    bool                    m_layoutChanged;
+    bool                    m_writing;
+    bool                    m_reading;
+};
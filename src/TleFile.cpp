@@ -0,0 +1,100 @@
+//
+//  TleFile.cpp
+//  Solar
+//
+
+#include "TleFile.h"
+
+#include <fstream>
+#include <vector>
+
+namespace {
+
+std::string trimLine(const std::string& _line) {
+    size_t end = _line.find_last_not_of(" \t\r\n");
+    if (end == std::string::npos) {
+        return "";
+    }
+    return _line.substr(0, end + 1);
+}
+
+// Columns 3-7 of line 1: five digits, or Alpha-5 once the catalog passed
+// 99999 (a letter for the ten thousands from A = 10, skipping I and O)
+bool parseNorad(const std::string& _field, unsigned int& _norad) {
+    if (_field.size() != 5) {
+        return false;
+    }
+    unsigned int high = 0;
+    char first = _field[0];
+    if (first >= '0' && first <= '9') {
+        high = first - '0';
+    }
+    else if (first == ' ') {
+        high = 0;
+    }
+    else if (first >= 'A' && first <= 'Z' && first != 'I' && first != 'O') {
+        high = 10 + (first - 'A') - (first > 'I'? 1 : 0) - (first > 'O'? 1 : 0);
+    }
+    else {
+        return false;
+    }
+
+    unsigned int low = 0;
+    for (size_t i = 1; i < 5; i++) {
+        char c = _field[i];
+        if (c == ' ' && low == 0) {
+            continue;
+        }
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        low = low * 10 + (c - '0');
+    }
+    _norad = high * 10000 + low;
+    return true;
+}
+
+}
+
+bool TleFile::load(const std::string& _path, std::map<unsigned int, TleText>& _out) {
+    std::ifstream file(_path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line, name;
+    std::vector<std::string> lines;
+    while (std::getline(file, line)) {
+        line = trimLine(line);
+        if (line.size() > 0) {
+            lines.push_back(line);
+        }
+    }
+
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (i + 1 < lines.size() &&
+            lines[i].size() >= 69 && lines[i][0] == '1' &&
+            lines[i+1].size() >= 69 && lines[i+1][0] == '2') {
+
+            TleText tle;
+            tle.line1 = lines[i];
+            tle.line2 = lines[i+1];
+            unsigned int norad = 0;
+            if (!parseNorad(tle.line1.substr(2, 5), norad)) {
+                // Not a catalog number we can key by, skip the whole entry
+                name = "";
+                i++;
+                continue;
+            }
+            tle.name = (name.size() > 0)? name : "NORAD " + std::to_string(norad);
+
+            _out[norad] = tle;
+            name = "";
+            i++;
+        }
+        else {
+            name = trimLine(lines[i].substr(0, 24));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+//
+//  TleFile.h
+//  Solar
+//
+//  Plain TLE text files, without openFrameworks, shared by the catalog
+//  watcher and the command line exporter.
+//
+
+#pragma once
+
+#include <map>
+#include <string>
+
+struct TleText {
+    std::string name;
+    std::string line1;
+    std::string line2;
+};
+
+class TleFile {
+public:
+    // Accepts both the 3-line (name + elements) and the bare 2-line format.
+    // Entries are keyed by NORAD id (Alpha-5 ids decoded, unreadable ones
+    // skipped), later files override earlier ones
+    static bool load(const std::string& _path, std::map<unsigned int, TleText>& _out);
+};
@@ -1,8 +1,50 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "AccuracyHarness.h"
 
 //========================================================================
-int main( ){
+// solar --harness [samples] [threads]
+// Checks every fast path against its reference without opening a window
+int harness(int argc, char* argv[]) {
+    AccuracyHarness harness;
+    if (argc > 2) {
+        harness.setSamples(ofToInt(argv[2]));
+    }
+    if (argc > 3) {
+        harness.setThreads(ofToInt(argv[3]));
+    }
+
+    ofxCatalog catalog;
+    catalog.setup(TLE_FOLDER);
+    catalog.stop();
+
+    std::vector<Satellite> satellites;
+    std::shared_ptr<const CatalogSnapshot> snapshot = catalog.get();
+    for (size_t i = 0; i < snapshot->entries.size(); i++) {
+        satellites.push_back(*snapshot->entries[i].satellite);
+    }
+    harness.setSatellites(satellites);
+
+    return harness.run(std::cout)? 0 : 1;
+}
+
+//========================================================================
+// solar --benchmark [frames] [objects] [out.json]
+// Frame time percentiles over a synthetic catalog, as JSON (stdout by default).
+// Headless on CI under Mesa's software rasterizer:
+//   xvfb-run -a -s "-screen 0 1280x720x24" env LIBGL_ALWAYS_SOFTWARE=1 ./Solar --benchmark 600 20000
+int main(int argc, char* argv[]){
+    if (argc > 1 && std::string(argv[1]) == "--harness") {
+        return harness(argc, argv);
+    }
+    bool benchmark = (argc > 1 && std::string(argv[1]) == "--benchmark");
+    int frames = (argc > 2)? ofToInt(argv[2]) : 600;
+    int objects = (argc > 3)? ofToInt(argv[3]) : 20000;
+    if (benchmark && (frames <= 0 || objects <= 0)) {
+        std::cerr << "usage: " << argv[0] << " --benchmark [frames] [objects] [out.json], counts above 0" << std::endl;
+        return 1;
+    }
+
 #ifdef TARGET_OPENGLES
     ofGLESWindowSettings settings;
     settings.setGLESVersion(2);
@@ -10,7 +52,15 @@ int main( ){
     ofGLWindowSettings settings;
     settings.setGLVersion(3, 2);  // Programmable pipeline
 #endif
+    if (benchmark) {
+        // Same size on every machine, so runs compare
+        settings.setSize(1280, 720);
+    }
     ofCreateWindow(settings);
-    ofRunApp(new ofApp());
-}
 
+    ofApp* app = new ofApp();
+    if (benchmark) {
+        app->setBenchmark(frames, objects, (argc > 4)? argv[4] : "");
+    }
+    ofRunApp(app);
+}
@@ -2,7 +2,6 @@
 
 #include "GeoLoc/src/GeoLoc.h"
 #include "Astro/src/CoordOps.h"
-#include "Astro/src/models/TLE.h"
 
 #include "TimeOps.h"
 
@@ -21,6 +20,16 @@ glm::vec3 toOf(const Vector &_ve) {
     return glm::vec3(_ve.x, _ve.y, _ve.z);
 }
 
+// Earth fixed km of a place on the WGS84 ellipsoid (degrees)
+glm::dvec3 toTerrestrial(double _lng, double _lat) {
+    const double a = 6378.137;
+    const double e2 = 0.0066943799901413165;
+    double lng = glm::radians(_lng);
+    double lat = glm::radians(_lat);
+    double n = a / std::sqrt(1.0 - e2 * std::sin(lat) * std::sin(lat));
+    return glm::dvec3(n * std::cos(lat) * std::cos(lng), n * std::cos(lat) * std::sin(lng), n * (1.0 - e2) * std::sin(lat));
+}
+
 void drawString(const std::string &str, int x , int y) {
     ofSetColor(255);
     ofSetDrawBitmapMode(OF_BITMAPMODE_SIMPLE);
@@ -84,10 +93,9 @@ void ofApp::setup(){
     
     // Earth
     earthSize = 1.7;
-    earthScaleFactor = ((earthSize * CoordOps::AU_TO_KM)/CoordOps::EARTH_EQUATORIAL_RADIUS_KM);
     
     // Sun
-    sun = Body(SUN);
+    sun = ofxBody(SUN);
     
     // Moon
     moonScaleDistance = .5;
@@ -109,8 +117,14 @@ void ofApp::setup(){
     billboard.addVertex(ofPoint(1.,-1));
     billboard.addTexCoord(ofVec2f(1.,1.));
     billboard.addColor(ofFloatColor(1.));
+    moonPhases.setup(billboard);
     luna = Luna();
     
+    // Eclipses are searched on demand, around the current date
+    eclipseSearch.setObserver(lng, lat);
+    eclipsesStart = eclipsesEnd = 0.0;
+    eclipsesPendingStart = eclipsesPendingEnd = 0.0;
+    
     // Planets
     BodyId planets_names[] = { MERCURY, VENUS, EARTH, MARS, JUPITER, SATURN, URANUS, NEPTUNE, PLUTO, LUNA };
     for (int i = 0; i < 9; i++) {
@@ -128,42 +142,51 @@ void ofApp::setup(){
     planetsSizes[9] = 0.27;
     
 #ifdef SATELLITES
-    // Satellites
-    TLE sats[] = {
-        // TLE("HOBBLE",
-        //     "1 20580U 90037B   18154.57093887 +.00000421 +00000-0 +14812-4 0  9997",
-        //     "2 20580 028.4684 205.1197 0002723 359.7851 153.4291 15.09046689343324"),
-        // TLE("TERRA",
-        //     "1 25994U 99068A   18154.24441102 -.00000021  00000-0  53030-5 0  9998",
-        //     "2 25994  98.2062 229.3170 0001386  97.9233 262.2105 14.57104269981794"),
-        TLE("GOES 16",
-            "1 41866U 16071A   19104.54479091 -.00000266  00000-0  00000+0 0  9998",
-            "2 41866   0.0087 280.8905 0000718 128.8794 273.5684  1.00270903  8824"),
-        TLE("GOES 17",
-            "1 43226U 18022A   19104.67599373  .00000079  00000-0  00000+0 0  9999",
-            "2 43226   0.0301  70.6991 0003032 319.6430 278.3589  1.00271421  4159"),
-//        TLE("SUOMI",
-//            "1 37849U 11061A   18154.59022466  .00000019  00000-0  29961-4 0  9994",
-//            "2 37849  98.7369  93.2509 0000790 115.8241 296.7478 14.19549859341951"),
-        // TLE("NOAA 19",
-        //     "1 33591U 09005A   18154.53769778  .00000063  00000-0  59621-4 0  9992",
-        //     "2 33591  99.1410 132.2940 0014182   9.6985 350.4457 14.12282740480248"),
-        // TLE("NOAA 20",
-        //     "1 43013U 17073A   18154.54421336  .00000003  00000-0  22344-4 0  9998",
-        //     "2 43013  98.7249  93.0462 0000870  77.9803 282.1471 14.19559862 27975"),
-        TLE("ISS",
-            "1 25544U 98067A   19105.09442045  .00003338  00000-0  60866-4 0  9991",
-            "2 25544  51.6448 314.8442 0001619 173.1309 328.9628 15.52550092165450")
-    };
-    
-    int N = sizeof(sats)/sizeof(sats[0]);
-    for (int i = 0; i < N; i++) {
-        satellites.push_back(ofxSatellite(sats[i]));
+    // Satellites (TLE files in data/tle are reloaded as they change)
+    if (benchmark.isRunning()) {
+        // A production sized catalog instead of the few real TLEs
+        ofDirectory::createDirectory(BENCHMARK_FOLDER, true, true);
+        if (!Benchmark::writeCatalog(ofToDataPath(BENCHMARK_FOLDER "/synthetic.tle", true), benchmarkObjects, BENCHMARK_START_JD, BENCHMARK_SEED)) {
+            // Timing an empty catalog would look like a great run
+            ofLogError("Benchmark") << "Can not write the synthetic catalog to " << ofToDataPath(BENCHMARK_FOLDER, true);
+            benchmark.setup(0, 0);
+            ofExit(1);
+        }
+        catalog.setup(BENCHMARK_FOLDER);
+    }
+    else {
+        catalog.setup(TLE_FOLDER);
     }
     satellitesSize = 0.02941176471;
+    satellitesMisses = 0.0;
+    groundTracksObjects = 0;
+
+    // One color per combination of illumination flags, so drawing does not branch
+    for (int i = 0; i < ILLUMINATION_STATES; i++) {
+        satellitesPalette[i] = ofFloatColor(.4);
+        if (i & ILLUMINATION_LIT) {
+            satellitesPalette[i] = (i & ILLUMINATION_PENUMBRA)? palette[2] : ofFloatColor(1.);
+        }
+        if (i & ILLUMINATION_VISIBLE) {
+            satellitesPalette[i] = palette[4];
+        }
+    }
 #endif
+
+    // Float display kernels have to stay within their error budget, the
+    // ones that don't are replaced by their double twins
+    std::string report;
+    if (KernelOps::check(report, &precision)) {
+        ofLogNotice("KernelOps") << report;
+    }
+    else {
+        ofLogError("KernelOps") << report << " back to double";
+    }
     
-    ofLoadImage(earth_texture, "diffuse.png");
+    // Tiled imagery streams in when there is a pyramid, the small texture otherwise
+    if (!ofFile(ofToDataPath(EARTH_TILES)).exists() || !earth_tiles.setup(ofToDataPath(EARTH_TILES, true))) {
+        ofLoadImage(earth_texture, "diffuse.png");
+    }
     earth_shader.load("shaders/earth");
     
     vector<std::string> direction = { "N", "E", "S", "W" };
@@ -204,6 +227,8 @@ void ofApp::setup(){
     
     bHudLines = false;
     bMoonPhases = false;
+    bEclipses = false;
+    bCoverage = false;
     
     bTopoArrow = false;
     bTopoDisk = false;
@@ -212,10 +237,59 @@ void ofApp::setup(){
     bTopoLables = false;
     
     bDebugFps = false;
+    bDome = false;
+    earth_tiles_picked = false;
+    
+    // Timeline
+    timelineFrame = 0;
+    timelineLines = timelineMoons = 0;
+    timelineShownLines = timelineShownMoons = 0;
+    bReplay = false;
+    
+    // Server (started with 'w')
+    serverLines = serverMoons = 0;
+
+    if (benchmark.isRunning()) {
+        startBenchmark();
+    }
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
+    if (benchmark.isRunning()) {
+        updateBenchmark();
+        benchmark.beginUpdate();
+    }
+
+#ifdef SATELLITES
+    // Exports and the coverage grid run in the background, replaying or not
+    if (coverage_pending.valid() && coverage_pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        std::shared_ptr<CoverageMap> coverage = coverage_pending.get();
+        if (coverage && bCoverage) {
+            uploadCoverage(*coverage);
+        }
+    }
+    if (groundTracksPending.valid() && groundTracksPending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        size_t samples = groundTracksPending.get();
+        ofLogNotice("GroundTrack") << samples << " samples of " << groundTracksObjects << " objects written to " << groundTracksPath;
+    }
+#endif
+
+    if (bReplay) {
+        // Replays only read the timeline, nothing is computed
+        if (time_play && timeline.size() > 0) {
+            if (time_step >= 0. && timelineFrame + 1 < timeline.size()) {
+                seekTimeline(timelineFrame + 1);
+            }
+            else if (time_step < 0. && timelineFrame > 0) {
+                seekTimeline(timelineFrame - 1);
+            }
+        }
+        if (server.isRunning()) {
+            publishScene();
+        }
+        return;
+    }
 
     // TIME CALCULATIONS
     // --------------------------------
@@ -223,7 +297,8 @@ void ofApp::update(){
         time_offset += time_step;
     }
 
-    obs.setJD(TimeOps::now(UTC) + time_offset);
+    obs.setJD((benchmark.isRunning()? BENCHMARK_START_JD : TimeOps::now(UTC)) + time_offset);
+    eop.update(obs.getJD());
     
     TimeOps::toDMY(obs.getJD(), day, month, year);
     date = TimeOps::formatDateTime(obs.getJD(), Y_MON_D);
@@ -234,22 +309,61 @@ void ofApp::update(){
     
     // Update sun position
     sun.compute(obs);
+    sun.cache();
     
-    // Update planets positions
-    for ( unsigned int i = 0; i < planets.size(); i++) {
-        planets[i].compute(obs);
-        planets[i].m_helioC = planets[i].getHelioPosition(AU) * scale;
-    }
+    // Update planets positions, in parallel chunks that only write their own slots
+    planetsHelio.resize(planets.size());
+    planetsScene.resize(planets.size());
+    bool bodiesFloat = precision.useFloat(Subsystem::BODY_POSITIONS);
+    scheduler.parallelFor(0, planets.size(), UPDATE_BODIES_GRAIN, [&](size_t _begin, size_t _end) {
+        Observer local = obs;
+        for (size_t i = _begin; i < _end; i++) {
+            planets[i].compute(local);
+            planets[i].cache();
+            planetsHelio[i] = planets[i].getHelioPosition<Unit::AU>();
+        }
+        if (bodiesFloat) {
+            KernelOps::bodiesToScene<float>(planetsHelio.data() + _begin, _end - _begin, scale, planetsScene.data() + _begin);
+        }
+        else {
+            KernelOps::bodiesToScene<double>(planetsHelio.data() + _begin, _end - _begin, scale, planetsScene.data() + _begin);
+        }
+        for (size_t i = _begin; i < _end; i++) {
+            planets[i].m_helioC = planetsScene[i];
+        }
+    });
     
     // Update moon position (the distance from the earth is not in scale)
     moon.compute(obs);
-    moon.m_helioC = ( moon.getGeoPosition(AU) * (earthScaleFactor * moonScaleDistance) ) + (planets[2].getHelioPosition(AU) * scale);
+    moon.cache();
+    moon.m_helioC = moon.getGeoPosition<Unit::EARTH_RADII>().toGlm(earthSize * moonScaleDistance) + planets[2].m_helioC;
 
 #ifdef SATELLITES
-    for ( unsigned int i = 0; i < satellites.size(); i++) {
-        satellites[i].compute(obs);
-        satellites[i].m_geoC = satellites[i].getGeoPosition(AU) * earthScaleFactor;
-        satellites[i].m_helioC = satellites[i].m_geoC + planets[2].getHelioPosition(AU) * scale;
+    // Pick up a reloaded catalog, unchanged objects keep their trails
+    std::shared_ptr<const CatalogSnapshot> snapshot = catalog.get();
+    if (snapshot != catalogSnapshot) {
+        ofxCatalog::merge(catalogSnapshot.get(), *snapshot, satellites);
+        catalogSnapshot = snapshot;
+        satelliteCache.setup(satellites);
+
+        // What a deployment of this size costs per object
+        size_t total = std::max<size_t>(1, satellites.size());
+        satellitesHot.resize(satellites.size(), precision.useFloat(Subsystem::SATELLITE_POSITIONS));
+        ofLogNotice("CatalogStore") << satellites.size() << " objects: "
+                                    << satellitesHot.bytes() / total << " hot bytes, "
+                                    << snapshot->metadata.bytes() / total << " cold bytes, "
+                                    << sizeof(ofxSatellite) << " bytes of propagator (plus its heap) each";
+    }
+
+    // SGP4 runs only at sparse knots, positions in between are interpolated
+    satelliteCache.setTimeStep(time_play? time_step : 0.0);
+    bool satellitesFloat = precision.useFloat(Subsystem::SATELLITE_POSITIONS);
+    satellitesHot.resize(satellites.size(), satellitesFloat);
+    if (satellitesFloat) {
+        updateSatellites(satellitesHot.eciF);
+    }
+    else {
+        updateSatellites(satellitesHot.eciD);
     }
 #endif
     
@@ -257,7 +371,7 @@ void ofApp::update(){
     // --------------------------------
     
     // Calculate Equinox vector
-    v_equi = glm::normalize(toOf( CoordOps::toEquatorial(obs, Ecliptic(0.0, 0.0 , 1, RADS, AU)).getVector() ));
+    v_equi = glm::vec3(eop.getEquinox());
     
     // Equatorial North, Vernal Equinox and Summer Solstice
 
@@ -273,10 +387,35 @@ void ofApp::update(){
         int moon_curPhase = moon_phase * 8;
         if (moon_curPhase != moon_prevPhase) {
             moons.push_back(ofxMoon(glm::normalize(planets[2].m_helioC) * 110., moon_phase));
+            moonPhases.add(moons.back());
             moon_prevPhase = moon_curPhase;
         }
     }
     
+    if (bEclipses) {
+        // Swap in the last search once it is done
+        if (eclipsesPending.valid() && eclipsesPending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            eclipses = eclipsesPending.get();
+            eclipsesStart = eclipsesPendingStart;
+            eclipsesEnd = eclipsesPendingEnd;
+            ofLogNotice("EclipseSearch") << eclipses.size() << " eclipses until " << ofToString(eclipsesEnd, 1);
+        }
+
+        // Eclipses for the next 20 years, searched again in the background once
+        // time leaves them. One search at a time, so scrubbing doesn't queue them up
+        double jd = obs.getJD();
+        if (!eclipsesPending.valid() && (jd < eclipsesStart || jd > eclipsesEnd - 365.25)) {
+            eclipsesPendingStart = jd - 365.25;
+            eclipsesPendingEnd = jd + 20. * 365.25;
+            EclipseSearch search = eclipseSearch;
+            double start = eclipsesPendingStart;
+            double end = eclipsesPendingEnd;
+            eclipsesPending = std::async(std::launch::async, [search, start, end]() mutable {
+                return search.search(start, end);
+            });
+        }
+    }
+    
     if (bHudLines) {
         // Equinoxes & Solstices
         if (abs(toEarth.dot(v_equi)) > .9999995 && !bWriten) {
@@ -308,12 +447,13 @@ void ofApp::update(){
         // Year's cycles, Months & Days
         if (oneYearIn == "" ) {
             oneYearIn = ofToString(year+1) + "/" + ofToString(month,2,'0') + "/" + ofToString(int(day),2,'0');
-            cout << "One year in day " << oneYearIn << endl;
+            ofLogNotice("ofApp") << "One year in day " << oneYearIn;
         }
         else if (oneYearIn == date) {
             oneYearIn = "";
             if (bMoonPhases) {
                 moons.clear();
+                moonPhases.clear();
             }
             lines.clear();
         }
@@ -347,19 +487,168 @@ void ofApp::update(){
         prevMonth = month;
         prevDay = day;
     }
+    
+    if (timeline.isRecording()) {
+        recordTimeline();
+    }
+    
+    if (server.isRunning()) {
+        publishScene();
+    }
+
+    if (benchmark.isRunning()) {
+        benchmark.endUpdate();
+    }
+}
+
+//--------------------------------------------------------------
+template<typename T>
+void ofApp::updateSatellites(HotArray< EquatorialVector<Unit::KM, T> >& _eci) {
+    size_t total = satellites.size();
+
+    // Sun and observer in the same frame as the satellites (true equator of date, km)
+    IlluminationQuery light;
+    light.sun = eop.toEquatorial(sun.getGeoPosition<Unit::KM>().toDvec3());
+    light.observer = glm::transpose(eop.getEquatorialToTerrestrial()) * toTerrestrial(lng, lat);
+    light.observerDark = sun.m_altitude < glm::radians(SATELLITES_DARK_SKY);
+    light.stdMagnitude = SATELLITES_STD_MAGNITUDE;
+    light.limit = SATELLITES_MAGNITUDE_LIMIT;
+
+    // Each chunk interpolates (or propagates), places and lights its own satellites
+    double jd = obs.getJD();
+    glm::dmat3 equatorialToEcliptic = glm::transpose(eop.getEclipticToEquatorial());
+    glm::vec3 earth = planets[2].m_helioC;
+    satellitesHot.misses = 0;
+    scheduler.parallelFor(0, total, UPDATE_SATELLITES_GRAIN, [&](size_t _begin, size_t _end) {
+        uint64_t misses = CacheMisses::read();
+        satelliteCache.getPositions(jd, _eci, _begin, _end);
+        KernelOps::satellitesToScene<T>(_eci.data() + _begin, _end - _begin,
+                                        equatorialToEcliptic, earthSize, earth,
+                                        satellitesHot.equat.data() + _begin, satellitesHot.geo.data() + _begin, satellitesHot.helio.data() + _begin);
+        KernelOps::illumination<T>(_eci.data() + _begin, _end - _begin, light,
+                                   satellitesHot.light.data() + _begin, satellitesHot.magnitude.data() + _begin);
+
+        for (size_t i = _begin; i < _end; i++) {
+            ofxSatellite::getBounds(satellitesHot.helio[i], satellitesHot.geo[i], satellitesHot.bound[i], satellitesHot.boundRadius[i]);
+        }
+        satellitesHot.misses += CacheMisses::read() - misses;
+    });
+    satellitesMisses = double(satellitesHot.misses.load()) / double(std::max<size_t>(1, total));
 }
 
 //--------------------------------------------------------------
 void ofApp::draw(){
+    if (benchmark.isRunning()) {
+        benchmark.beginDraw();
+        benchmarkRenderer->reset();
+    }
+
     ofEnableDepthTest();
     ofEnableAlphaBlending();
+    earth_tiles_picked = false;
 
     // Set Scene
-    cam.begin();
+    if (bDome) {
+        // Far enough for Pluto at any scale
+        multiView.setClip(MULTIVIEW_NEAR, scale * DOME_FAR_AU);
+
+        // Every face of the cube from one submission (or one pass per face without multiview)
+        for (size_t pass = 0; pass < multiView.getPasses(); pass++) {
+            multiView.begin(cam, pass);
+            drawScene();
+            multiView.end();
+        }
+        // Then the labels the single submission held back, face by face
+        for (size_t view = 0; view < multiView.getOverlayPasses(); view++) {
+            multiView.beginOverlay(view);
+            drawLabels();
+            multiView.endOverlay();
+        }
+        sceneLabels.clear();
+        ofDisableDepthTest();
+        float size = std::min(ofGetWidth(), ofGetHeight());
+        multiView.drawDomeMaster((ofGetWidth() - size) * .5, (ofGetHeight() - size) * .5, size);
+    }
+    else {
+        cam.begin();
+        drawScene();
+        cam.end();
+    }
+    ofDisableDepthTest();
+    ofDisableAlphaBlending();
+
+    // Draw Date
+    drawString(date + " " + time, ofGetWidth()*.5, ofGetHeight()-30);
+    drawString("lng: " + ofToString(lng,2,'0') + "  lat: " + ofToString(lat,2,'0'), ofGetWidth()*.5, ofGetHeight()-10);
+    
+    if (timeline.isRecording()) {
+        drawString("REC " + ofToString(timeline.size()), ofGetWidth()*.5, ofGetHeight()-50);
+    }
+    else if (bReplay) {
+        drawString("REPLAY " + ofToString(timelineFrame + 1) + "/" + ofToString(timeline.size()), ofGetWidth()*.5, ofGetHeight()-50);
+    }
+    
+    if (bEclipses) {
+        // Next solar and lunar eclipse
+        int y = 20;
+        for (int kind = 0; kind < 2; kind++) {
+            for (unsigned int i = 0; i < eclipses.size(); i++) {
+                const Eclipse& e = eclipses[i];
+                if (int(e.kind) != kind || e.greatest < obs.getJD()) {
+                    continue;
+                }
+                std::string text = e.getTypeName() + (e.kind == EclipseKind::SOLAR? " solar " : " lunar ");
+                text += TimeOps::formatDateTime(e.greatest, Y_MON_D) + " " + TimeOps::formatTime(e.greatest, true);
+                text += " mag " + ofToString(e.magnitude, 3);
+                if (e.kind == EclipseKind::SOLAR) {
+                    text += e.local.visible()? " (here " + ofToString(e.local.magnitude, 3) + ")" : " (not visible here)";
+                }
+                drawString(text, ofGetWidth()*.5, y);
+                y += 20;
+                break;
+            }
+        }
+    }
+    
+    if (bDebugFps) {
+        ofDrawBitmapString(ofToString(ofGetFrameRate()), 5, 15);
+#ifdef SATELLITES
+        satellitesNakedEye.resize(satellitesHot.light.size());
+        size_t nakedEye = KernelOps::select(satellitesHot.light.data(), satellitesHot.light.size(), ILLUMINATION_VISIBLE, satellitesNakedEye.data());
+        ofDrawBitmapString(ofToString(nakedEye) + " satellites to the naked eye", 5, 30);
+        if (CacheMisses::available()) {
+            ofDrawBitmapString(ofToString(satellitesMisses, 2) + " cache misses per satellite", 5, 45);
+        }
+#endif
+    }
+
+    if (benchmark.isRunning()) {
+        // What the GPU (llvmpipe on CI) does is part of the frame
+        glFinish();
+        benchmark.endDraw(benchmarkRenderer->getDrawCalls(), benchmarkRenderer->getVertices());
+        if (benchmark.isDone()) {
+            finishBenchmark();
+        }
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::drawScene(){
     ofPushMatrix();
     
     ofTranslate(-planets[2].m_helioC);
     
+    // Cull in the same frame the bodies are drawn in (centered on the Earth).
+    // The dome sees all around, only what is too small is left out
+    ofRectangle viewport = ofGetCurrentViewport();
+    glm::mat4 toEarthFrame = glm::translate(glm::mat4(1.0), -planets[2].m_helioC);
+    if (bDome) {
+        culler.setAll();
+    }
+    else {
+        culler.setView(cam.getModelViewProjectionMatrix(viewport) * toEarthFrame, cam.getProjectionMatrix(viewport), viewport.height);
+    }
+    
     // ECLIPTIC HELIOCENTRIC COORD SYSTEM
     // --------------------------------------- begin Heliocentric Ecliptic
 
@@ -373,29 +662,62 @@ void ofApp::draw(){
             planets[i].drawTrail(ofFloatColor(.5));
         }
         
-        if (planets[i].getId() != EARTH) {
-            planets[i].draw(ofFloatColor(.9), planetsSizes[i] * earthSize);
-            if (bHelioCoords) {
-                ofSetColor(120, 100);
-                ofDrawLine(ofPoint(0.), planets[i].m_helioC);
+        float size = planetsSizes[i] * earthSize;
+        if (planets[i].getId() != EARTH && culler.isVisible(planets[i].m_helioC, size)) {
+            planets[i].draw(ofFloatColor(.9), size, false);
+            if (culler.isVisible(planets[i].m_helioC, size, 2.)) {
+                ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
+                drawLabel(planets[i].getName(), planets[i].getLabelPosition(size));
             }
         }
+        // From the Sun, on screen even when the planet is not
+        if (bHelioCoords && planets[i].getId() != EARTH) {
+            ofSetColor(120, 100);
+            ofDrawLine(ofPoint(0.), planets[i].m_helioC);
+        }
     }
     
 #ifdef SATELLITES
     //  SATELLITES
     //  ---------------------------------------
-    for (unsigned int i = 0; i < satellites.size(); i++) {
-        if (bBodiesTrail) {
-            satellites[i].drawHeliocentricTrail(palette[4]);
+    if (bBodiesTrail) {
+        // Trails grow as they are drawn, so they are not culled
+        for (unsigned int i = 0; i < satellites.size(); i++) {
+            satellites[i].drawHeliocentricTrail(palette[4], satellitesHot.helio[i]);
         }
-        
-        if (bHelioCoords) {
-            ofSetColor(120, 100);
-            ofDrawLine(ofPoint(0.), satellites[i].m_helioC);
+    }
+    
+    if (bHelioCoords) {
+        ofSetColor(120, 100);
+        drawSatelliteLines(satellitesHot.helio);
+    }
+    
+    // Only satellites with their marker, tether or label on screen and a
+    // marker bigger than a fraction of a pixel, labels from a few pixels
+    CullQuery query;
+    query.centers = satellitesHot.helio.data();
+    query.total = std::min(satellitesHot.helio.size(), satellites.size());
+    query.radius = satellitesSize * earthSize * 0.866;
+    query.minPixels = 0.25;
+    query.labelPixels = 1.5;
+    query.boundCenters = satellitesHot.bound.data();
+    query.boundRadii = satellitesHot.boundRadius.data();
+    query.boundPadding = satellitesSize * earthSize * 1.75;
+    culler.cull(query, scheduler, satellitesVisible, &satellitesLabeled);
+    
+    for (unsigned int v = 0, l = 0; v < satellitesVisible.size(); v++) {
+        unsigned int i = satellitesVisible[v];
+        bool label = (l < satellitesLabeled.size() && satellitesLabeled[l] == i);
+        if (label) {
+            l++;
         }
         
-        satellites[i].draw(ofFloatColor(1.), satellitesSize * earthSize);
+        satellites[i].draw(satellitesHot.helio[i], satellitesHot.geo[i], satellitesPalette[satellitesHot.light[i]], satellitesSize * earthSize, false);
+        if (label) {
+            ofSetColor(250);
+            ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
+            drawLabel(satellites[i].getName(), ofxSatellite::getLabelPosition(satellitesHot.helio[i], satellitesHot.geo[i], satellitesSize * earthSize));
+        }
     }
 #endif
 
@@ -410,15 +732,13 @@ void ofApp::draw(){
         ofSetColor(100,100);
         for ( int i = 0; i < planets.size(); i++) {
             if (planets[i].getId() != EARTH ) {
-                ofPoint toPlanet = toOf(planets[i].getEclipticGeocentric().getVector(AU)) * scale;
+                ofPoint toPlanet = planets[i].m_geoC * float(scale);
                 ofDrawLine(ofPoint(0.), toPlanet);
             }
         }
         
 #ifdef SATELLITES
-        for (unsigned int i = 0; i < satellites.size(); i++) {
-            ofDrawLine(ofPoint(0.), satellites[i].m_geoC);
-        }
+        drawSatelliteLines(satellitesHot.geo);
 #endif
     }
 
@@ -426,7 +746,7 @@ void ofApp::draw(){
     
     // EQUATORIAL COORD SYSTEM
     // --------------------------------------- begin Equatorial
-    ofRotateXRad(-obs.getObliquity());
+    ofRotateXRad(-eop.getObliquity());
     
     if (bEquatDir) {
         // Poles, Equinoxes and Solsices
@@ -443,8 +763,8 @@ void ofApp::draw(){
         
         ofSetColor(255);
         ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
-        ofDrawBitmapString("N", n_pole * big);
-        ofDrawBitmapString("S", -n_pole * big);
+        drawLabel("N", n_pole * big);
+        drawLabel("S", -n_pole * big);
     }
     
     if (bEquatCoords) {
@@ -452,15 +772,13 @@ void ofApp::draw(){
         ofSetColor(palette[1]);
         for ( int i = 0; i < planets.size(); i++) {
             if (planets[i].getId() != EARTH ) {
-                glm::vec3 toPlanet = toOf(planets[i].getEquatorialVector(AU)) * scale;
+                glm::vec3 toPlanet = glm::vec3(eop.toEquatorial(glm::dvec3(planets[i].m_geoC)) * scale);
                 ofDrawLine(glm::vec3(0.), toPlanet);
             }
         }
         
 #ifdef SATELLITES
-        for (unsigned int i = 0; i < satellites.size(); i++) {
-            ofDrawLine(ofPoint(0.), toOf(satellites[i].getECI().getPosition(AU) * earthScaleFactor ));
-        }
+        drawSatelliteLines(satellitesHot.equat);
 #endif
     }
 
@@ -481,15 +799,46 @@ void ofApp::draw(){
     ofPushMatrix();
     // -------------------------------------- begin Hour Angle (Topo)
     // Rotate earth
-    ofRotateYRad( TimeOps::toGreenwichSiderealTime(obs.getJD()) );
+    ofRotateYRad( eop.getGMST() );
     
     // Earth
     ofFill();
     ofSetColor(255);
-    earth_shader.begin();
-    earth_shader.setUniformTexture("u_diffuse", earth_texture, 0);
-    ofDrawSphere(earthSize);
-    earth_shader.end();
+    if (earth_tiles.isLoaded()) {
+        ofPushMatrix();
+        ofScale(earthSize);
+        // The dome asks for what all its faces see, once for every pass
+        if (!bDome) {
+            earth_tiles.update(ofGetCurrentMatrix(OF_MATRIX_MODELVIEW), ofGetCurrentMatrix(OF_MATRIX_PROJECTION), viewport);
+        }
+        else if (!earth_tiles_picked) {
+            earth_tiles.update(ofGetCurrentMatrix(OF_MATRIX_MODELVIEW), multiView.getViewProjections(), viewport);
+        }
+        earth_tiles_picked = true;
+    }
+    ofShader& earth = sceneShader(earth_shader, earth_multiview);
+    if (earth_tiles.isLoaded()) {
+        earth_tiles.bind(earth, 2);
+    }
+    else {
+        earth.setUniformTexture("u_diffuse", earth_texture, 0);
+        earth.setUniform2f("u_virtualSize", 0.0, 0.0);
+    }
+    if (bCoverage && coverage_texture.isAllocated()) {
+        earth.setUniformTexture("u_coverage", coverage_texture, 1);
+        earth.setUniform1f("u_coverageMax", coverage_max);
+    }
+    else {
+        earth.setUniform1f("u_coverageMax", 0.0);
+    }
+    if (earth_tiles.isLoaded()) {
+        earth_tiles.drawSphere();
+        ofPopMatrix();
+    }
+    else {
+        ofDrawSphere(earthSize);
+    }
+    endSceneShader(earth);
 
     if (bTopoArrow) {
         // Location arrow
@@ -526,34 +875,34 @@ void ofApp::draw(){
     
     if (bHorizCoords) {
         
-        if (sun.getHorizontal().getAltitud(RADS) > 0) {
+        if (sun.m_altitude > 0) {
             ofSetColor(palette[3], 250);
-            ofPoint toSun = toOf(sun.getHorizontalVector(AU) ) * scale;
+            ofPoint toSun = sun.m_horC * float(scale);
             ofDrawLine(ofPoint(0.), toSun);
             
             if (bTopoLables) {
-                ofDrawBitmapString(sun.getName(), toSun);
+                drawLabel(sun.getName(), toSun);
             }
         }
         
-        if (moon.getHorizontal().getAltitud(RADS) > 0) {
+        if (moon.m_altitude > 0) {
             ofSetColor(palette[3], 250);
-            ofPoint toMoon = toOf(moon.getHorizontalVector(AU)) * 20 * scale;
+            ofPoint toMoon = moon.m_horC * float(20 * scale);
             ofDrawLine(ofPoint(0.), toMoon);
             if (bTopoLables) {
-                ofDrawBitmapString(moon.getName(), toMoon);
+                drawLabel(moon.getName(), toMoon);
             }
         }
 
         ofSetColor(palette[3], 100);
         for ( int i = 0; i < planets.size(); i++) {
             if (planets[i].getId() != EARTH &&
-                planets[i].getHorizontal().getAltitud(RADS) > 0) {
-                ofPoint toPlanet = toOf(planets[i].getHorizontalVector(AU)) * scale;
+                planets[i].m_altitude > 0) {
+                ofPoint toPlanet = planets[i].m_horC * float(scale);
                 ofDrawLine(ofPoint(0.), toPlanet);
                 
                 if (bTopoLables) {
-                    ofDrawBitmapString(planets[i].getName(), toPlanet);
+                    drawLabel(planets[i].getName(), toPlanet);
                 }
             }
         }
@@ -568,7 +917,7 @@ void ofApp::draw(){
             if (bTopoHudLables && topoLines[i].text != "") {
                 ofSetColor(palette[4]);
                 ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
-                ofDrawBitmapString (topoLines[i].text, toOf(topoLines[i].T.getVector()));
+                drawLabel(topoLines[i].text, toOf(topoLines[i].T.getVector()));
             }
             
             ofDrawLine(a, b);
@@ -603,15 +952,16 @@ void ofApp::draw(){
     if (bBodiesTrail) {
         moon.drawTrail(ofFloatColor(.4));
     }
-    moon.draw(ofFloatColor(0.6), moonSize);
+    if (culler.isVisible(moon.m_helioC, moonSize)) {
+        moon.draw(ofFloatColor(0.6), moonSize);
+    }
 
     if (bMoonPhases) {
         // Moon Phases
-        moon_shader.begin();
-        for ( int i = 0; i < moons.size(); i++ ) {
-            moons[i].draw(billboard, moon_shader, 2.);
-        }
-        moon_shader.end();
+        ofSetColor(255);
+        ofShader& phases = sceneShader(moon_shader, moon_multiview);
+        moonPhases.draw(phases, 2.);
+        endSceneShader(phases);
     }
 
     // Draw Hud elements
@@ -622,31 +972,696 @@ void ofApp::draw(){
             
             if (lines[i].text != "") {
                 ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
-                ofDrawBitmapString (lines[i].text, lines[i].T);
+                drawLabel(lines[i].text, lines[i].T);
             }
         }
     }
 
     // --------------------------------------- end Heliocentric Ecliptic
     ofPopMatrix();
+}
 
-    cam.end();
-    ofDisableDepthTest();
-    ofDisableAlphaBlending();
+//--------------------------------------------------------------
+ofShader& ofApp::sceneShader(ofShader& _shader, ofShader& _multiview) {
+    // While the dome renders every face at once, shaders need their multiview twin
+    if (bDome && multiView.isMultiview()) {
+        _multiview.begin();
+        multiView.setUniforms(_multiview);
+        return _multiview;
+    }
+    _shader.begin();
+    return _shader;
+}
 
-    // Draw Date
-    drawString(date + " " + time, ofGetWidth()*.5, ofGetHeight()-30);
-    drawString("lng: " + ofToString(lng,2,'0') + "  lat: " + ofToString(lat,2,'0'), ofGetWidth()*.5, ofGetHeight()-10);
-    
-    if (bDebugFps) {
-        ofDrawBitmapString(ofToString(ofGetFrameRate()), 5, 15);
+void ofApp::endSceneShader(ofShader& _shader) {
+    _shader.end();
+    if (bDome) {
+        multiView.resume();
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::drawLabel(const std::string& _text, const glm::vec3& _position) {
+    // Billboard text projects itself, which a single submission for every
+    // face can not do: keep it in view space for the overlay passes
+    if (bDome && multiView.isMultiview()) {
+        SceneLabel label;
+        label.text = _text;
+        label.position = glm::vec3(ofGetCurrentMatrix(OF_MATRIX_MODELVIEW) * glm::vec4(_position, 1.0));
+        label.color = ofGetStyle().color;
+        sceneLabels.push_back(label);
+        return;
+    }
+    ofDrawBitmapString(_text, _position);
+}
+
+void ofApp::drawLabels() {
+    ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
+    for (size_t i = 0; i < sceneLabels.size(); i++) {
+        ofSetColor(sceneLabels[i].color);
+        ofDrawBitmapString(sceneLabels[i].text, sceneLabels[i].position);
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::exportGroundTracks(std::shared_ptr<GroundTrackWriter> _writer, const std::string& _file) {
+#ifdef SATELLITES
+    if (!catalogSnapshot) {
+        return;
+    }
+    if (groundTracksPending.valid()) {
+        ofLogWarning("GroundTrack") << "Still writing " << groundTracksPath;
+        return;
+    }
+
+    // Next 24 hours of every catalog object, one sample per minute
+    std::shared_ptr<GroundTrack> tracks = std::make_shared<GroundTrack>();
+    for (unsigned int i = 0; i < catalogSnapshot->entries.size(); i++) {
+        tracks->add(catalogSnapshot->entries[i].norad, *catalogSnapshot->entries[i].satellite);
+    }
+    tracks->setWindow(obs.getJD(), obs.getJD() + 1.0, 1.0 / 1440.0);
+    tracks->setMinElevation(10.0);
+
+    std::string path = ofToDataPath(_file, true);
+    if (!_writer->open(path)) {
+        ofLogError("GroundTrack") << "Can't write " << path;
+        return;
+    }
+
+    // Written in the background, update() reports when it is done
+    groundTracksPath = path;
+    groundTracksObjects = tracks->size();
+    TaskScheduler* pool = &scheduler;
+    groundTracksPending = std::async(std::launch::async, [tracks, _writer, pool]() {
+        size_t samples = tracks->run(*_writer, *pool);
+        _writer->close();
+        return samples;
+    });
+#endif
+}
+
+//--------------------------------------------------------------
+void ofApp::updateCoverage() {
+#ifdef SATELLITES
+    if (!catalogSnapshot) {
+        return;
+    }
+    if (coverage_pending.valid()) {
+        return;     // one grid at a time
+    }
+
+    // Average satellites in view over the next 90 minutes, overlaid on the
+    // earth once update() picks it up
+    std::shared_ptr<CoverageMap> coverage = std::make_shared<CoverageMap>();
+    std::vector<Satellite> objects;
+    for (unsigned int i = 0; i < catalogSnapshot->entries.size(); i++) {
+        objects.push_back(*catalogSnapshot->entries[i].satellite);
+    }
+    coverage->setSatellites(objects);
+    coverage->setWindow(obs.getJD(), obs.getJD() + 90.0 / 1440.0, 1.0 / 1440.0);
+    coverage->setMinElevation(10.0);
+
+    TaskScheduler* pool = &scheduler;
+    coverage_pending = std::async(std::launch::async, [coverage, pool]() {
+        return coverage->run(*pool)? coverage : std::shared_ptr<CoverageMap>();
+    });
+#endif
+}
+
+//--------------------------------------------------------------
+void ofApp::uploadCoverage(const CoverageMap& _coverage) {
+#ifdef SATELLITES
+    const std::vector<float>& mean = _coverage.getMean();
+    coverage_max = std::max(1.0f, *std::max_element(mean.begin(), mean.end()));
+
+    ofFloatPixels pixels;
+    pixels.setFromPixels(mean.data(), _coverage.getWidth(), _coverage.getHeight(), OF_PIXELS_GRAY);
+    coverage_texture.loadData(pixels);
+    coverage_texture.setTextureWrap(GL_REPEAT, GL_CLAMP_TO_EDGE);
+    ofLogNotice("CoverageMap") << _coverage.getSteps() << " steps, " << _coverage.getTests() << " cell tests, up to " << coverage_max << " in view";
+#endif
+}
+
+//--------------------------------------------------------------
+void ofApp::drawSatelliteLines(const HotArray<glm::vec3>& _positions) {
+    // A line reaches the screen even when neither end is on it
+    satellitesLines.clear();
+    satellitesLines.setMode(OF_PRIMITIVE_LINES);
+    for (unsigned int i = 0; i < _positions.size(); i++) {
+        satellitesLines.addVertex(glm::vec3(0.));
+        satellitesLines.addVertex(_positions[i]);
+    }
+    satellitesLines.draw();
+}
+
+//--------------------------------------------------------------
+void ofApp::clearTrails() {
+    moon.clearTale();
+    for (unsigned int i = 0; i < planets.size(); i++){
+        planets[i].clearTale();
+    }
+#ifdef SATELLITES
+    for (unsigned int i = 0; i < satellites.size(); i++){
+        satellites[i].clearTale();
+    }
+#endif
+}
+
+//--------------------------------------------------------------
+void ofApp::recordTimeline() {
+    vector<float> values, quanta;
+    packScene(values, quanta);
+
+#ifdef SATELLITES
+    // A different set of satellites can't be described as a delta
+    vector<unsigned int> norads;
+    if (catalogSnapshot) {
+        for (unsigned int i = 0; i < catalogSnapshot->entries.size(); i++) {
+            norads.push_back(catalogSnapshot->entries[i].norad);
+        }
+    }
+    if (norads != timelineNorads) {
+        timelineNorads.swap(norads);
+        timeline.requestKeyframe();
+    }
+#endif
+
+    timeline.setLayout(quanta);
+    if (timeline.isKeyframeDue(values.size())) {
+        timeline.record(obs.getJD(), values, packHud(true), "");
+    }
+    else {
+        timeline.record(obs.getJD(), values, "", packHud(false));
+    }
+    timelineLines = lines.size();
+    timelineMoons = moons.size();
+}
+
+//--------------------------------------------------------------
+void ofApp::seekTimeline(size_t _frame) {
+    if (!timeline.isOpen() || timeline.size() == 0) {
+        return;
+    }
+    _frame = std::min(_frame, timeline.size() - 1);
+
+    // Following frames only decode themselves and stepping back one frame
+    // only drops the last trail vertices. Jumps rebuild the trails from a
+    // bounded window before the target
+    bool back = (_frame + 1 == timelineFrame);
+    bool jump = (_frame != timelineFrame + 1) && !back;
+    size_t first = _frame;
+    if (back) {
+        moon.rewindTrail();
+        for (unsigned int i = 0; i < planets.size(); i++) {
+            planets[i].rewindTrail();
+        }
+#ifdef SATELLITES
+        for (unsigned int i = 0; i < satellites.size(); i++) {
+            satellites[i].rewindTrails(satellitesHot.geo[i], satellitesHot.helio[i]);
+        }
+#endif
+    }
+    else if (jump) {
+        clearTrails();
+        if (bBodiesTrail) {
+            first = (_frame > TIMELINE_TRAIL_FRAMES)? _frame - TIMELINE_TRAIL_FRAMES : 0;
+        }
+    }
+
+    timeline.play(first, _frame, [&](size_t _index, const TimelineFrame& _data) {
+        if (_data.keyframe) {
+            unpackSatellites(_data.state);
+        }
+        if (_index >= first) {
+            unpackScene(_data);
+            if (jump && bBodiesTrail && _index < _frame) {
+                moon.updateTrail();
+                for (unsigned int i = 0; i < planets.size(); i++) {
+                    planets[i].updateTrail();
+                }
+#ifdef SATELLITES
+                for (unsigned int i = 0; i < satellites.size(); i++) {
+                    satellites[i].updateTrails(satellitesHot.geo[i], satellitesHot.helio[i]);
+                }
+#endif
+            }
+        }
+    });
+    restoreHud(_frame);
+    timelineFrame = _frame;
+}
+
+//--------------------------------------------------------------
+void ofApp::packScene(vector<float>& _values, vector<float>& _quanta) {
+    // Scene units to 1e-4, AU to 1e-7 (~15km), angles to 1e-6 radians
+    vector<ofxBody*> bodies;
+    bodies.push_back(&sun);
+    for (unsigned int i = 0; i < planets.size(); i++) {
+        bodies.push_back(&planets[i]);
+    }
+    bodies.push_back(&moon);
+
+    for (unsigned int i = 0; i < bodies.size(); i++) {
+        const ofxBody& body = *bodies[i];
+        const glm::vec3* vectors[] = { &body.m_helioC, &body.m_geoC, &body.m_horC };
+        const float quantum[] = { 1e-4f, 1e-7f, 1e-7f };
+        for (int v = 0; v < 3; v++) {
+            for (int c = 0; c < 3; c++) {
+                _values.push_back((*vectors[v])[c]);
+                _quanta.push_back(quantum[v]);
+            }
+        }
+        _values.push_back(body.m_altitude);
+        _quanta.push_back(1e-6f);
+    }
+
+#ifdef SATELLITES
+    for (unsigned int i = 0; i < satellites.size(); i++) {
+        const glm::vec3* vectors[] = { &satellitesHot.equat[i], &satellitesHot.geo[i], &satellitesHot.helio[i] };
+        for (int v = 0; v < 3; v++) {
+            for (int c = 0; c < 3; c++) {
+                _values.push_back((*vectors[v])[c]);
+                _quanta.push_back(1e-4f);
+            }
+        }
     }
+#endif
+}
+
+//--------------------------------------------------------------
+void ofApp::unpackScene(const TimelineFrame& _frame) {
+    obs.setJD(_frame.jd);
+    eop.update(_frame.jd);
+    TimeOps::toDMY(_frame.jd, day, month, year);
+    date = TimeOps::formatDateTime(_frame.jd, Y_MON_D);
+    time = std::string(TimeOps::formatTime(_frame.jd + 0.1666666667, true));
+
+    const vector<float>& values = _frame.values;
+    size_t n = 0;
+    vector<ofxBody*> bodies;
+    bodies.push_back(&sun);
+    for (unsigned int i = 0; i < planets.size(); i++) {
+        bodies.push_back(&planets[i]);
+    }
+    bodies.push_back(&moon);
+
+    for (unsigned int i = 0; i < bodies.size() && n + 10 <= values.size(); i++) {
+        glm::vec3* vectors[] = { &bodies[i]->m_helioC, &bodies[i]->m_geoC, &bodies[i]->m_horC };
+        for (int v = 0; v < 3; v++, n += 3) {
+            *vectors[v] = glm::vec3(values[n], values[n + 1], values[n + 2]);
+        }
+        bodies[i]->m_altitude = values[n++];
+    }
+
+#ifdef SATELLITES
+    satellitesHot.resize(satellites.size(), precision.useFloat(Subsystem::SATELLITE_POSITIONS));
+    for (unsigned int i = 0; i < satellites.size() && n + 9 <= values.size(); i++) {
+        glm::vec3* vectors[] = { &satellitesHot.equat[i], &satellitesHot.geo[i], &satellitesHot.helio[i] };
+        for (int v = 0; v < 3; v++, n += 3) {
+            *vectors[v] = glm::vec3(values[n], values[n + 1], values[n + 2]);
+        }
+        ofxSatellite::getBounds(satellitesHot.helio[i], satellitesHot.geo[i], satellitesHot.bound[i], satellitesHot.boundRadius[i]);
+    }
+    // Illumination is not recorded, replayed satellites are drawn as lit
+    std::fill(satellitesHot.light.begin(), satellitesHot.light.end(), uint8_t(ILLUMINATION_LIT));
+    std::fill(satellitesHot.magnitude.begin(), satellitesHot.magnitude.end(), float(SATELLITES_STD_MAGNITUDE));
+#endif
+
+    v_equi = glm::vec3(eop.getEquinox());
+    toEarth = planets[2].m_helioC;
+    toEarth.normalize();
+}
+
+//--------------------------------------------------------------
+static void putLine(TimelineState& _state, const SrcLine& _line) {
+    _state.put(_line.A);
+    _state.put(_line.B);
+    _state.put(_line.T);
+    _state.putString(_line.text);
+}
+
+static bool getLine(TimelineState& _state, SrcLine& _line) {
+    return _state.get(_line.A) && _state.get(_line.B) && _state.get(_line.T) && _state.getString(_line.text);
+}
+
+std::string ofApp::packHud(bool _keyframe) {
+    // Only what was added since the last recorded frame (or all of it again
+    // after a clear), so the whole history is stored once. Keyframes lead
+    // with the satellites they were recorded with
+    TimelineState state;
+#ifdef SATELLITES
+    if (_keyframe) {
+        state.put(uint32_t(timelineNorads.size()));
+        for (size_t i = 0; i < timelineNorads.size(); i++) {
+            state.put(uint32_t(timelineNorads[i]));
+        }
+    }
+#endif
+
+    bool linesCleared = lines.size() < timelineLines;
+    bool moonsCleared = moons.size() < timelineMoons;
+    state.put(uint8_t((linesCleared? 1 : 0) | (moonsCleared? 2 : 0)));
+
+    state.put(uint8_t(bWriten));
+    state.put(int32_t(moon_prevPhase));
+    state.put(int32_t(prevDay));
+    state.put(int32_t(prevMonth));
+    state.put(int32_t(prevYear));
+    state.putString(oneYearIn);
+
+    size_t firstLine = linesCleared? 0 : timelineLines;
+    state.put(uint32_t(lines.size() - firstLine));
+    for (size_t i = firstLine; i < lines.size(); i++) {
+        putLine(state, lines[i]);
+    }
+
+    size_t firstMoon = moonsCleared? 0 : timelineMoons;
+    state.put(uint32_t(moons.size() - firstMoon));
+    for (size_t i = firstMoon; i < moons.size(); i++) {
+        state.put(moons[i].getPosition());
+        state.put(moons[i].getPhase());
+    }
+    return state.data;
+}
+
+void ofApp::indexHud(const std::string& _state, bool _keyframe) {
+    // Called for every frame in order when a recording is opened. A frame
+    // that can't be read keeps the HUD of the one before
+    HudFrame frame = timelineHud.empty()? HudFrame() : timelineHud.back();
+    TimelineState state;
+    state.data = _state;
+
+    uint32_t count = 0;
+#ifdef SATELLITES
+    if (_keyframe && state.get(count)) {
+        // The satellites are unpacked with the keyframe itself
+        state.pos = std::min(state.data.size(), state.pos + count * sizeof(uint32_t));
+    }
+#endif
+
+    uint8_t flags = 0;
+    uint8_t writen = 0;
+    int32_t phase = 0, d = 0, m = 0, y = 0;
+    if (!state.get(flags) || !state.get(writen) || !state.get(phase) || !state.get(d) || !state.get(m) || !state.get(y) || !state.getString(frame.oneYearIn)) {
+        timelineHud.push_back(timelineHud.empty()? HudFrame() : timelineHud.back());
+        return;
+    }
+    if (flags & 1) {
+        frame.linesBegin = frame.linesEnd;
+    }
+    if (flags & 2) {
+        frame.moonsBegin = frame.moonsEnd;
+    }
+    frame.writen = writen;
+    frame.moonPhase = phase;
+    frame.day = d;
+    frame.month = m;
+    frame.year = y;
+
+    count = 0;
+    state.get(count);
+    for (uint32_t i = 0; i < count; i++) {
+        SrcLine line;
+        if (!getLine(state, line)) {
+            break;
+        }
+        timelineHudLines.push_back(line);
+    }
+    frame.linesEnd = timelineHudLines.size();
+
+    count = 0;
+    state.get(count);
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec3 position;
+        float synodic = 0.;
+        if (!state.get(position) || !state.get(synodic)) {
+            break;
+        }
+        timelineHudMoons.push_back(ofxMoon(position, synodic));
+    }
+    frame.moonsEnd = timelineHudMoons.size();
+
+    timelineHud.push_back(frame);
+}
+
+void ofApp::restoreHud(size_t _frame) {
+    if (_frame >= timelineHud.size()) {
+        return;
+    }
+    const HudFrame& hud = timelineHud[_frame];
+    bWriten = hud.writen;
+    moon_prevPhase = hud.moonPhase;
+    prevDay = hud.day;
+    prevMonth = hud.month;
+    prevYear = hud.year;
+    oneYearIn = hud.oneYearIn;
+
+    // What is on screen is a window of the history. Neighbouring frames
+    // share most of it, so only the difference is added or dropped
+    size_t shownLines = hud.linesEnd - hud.linesBegin;
+    if (hud.linesBegin != timelineShownLines || lines.size() > shownLines) {
+        lines.assign(timelineHudLines.begin() + hud.linesBegin, timelineHudLines.begin() + hud.linesEnd);
+        timelineShownLines = hud.linesBegin;
+    }
+    else {
+        lines.insert(lines.end(), timelineHudLines.begin() + hud.linesBegin + lines.size(), timelineHudLines.begin() + hud.linesEnd);
+    }
+
+    // The phases' GPU ring can only grow, fewer of them means a rebuild
+    size_t shownMoons = hud.moonsEnd - hud.moonsBegin;
+    if (hud.moonsBegin != timelineShownMoons || moons.size() > shownMoons) {
+        moons.clear();
+        moonPhases.clear();
+        timelineShownMoons = hud.moonsBegin;
+    }
+    for (size_t i = hud.moonsBegin + moons.size(); i < hud.moonsEnd; i++) {
+        moons.push_back(timelineHudMoons[i]);
+        moonPhases.add(moons.back());
+    }
+}
+
+void ofApp::unpackSatellites(const std::string& _state) {
+#ifdef SATELLITES
+    // Rebuild the satellites in the recorded order, from the catalog when it has them
+    TimelineState state;
+    state.data = _state;
+    vector<unsigned int> norads;
+    uint32_t count = 0;
+    state.get(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t norad = 0;
+        if (!state.get(norad)) {
+            break;
+        }
+        norads.push_back(norad);
+    }
+    if (norads != timelineNorads) {
+        std::shared_ptr<const CatalogSnapshot> snapshot = catalog.get();
+        satellites.clear();
+        for (size_t i = 0; i < norads.size(); i++) {
+            int index = snapshot? snapshot->find(norads[i]) : -1;
+            satellites.push_back((index >= 0)? ofxSatellite(*snapshot->entries[index].satellite) : ofxSatellite());
+        }
+        timelineNorads.swap(norads);
+    }
+#endif
+}
+
+//--------------------------------------------------------------
+static std::string toJson(const std::string& _text) {
+    std::string out = "\"";
+    for (size_t i = 0; i < _text.size(); i++) {
+        unsigned char c = _text[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if (c >= 0x20) {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string toJson(const glm::vec3& _v) {
+    return "[" + ofToString(_v.x) + "," + ofToString(_v.y) + "," + ofToString(_v.z) + "]";
+}
+
+static std::string toJson(const SrcLine& _line) {
+    return "{\"type\":\"line\",\"a\":" + toJson(_line.A) + ",\"b\":" + toJson(_line.B) +
+           ",\"t\":" + toJson(_line.T) + ",\"text\":" + toJson(_line.text) + "}";
+}
+
+static std::string toJson(const ofxMoon& _moon) {
+    return "{\"type\":\"moon\",\"position\":" + toJson(_moon.getPosition()) + ",\"phase\":" + ofToString(_moon.getPhase()) + "}";
+}
+
+void ofApp::publishScene() {
+    // Same values (and order) as the timeline: per body helio, geo, horizontal and
+    // altitude, then per satellite equatorial, geo and helio
+    SceneFrame frame;
+    frame.jd = obs.getJD();
+    packScene(frame.values, frame.quanta);
+
+    // HUD changes since the last frame go out as events
+    if (lines.size() < serverLines) {
+        server.publishEvent("{\"type\":\"clear\",\"what\":\"lines\"}");
+        serverLines = 0;
+    }
+    for (size_t i = serverLines; i < lines.size(); i++) {
+        server.publishEvent(toJson(lines[i]));
+    }
+    if (moons.size() < serverMoons) {
+        server.publishEvent("{\"type\":\"clear\",\"what\":\"moons\"}");
+        serverMoons = 0;
+    }
+    for (size_t i = serverMoons; i < moons.size(); i++) {
+        server.publishEvent(toJson(moons[i]));
+    }
+    serverLines = lines.size();
+    serverMoons = moons.size();
+
+    vector<unsigned int> norads;
+#ifdef SATELLITES
+    if (bReplay) {
+        norads = timelineNorads;
+    }
+    else if (catalogSnapshot) {
+        for (unsigned int i = 0; i < catalogSnapshot->entries.size(); i++) {
+            norads.push_back(catalogSnapshot->entries[i].norad);
+        }
+    }
+#endif
+    frame.keyframe = (norads != serverNorads);
+    serverNorads.swap(norads);
+
+    if (frame.keyframe || server.wantsState()) {
+        std::string state = "{\"type\":\"state\",\"bodyStride\":10,\"satelliteStride\":9,\"bodies\":[" + toJson(sun.getName());
+        for (unsigned int i = 0; i < planets.size(); i++) {
+            state += "," + toJson(planets[i].getName());
+        }
+        state += "," + toJson(moon.getName()) + "],\"satellites\":[";
+#ifdef SATELLITES
+        for (unsigned int i = 0; i < satellites.size(); i++) {
+            state += (i? "," : "");
+            state += "{\"norad\":" + ofToString(i < serverNorads.size()? serverNorads[i] : 0) + ",\"name\":" + toJson(satellites[i].getName()) + "}";
+        }
+#endif
+        state += "],\"lines\":[";
+        for (size_t i = 0; i < lines.size(); i++) {
+            state += (i? "," : "") + toJson(lines[i]);
+        }
+        state += "],\"moons\":[";
+        for (size_t i = 0; i < moons.size(); i++) {
+            state += (i? "," : "") + toJson(moons[i]);
+        }
+        frame.state = state + "]}";
+    }
+    server.publish(std::move(frame));
+}
+
+//--------------------------------------------------------------
+void ofApp::setBenchmark(size_t _frames, size_t _objects, const std::string& _out) {
+    benchmark.setup(_frames, BENCHMARK_WARMUP);
+    benchmarkObjects = _objects;
+    benchmarkOut = _out;
+
+    // Notices go to stdout too, where the report is written by default.
+    // Set before setup(), which logs the most
+    ofSetLogLevel(OF_LOG_WARNING);
+}
+
+//--------------------------------------------------------------
+void ofApp::startBenchmark() {
+    // Every toggle on, so the worst case is what gets measured. Except
+    // eclipses: their search runs in the background and would land in
+    // different frames from run to run
+    bHelioCoords = bEclipCoords = bEquatCoords = bHorizCoords = true;
+    bEquatDir = bEquatDisk = true;
+    bBodiesTrail = true;
+    bHudLines = bMoonPhases = bCoverage = true;
+    bEclipses = false;
+    bTopoArrow = bTopoDisk = bTopoHud = bTopoHudLables = bTopoLables = true;
+    bDebugFps = true;
+
+    // Fixed time range, as fast as the machine goes
+    time_offset = 0.;
+    time_step = BENCHMARK_STEP;
+    time_play = true;
+    ofSetVerticalSync(false);
+    ofSetFrameRate(0);
+    cam.disableMouseInput();
+
+    // The same renderer, counting its draw calls
+    benchmarkRenderer = std::make_shared<ofxCountingRenderer>(ofGetWindowPtr());
+    benchmarkRenderer->setup(3, 2);
+    ofSetCurrentRenderer(benchmarkRenderer, true);
+
+    benchmark.setInfo("objects", ofToString(catalog.get()->entries.size()));
+    benchmark.setInfo("renderer", toJson(std::string((const char*)glGetString(GL_RENDERER))));
+    benchmark.setInfo("width", ofToString(ofGetWidth()));
+    benchmark.setInfo("height", ofToString(ofGetHeight()));
+    benchmark.setInfo("threads", ofToString(scheduler.getWorkers() + 1));
+}
+
+//--------------------------------------------------------------
+void ofApp::updateBenchmark() {
+    // Coverage needs the catalog the first update merged. Waited for, so
+    // it is on screen from the same frame in every run
+    if (benchmark.getFrame() == 1 && bCoverage) {
+        updateCoverage();
+        if (coverage_pending.valid()) {
+            coverage_pending.wait();
+        }
+    }
+
+    // Twice around the Earth, from just over the satellite shells out to
+    // the inner planets and back, rising and sinking over the ecliptic
+    float t = float(benchmark.getFrame()) / float(std::max<size_t>(1, benchmark.getTotalFrames()));
+    float zoom = .5 - .5 * cos(t * TWO_PI);
+    float near = earthSize * 4.;
+    float far = scale * 2.;
+    cam.orbitDeg(t * 720., 30. * sin(t * TWO_PI), near * pow(far / near, zoom), glm::vec3(0.));
+}
+
+//--------------------------------------------------------------
+void ofApp::finishBenchmark() {
+    bool written = false;
+    if (benchmarkOut.empty()) {
+        benchmark.writeJson(std::cout);
+        written = std::cout.good();
+    }
+    else {
+        std::ofstream file(ofToDataPath(benchmarkOut, true));
+        if (file.is_open()) {
+            benchmark.writeJson(file);
+            written = file.good();
+        }
+    }
+    if (!written) {
+        ofLogError("Benchmark") << "Can not write the report to " << (benchmarkOut.empty()? "stdout" : ofToDataPath(benchmarkOut, true));
+    }
+    benchmark.setup(0, 0);
+    ofExit(written? 0 : 1);
 }
 
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key){
-        
-    if ( key == '<' ) {
+    
+    if ( bReplay && (key == '<' || key == '>' || key == '/') ) {
+        // Scrub the recording by 1% of its length
+        size_t jump = std::max<size_t>(1, timeline.size() / 100);
+        if ( key == '<' ) {
+            seekTimeline(timelineFrame > jump? timelineFrame - jump : 0);
+        }
+        else if ( key == '>' ) {
+            seekTimeline(timelineFrame + jump);
+        }
+        else {
+            seekTimeline(0);
+        }
+    }
+    else if ( key == '<' ) {
         time_offset -= time_step;
     }
     else if ( key == '>' ) {
@@ -660,22 +1675,14 @@ void ofApp::keyPressed(int key){
     }
     else if ( key == '/' ) {
         time_offset = 0;
-        moon.clearTale();
-        for (unsigned int i = 0; i < planets.size(); i++){
-            planets[i].clearTale();
-        }
-        for (unsigned int i = 0; i < satellites.size(); i++){
-            satellites[i].clearTale();
-        }
+        clearTrails();
     }
     else if ( key == '[' ) {
         earthSize -= 0.5;
-        earthScaleFactor = ((earthSize * CoordOps::AU_TO_KM)/CoordOps::EARTH_EQUATORIAL_RADIUS_KM);
         moonSize = (earthSize/CoordOps::EARTH_EQUATORIAL_RADIUS_KM) * Luna::DIAMETER_KM;
     }
     else if ( key == ']' ) {
         earthSize += 0.5;
-        earthScaleFactor = ((earthSize * CoordOps::AU_TO_KM)/CoordOps::EARTH_EQUATORIAL_RADIUS_KM);
         moonSize = (earthSize/CoordOps::EARTH_EQUATORIAL_RADIUS_KM) * Luna::DIAMETER_KM;
     }
     else if ( key == '{' ) {
@@ -727,9 +1734,97 @@ void ofApp::keyPressed(int key){
     else if ( key == 'm' ) {
         bMoonPhases = !bMoonPhases;
     }
+    else if ( key == 'e' ) {
+        bEclipses = !bEclipses;
+    }
+#ifdef SATELLITES
+    else if ( key == 'g' ) {
+        exportGroundTracks(std::make_shared<GeoJsonWriter>(), "groundtracks.geojson");
+    }
+    else if ( key == 'G' ) {
+        exportGroundTracks(std::make_shared<GroundTrackBinaryWriter>(), "groundtracks.sgt");
+    }
+    else if ( key == 'c' ) {
+        bCoverage = !bCoverage;
+        if (bCoverage) {
+            updateCoverage();
+        }
+    }
+#endif
     else if ( key == 'd' ) {
         bDebugFps = !bDebugFps;
     }
+    else if ( key == 'D' ) {
+        if (!multiView.isAllocated() && multiView.setupCube(DOME_FACE_SIZE)) {
+            multiView.load(earth_multiview, "shaders/earth.vert", "shaders/earth.frag");
+            multiView.load(moon_multiview, "shaders/moon.vert", "shaders/moon.frag");
+        }
+        bDome = !bDome && multiView.isAllocated();
+    }
+    else if ( key == 'r' && !bReplay ) {
+        if (timeline.isRecording()) {
+            ofLogNotice("Timeline") << timeline.size() << " frames recorded";
+            timeline.close();
+        }
+        else if (timeline.create(ofToDataPath(TIMELINE_FILE, true))) {
+            timelineLines = timelineMoons = 0;
+            timelineNorads.clear();
+        }
+        else {
+            ofLogError("Timeline") << "Can't write " << TIMELINE_FILE;
+        }
+    }
+    else if ( key == 'w' ) {
+        if (server.isRunning()) {
+            server.stop();
+        }
+        else if (server.start(SERVER_PORT)) {
+            // History reaches clients with their snapshot, events start from here
+            serverLines = lines.size();
+            serverMoons = moons.size();
+            serverNorads.clear();
+            ofLogNotice("SceneServer") << "Streaming on ws://127.0.0.1:" << SERVER_PORT;
+        }
+        else {
+            ofLogError("SceneServer") << server.getError();
+        }
+    }
+    else if ( key == 'p' ) {
+        if (bReplay) {
+            // Back to live, the catalog merge rebuilds the satellites
+            timeline.close();
+            bReplay = false;
+            catalogSnapshot.reset();
+            clearTrails();
+        }
+        else {
+            timeline.close();
+            if (timeline.open(ofToDataPath(TIMELINE_FILE, true))) {
+                bReplay = true;
+                time_play = false;
+                timelineNorads.clear();
+
+                // The HUD is only recorded as deltas, index it once
+                timelineHud.clear();
+                timelineHudLines.clear();
+                timelineHudMoons.clear();
+                timeline.readStates([&](size_t _frame, bool _keyframe, const std::string& _state) {
+                    indexHud(_state, _keyframe);
+                });
+                timelineHud.resize(timeline.size(), timelineHud.empty()? HudFrame() : timelineHud.back());
+                lines.clear();
+                moons.clear();
+                moonPhases.clear();
+                timelineShownLines = timelineShownMoons = 0;
+
+                timelineFrame = 0;
+                seekTimeline(0);
+            }
+            else {
+                ofLogError("Timeline") << "Can't read " << TIMELINE_FILE;
+            }
+        }
+    }
     else {
         time_play = !time_play;
     }
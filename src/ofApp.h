@@ -1,9 +1,28 @@
 #pragma once
 
+#include <future>
+
 #include "ofMain.h"
 #include "ofxShader.h"
 
 #define GEOLOC_FILE "geoLoc.csv"
+#define EARTH_TILES "earth.dzi"
+#define TLE_FOLDER "tle"
+#define TIMELINE_FILE "timeline.stl"
+#define TIMELINE_TRAIL_FRAMES 2048
+#define SERVER_PORT 8765
+#define DOME_FACE_SIZE 1024
+#define DOME_FAR_AU 100                 // far plane of the faces, in AU at the scene's scale
+#define UPDATE_BODIES_GRAIN 16         // objects per parallel update chunk
+#define UPDATE_SATELLITES_GRAIN 256
+#define SATELLITES_STD_MAGNITUDE 5.0    // when the catalog does not know better
+#define SATELLITES_MAGNITUDE_LIMIT 4.5  // naked eye from a suburban sky
+#define SATELLITES_DARK_SKY -6.0        // Sun altitude (degrees) that makes them stand out
+#define BENCHMARK_FOLDER "benchmark"    // synthetic catalog, in data/
+#define BENCHMARK_WARMUP 30             // frames not recorded (catalog, SGP4 seeds, coverage)
+#define BENCHMARK_START_JD 2460310.5    // 2024/01/01 0h UT
+#define BENCHMARK_STEP 0.001            // days per frame
+#define BENCHMARK_SEED 1969
 
 #include "Astro/src/Observer.h"
 #include "Astro/src/Star.h"
@@ -12,7 +31,22 @@
 
 #include "ofxBody.h"
 #include "ofxMoon.h"
+#include "ofxMoonPhases.h"
 #include "ofxSatellite.h"
+#include "ofxVirtualTexture.h"
+#include "ofxMultiView.h"
+#include "ofxCatalog.h"
+#include "SatelliteCache.h"
+#include "EarthOrientation.h"
+#include "EclipseSearch.h"
+#include "GroundTrack.h"
+#include "CoverageMap.h"
+#include "Timeline.h"
+#include "FrustumCuller.h"
+#include "SceneServer.h"
+#include "TaskScheduler.h"
+#include "Benchmark.h"
+#include "ofxCountingRenderer.h"
 
 #define SATELLITES
 
@@ -23,6 +57,24 @@ struct SrcLine {
     std::string text;
 };
 
+// HUD of a replayed frame: its counters and the part of the recorded
+// history (lines, moon phases) that is on screen
+struct HudFrame {
+    bool        writen = false;
+    int         moonPhase = 0;
+    int         day = 0, month = 0, year = 0;
+    std::string oneYearIn;
+    size_t      linesBegin = 0, linesEnd = 0;
+    size_t      moonsBegin = 0, moonsEnd = 0;
+};
+
+// Billboard text held back from a multiview submission, camera view space
+struct SceneLabel {
+    std::string text;
+    glm::vec3   position;
+    ofFloatColor color;
+};
+
 struct HorLine {
     Horizontal A;
     Horizontal B;
@@ -35,6 +87,37 @@ public:
     void setup();
     void update();
     void draw();
+    void drawScene();
+    ofShader& sceneShader(ofShader& _shader, ofShader& _multiview);
+    void endSceneShader(ofShader& _shader);
+    // Billboard text, straight away or held for the dome's overlay passes
+    void drawLabel(const std::string& _text, const glm::vec3& _position);
+    void drawLabels();
+
+    template<typename T>
+    void updateSatellites(HotArray< EquatorialVector<Unit::KM, T> >& _eci);
+    void exportGroundTracks(std::shared_ptr<GroundTrackWriter> _writer, const std::string& _file);
+    void updateCoverage();
+    void uploadCoverage(const CoverageMap& _coverage);
+    void clearTrails();
+    // One batch of lines from the origin to every satellite, culled or not
+    void drawSatelliteLines(const HotArray<glm::vec3>& _positions);
+
+    void recordTimeline();
+    void seekTimeline(size_t _frame);
+    void packScene(vector<float>& _values, vector<float>& _quanta);
+    void unpackScene(const TimelineFrame& _frame);
+    std::string packHud(bool _keyframe);
+    void indexHud(const std::string& _state, bool _keyframe);
+    void restoreHud(size_t _frame);
+    void unpackSatellites(const std::string& _state);
+    void publishScene();
+
+    // Synthetic catalog, every toggle on, scripted camera; writes JSON and exits
+    void setBenchmark(size_t _frames, size_t _objects, const std::string& _out);
+    void startBenchmark();
+    void updateBenchmark();
+    void finishBenchmark();
 
     void keyPressed(int key);
     void keyReleased(int key);
@@ -50,6 +133,9 @@ public:
     
     // Observer
     Observer        obs;
+    EarthOrientation eop;
+    PrecisionPolicy precision;
+    TaskScheduler   scheduler;
     // Place
     double          lng, lat;
     ofPoint         loc;
@@ -64,17 +150,22 @@ public:
     
     // Scene
     ofEasyCam       cam;
+    FrustumCuller   culler;
+    ofxMultiView    multiView;          // dome master from the six faces around the camera
+    vector<SceneLabel> sceneLabels;     // this frame's, while multiview draws the dome
     double          scale;
     bool            bWriten;
     
     // SUN
     // -----------------------
-    Body            sun;
+    ofxBody         sun;
     
     // PLANETS
     // -----------------------
     float           planetsSizes[10];
     vector<ofxBody> planets;
+    vector< HelioVector<Unit::AU> > planetsHelio;
+    vector<glm::vec3> planetsScene;
     
     // MOON
     // -----------------------
@@ -82,24 +173,80 @@ public:
     float           moonSize;
     float           moonScaleDistance; // for the distance
     ofxShader  moon_shader;
+    ofShader        moon_multiview;
     int             moon_prevPhase;
     vector<ofxMoon> moons;
+    ofxMoonPhases   moonPhases;
     Luna            luna;
     
+    // ECLIPSES
+    // -----------------------
+    EclipseSearch   eclipseSearch;
+    vector<Eclipse> eclipses;
+    double          eclipsesStart, eclipsesEnd;
+    std::future< vector<Eclipse> > eclipsesPending;   // search running in the background
+    double          eclipsesPendingStart, eclipsesPendingEnd;
+    
     // EART
     // -----------------------
     float           earthSize;
-    float           earthScaleFactor;
     ofTexture       earth_texture;
+    ofxVirtualTexture earth_tiles;      // high resolution imagery, when there is a pyramid
+    bool            earth_tiles_picked; // this frame, the dome draws the scene once per pass
     ofxShader       earth_shader;
+    ofShader        earth_multiview;
+    ofTexture       coverage_texture;
+    float           coverage_max;
+    std::future< std::shared_ptr<CoverageMap> > coverage_pending;   // grid computed in the background
     
 #ifdef SATELLITES
     // SATELLITES
     // -----------------------
     float           satellitesSize;
     vector<ofxSatellite> satellites;
+    ofxCatalog      catalog;
+    std::shared_ptr<const CatalogSnapshot> catalogSnapshot;
+    SatelliteCache  satelliteCache;
+    CatalogHot      satellitesHot;          // per tick positions and illumination
+    double          satellitesMisses;       // cache misses per object, last tick
+    vector<uint32_t> satellitesVisible;
+    vector<uint32_t> satellitesLabeled;
+    ofMesh          satellitesLines;
+    vector<uint32_t> satellitesNakedEye;
+    ofFloatColor    satellitesPalette[ILLUMINATION_STATES];
+    std::future<size_t> groundTracksPending;    // export running in the background
+    std::string     groundTracksPath;
+    size_t          groundTracksObjects;
 #endif
     
+    // BENCHMARK
+    // -----------------------
+    Benchmark       benchmark;
+    size_t          benchmarkObjects;
+    std::string     benchmarkOut;       // stdout when empty
+    std::shared_ptr<ofxCountingRenderer> benchmarkRenderer;
+
+    // TIMELINE
+    // -----------------------
+    Timeline        timeline;
+    size_t          timelineFrame;
+    size_t          timelineLines;      // HUD sizes at the last recorded frame
+    size_t          timelineMoons;
+    vector<unsigned int> timelineNorads;
+    vector<HudFrame> timelineHud;       // per replayed frame
+    vector<SrcLine> timelineHudLines;   // every line and moon phase the recording added
+    vector<ofxMoon> timelineHudMoons;
+    size_t          timelineShownLines; // history index of the first line and moon on screen
+    size_t          timelineShownMoons;
+    bool            bReplay;
+    
+    // SERVER
+    // -----------------------
+    SceneServer     server;
+    size_t          serverLines;        // HUD sizes at the last published frame
+    size_t          serverMoons;
+    vector<unsigned int> serverNorads;
+    
     // HUD
     // -----------------------
     vector<SrcLine> lines;
@@ -129,6 +276,8 @@ public:
     
     bool            bHudLines;
     bool            bMoonPhases;
+    bool            bEclipses;
+    bool            bCoverage;
     
     bool            bTopoArrow;
     bool            bTopoDisk;
@@ -137,4 +286,5 @@ public:
     bool            bTopoLables;
     
     bool            bDebugFps;
+    bool            bDome;
 };
@@ -7,27 +7,22 @@
 
 #include "ofxBody.h"
 
-ofxBody::ofxBody() {
+ofxBody::ofxBody() : m_altitude(0.) {
     m_bodyId = NAB;
 }
 
-ofxBody::ofxBody(BodyId _planet) {
+ofxBody::ofxBody(BodyId _planet) : m_altitude(0.) {
     m_bodyId = _planet;
 }
 
-glm::vec3 ofxBody::getGeoPosition(DISTANCE_UNIT _type) {
-    Vector gPos = getEclipticGeocentric().getVector(_type);
-    return glm::vec3(gPos.x, gPos.y, gPos.z);
+void ofxBody::cache() {
+    m_geoC = getGeoPosition<Unit::AU>().toGlm(1.0);
+    Vector hor = getHorizontalVector(AU);
+    m_horC = glm::vec3(hor.x, hor.y, hor.z);
+    m_altitude = getHorizontal().getAltitud(RADS);
 }
 
-glm::vec3 ofxBody::getHelioPosition(DISTANCE_UNIT _type) {
-    Vector hPos = getEclipticHeliocentric().getVector(_type);
-    return glm::vec3(hPos.x, hPos.y, hPos.z);
-}
-
-void ofxBody::drawTrail(ofFloatColor _color) {
-    ofSetColor(_color);
-    
+void ofxBody::updateTrail() {
     if ( m_trail.size() == 0) {
         m_trail.addVertex(m_helioC);
     } else if ( m_trail[m_trail.size()-1].x != m_helioC.x ||
@@ -35,6 +30,17 @@ void ofxBody::drawTrail(ofFloatColor _color) {
                 m_trail[m_trail.size()-1].z != m_helioC.z ) {
         m_trail.addVertex(m_helioC);
     }
+}
+
+void ofxBody::rewindTrail() {
+    if ( m_trail.size() > 0 && m_trail[m_trail.size()-1] == m_helioC ) {
+        m_trail.resize(m_trail.size()-1);
+    }
+}
+
+void ofxBody::drawTrail(ofFloatColor _color) {
+    ofSetColor(_color);
+    updateTrail();
     m_trail.draw();
 }
 
@@ -42,14 +48,15 @@ void ofxBody::clearTale() {
     m_trail.clear();
 }
 
-void ofxBody::draw(ofFloatColor _color, float _size) {
+void ofxBody::draw(ofFloatColor _color, float _size, bool _label) {
     ofSetColor(_color);
     ofDrawSphere(m_helioC, _size);
     
-    if (m_bodyId != EARTH &&
+    if (_label &&
+        m_bodyId != EARTH &&
         m_bodyId != LUNA &&
         m_bodyId != SUN) {
         ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
-        ofDrawBitmapString(getName(), m_helioC + ofPoint(_size*2. + 1.5));
+        ofDrawBitmapString(getName(), getLabelPosition(_size));
     }
 }
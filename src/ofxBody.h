@@ -10,20 +10,35 @@
 #include "ofMain.h"
 #include "Astro/src/Body.h"
 
+#include "FrameVector.h"
+
 class ofxBody : public Body {
 public:
     ofxBody();
     ofxBody(BodyId _planet);
     
+    // Keeps what the scene draws from the last compute(), so it can also be restored from a recording
+    void cache();
+    
+    void updateTrail();
+    // Drops the vertex of the current position, one frame back along the trail
+    void rewindTrail();
     void drawTrail(ofFloatColor _color);
-    void draw(ofFloatColor _color, float _size);
+    void draw(ofFloatColor _color, float _size, bool _label = true);
+    // Where draw() puts the name for a body of _size
+    glm::vec3 getLabelPosition(float _size) const { return m_helioC + glm::vec3(_size*2. + 1.5); }
     
     void clearTale();
     
-    glm::vec3   getGeoPosition(DISTANCE_UNIT _type);
-    glm::vec3   getHelioPosition(DISTANCE_UNIT _type);
+    template<Unit U>
+    GeoVector<U>    getGeoPosition() { return GeoVector<U>(getEclipticGeocentric().getVector(AU)).template to<U>(); }
+    template<Unit U>
+    HelioVector<U>  getHelioPosition() { return HelioVector<U>(getEclipticHeliocentric().getVector(AU)).template to<U>(); }
     
     glm::vec3   m_helioC;
+    glm::vec3   m_geoC;     // ecliptic geocentric, AU
+    glm::vec3   m_horC;     // horizontal, AU
+    float       m_altitude; // radians
     
 protected:
     ofPolyline  m_trail;
@@ -0,0 +1,191 @@
+//
+//  ofxCatalog.cpp
+//  Solar
+//
+
+#include "ofxCatalog.h"
+#include "TleFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+#include <sys/stat.h>
+
+#ifdef TARGET_LINUX
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace {
+
+time_t folderStamp(const std::string& _folder) {
+    time_t stamp = 0;
+    struct stat info;
+    if (stat(_folder.c_str(), &info) == 0) {
+        stamp = info.st_mtime;
+    }
+
+    ofDirectory dir(_folder);
+    dir.listDir();
+    for (size_t i = 0; i < dir.size(); i++) {
+        if (stat(dir.getPath(i).c_str(), &info) == 0) {
+            stamp = std::max(stamp, info.st_mtime);
+        }
+    }
+    return stamp;
+}
+
+}
+
+int CatalogSnapshot::find(unsigned int _norad) const {
+    std::vector<CatalogEntry>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), _norad,
+        [](const CatalogEntry& _entry, unsigned int _id) { return _entry.norad < _id; });
+    if (it != entries.end() && it->norad == _norad) {
+        return int(it - entries.begin());
+    }
+    return -1;
+}
+
+ofxCatalog::ofxCatalog() : m_running(false) {
+    m_snapshot = std::make_shared<CatalogSnapshot>();
+}
+
+ofxCatalog::~ofxCatalog() {
+    stop();
+}
+
+void ofxCatalog::setup(const std::string& _folder) {
+    stop();
+    m_folder = ofToDataPath(_folder, true);
+    reload();
+
+    m_running = true;
+    m_thread = std::thread(&ofxCatalog::watch, this);
+}
+
+void ofxCatalog::stop() {
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+std::shared_ptr<const CatalogSnapshot> ofxCatalog::get() const {
+    return std::atomic_load(&m_snapshot);
+}
+
+void ofxCatalog::publish(const std::shared_ptr<const CatalogSnapshot>& _snapshot) {
+    std::atomic_store(&m_snapshot, _snapshot);
+}
+
+void ofxCatalog::reload() {
+    std::map<unsigned int, TleText> tles;
+    ofDirectory dir(m_folder);
+    dir.allowExt("tle");
+    dir.allowExt("txt");
+    dir.listDir();
+    dir.sort();
+    for (size_t i = 0; i < dir.size(); i++) {
+        TleFile::load(dir.getPath(i), tles);
+    }
+
+    std::shared_ptr<const CatalogSnapshot> previous = get();
+    std::shared_ptr<CatalogSnapshot> next = std::make_shared<CatalogSnapshot>();
+    next->generation = previous->generation + 1;
+    next->entries.reserve(tles.size());
+    next->metadata.reserve(tles.size());
+
+    size_t changed = 0;
+    for (std::map<unsigned int, TleText>::iterator it = tles.begin(); it != tles.end(); ++it) {
+        CatalogEntry entry;
+        entry.norad = it->first;
+
+        // Unchanged objects share the already initialised propagator
+        int index = previous->find(entry.norad);
+        if (index >= 0 && previous->metadata.same(index, it->second)) {
+            entry.satellite = previous->entries[index].satellite;
+        }
+        else {
+            try {
+                entry.satellite = std::make_shared<ofxSatellite>(TLE(it->second.name, it->second.line1, it->second.line2));
+            }
+            catch (...) {
+                ofLogWarning("ofxCatalog") << "Skipping malformed TLE for NORAD " << entry.norad;
+                continue;
+            }
+            changed++;
+        }
+        next->entries.push_back(entry);
+        next->metadata.add(entry.norad, it->second);
+    }
+    next->metadata.shrink();
+
+    if (changed == 0 && next->entries.size() == previous->entries.size()) {
+        return;
+    }
+
+    ofLogNotice("ofxCatalog") << next->entries.size() << " objects, " << changed << " updated, "
+                              << next->metadata.bytes() / std::max<size_t>(1, next->entries.size()) << " bytes of metadata each";
+    publish(next);
+}
+
+void ofxCatalog::watch() {
+#ifdef TARGET_LINUX
+    int fd = inotify_init1(IN_NONBLOCK);
+    int wd = (fd >= 0)? inotify_add_watch(fd, m_folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) : -1;
+    if (wd >= 0) {
+        char buffer[4096];
+        bool pending = false;
+        while (m_running) {
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            int ready = poll(&pfd, 1, 250);
+            if (ready > 0) {
+                while (read(fd, buffer, sizeof(buffer)) > 0) {}
+                // wait for the next quiet period so multi-file drops land in one reload
+                pending = true;
+            }
+            else if (ready == 0 && pending) {
+                pending = false;
+                reload();
+            }
+        }
+        inotify_rm_watch(fd, wd);
+        close(fd);
+        return;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    ofLogWarning("ofxCatalog") << "inotify unavailable for " << m_folder << ", polling instead";
+#endif
+
+    // Portable fallback: poll the modification times of the folder content
+    time_t last = folderStamp(m_folder);
+    while (m_running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        time_t stamp = folderStamp(m_folder);
+        if (stamp != last) {
+            last = stamp;
+            reload();
+        }
+    }
+}
+
+void ofxCatalog::merge(const CatalogSnapshot* _previous, const CatalogSnapshot& _snapshot, std::vector<ofxSatellite>& _satellites) {
+    std::vector<ofxSatellite> next;
+    next.reserve(_snapshot.entries.size());
+    for (size_t i = 0; i < _snapshot.entries.size(); i++) {
+        const CatalogEntry& entry = _snapshot.entries[i];
+        int index = (_previous)? _previous->find(entry.norad) : -1;
+        if (index >= 0 && index < int(_satellites.size()) &&
+            _previous->entries[index].satellite == entry.satellite) {
+            next.push_back(std::move(_satellites[index]));
+        }
+        else {
+            next.push_back(*entry.satellite);
+        }
+    }
+    _satellites.swap(next);
+}
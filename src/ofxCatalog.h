@@ -0,0 +1,64 @@
+//
+//  ofxCatalog.h
+//  Solar
+//
+//  Watches a folder of TLE files and publishes an immutable snapshot of
+//  the catalog every time it changes. Parsing and SGP4 initialisation
+//  happen on a background thread; readers only copy the current pointer.
+//  Names, designators and TLE lines are kept once, in the snapshot's
+//  CatalogMetadata arena.
+//
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ofxSatellite.h"
+#include "CatalogStore.h"
+
+struct CatalogEntry {
+    unsigned int    norad;
+    std::shared_ptr<const ofxSatellite> satellite;
+};
+
+struct CatalogSnapshot {
+    unsigned long               generation;
+    std::vector<CatalogEntry>   entries;    // sorted by NORAD id
+    CatalogMetadata             metadata;   // same order as entries
+
+    int find(unsigned int _norad) const;
+};
+
+class ofxCatalog {
+public:
+    ofxCatalog();
+    virtual ~ofxCatalog();
+
+    // Loads the folder synchronously once and starts watching it
+    void    setup(const std::string& _folder);
+    void    stop();
+
+    // Safe to call from any thread. Not lock-free: std::atomic_load on a
+    // shared_ptr takes a short internal lock. Never returns null after setup()
+    std::shared_ptr<const CatalogSnapshot> get() const;
+
+    // Rebuilds _satellites to match _snapshot. Objects whose TLE did not
+    // change since _previous are moved over with their trails intact.
+    static void merge(  const CatalogSnapshot* _previous,
+                        const CatalogSnapshot& _snapshot,
+                        std::vector<ofxSatellite>& _satellites);
+
+protected:
+    void    reload();
+    void    watch();
+    void    publish(const std::shared_ptr<const CatalogSnapshot>& _snapshot);
+
+    std::shared_ptr<const CatalogSnapshot>  m_snapshot;
+    std::string         m_folder;
+    std::thread         m_thread;
+    std::atomic<bool>   m_running;
+};
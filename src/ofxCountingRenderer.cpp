@@ -0,0 +1,41 @@
+//
+//  ofxCountingRenderer.cpp
+//  Solar
+//
+
+#include "ofxCountingRenderer.h"
+
+ofxCountingRenderer::ofxCountingRenderer(const ofAppBaseWindow* _window) :
+    ofGLProgrammableRenderer(_window),
+    m_drawCalls(0),
+    m_vertices(0) {
+}
+
+void ofxCountingRenderer::reset() {
+    m_drawCalls = 0;
+    m_vertices = 0;
+}
+
+void ofxCountingRenderer::draw(const ofVbo& _vbo, GLuint _drawMode, int _first, int _total) const {
+    m_drawCalls++;
+    m_vertices += _total;
+    ofGLProgrammableRenderer::draw(_vbo, _drawMode, _first, _total);
+}
+
+void ofxCountingRenderer::drawElements(const ofVbo& _vbo, GLuint _drawMode, int _amt, int _offsetElements) const {
+    m_drawCalls++;
+    m_vertices += _amt;
+    ofGLProgrammableRenderer::drawElements(_vbo, _drawMode, _amt, _offsetElements);
+}
+
+void ofxCountingRenderer::drawInstanced(const ofVbo& _vbo, GLuint _drawMode, int _first, int _total, int _primCount) const {
+    m_drawCalls++;
+    m_vertices += size_t(_total) * _primCount;
+    ofGLProgrammableRenderer::drawInstanced(_vbo, _drawMode, _first, _total, _primCount);
+}
+
+void ofxCountingRenderer::drawElementsInstanced(const ofVbo& _vbo, GLuint _drawMode, int _amt, int _primCount) const {
+    m_drawCalls++;
+    m_vertices += size_t(_amt) * _primCount;
+    ofGLProgrammableRenderer::drawElementsInstanced(_vbo, _drawMode, _amt, _primCount);
+}
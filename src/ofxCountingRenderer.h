@@ -0,0 +1,36 @@
+//
+//  ofxCountingRenderer.h
+//  Solar
+//
+//  The programmable renderer, counting what it submits. With GL 3.2
+//  every oF draw (meshes, polylines, bitmap strings, primitives) ends up
+//  in one of the four ofVbo entry points below, so their calls are the
+//  frame's draw calls. Installed with ofSetCurrentRenderer() for the
+//  benchmark only; raw gl calls made outside of oF are not counted.
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+class ofxCountingRenderer : public ofGLProgrammableRenderer {
+public:
+    ofxCountingRenderer(const ofAppBaseWindow* _window);
+
+    // The other draw() overloads stay visible
+    using ofGLProgrammableRenderer::draw;
+    using ofGLProgrammableRenderer::drawInstanced;
+
+    virtual void draw(const ofVbo& _vbo, GLuint _drawMode, int _first, int _total) const;
+    virtual void drawElements(const ofVbo& _vbo, GLuint _drawMode, int _amt, int _offsetElements = 0) const;
+    virtual void drawInstanced(const ofVbo& _vbo, GLuint _drawMode, int _first, int _total, int _primCount) const;
+    virtual void drawElementsInstanced(const ofVbo& _vbo, GLuint _drawMode, int _amt, int _primCount) const;
+
+    void        reset();
+    size_t      getDrawCalls() const { return m_drawCalls; }
+    size_t      getVertices() const { return m_vertices; }
+
+protected:
+    mutable size_t  m_drawCalls;
+    mutable size_t  m_vertices;
+};
@@ -16,15 +16,8 @@ public:
         m_phase = _phase;
     }
     
-    void draw(ofVboMesh &_bill, ofShader &_shader, float _size) {
-        ofSetColor(255);
-        ofPushMatrix();
-        ofTranslate(m_position);
-        ofScale(_size, _size);
-        _shader.setUniform1f("u_synodic_day", m_phase);
-        _bill.draw();
-        ofPopMatrix();
-    }
+    const glm::vec3& getPosition() const { return m_position; }
+    float   getPhase() const { return m_phase; }
     
 protected:
     glm::vec3   m_position;
@@ -0,0 +1,61 @@
+//
+//  ofxMoonPhases.cpp
+//  Solar
+//
+
+#include "ofxMoonPhases.h"
+
+ofxMoonPhases::ofxMoonPhases() :
+    m_mode(GL_TRIANGLE_FAN),
+    m_vertices(0),
+    m_location(-1),
+    m_capacity(0),
+    m_count(0),
+    m_next(0) {
+}
+
+void ofxMoonPhases::setup(const ofMesh& _billboard, size_t _capacity) {
+    m_billboard.setMesh(_billboard, GL_STATIC_DRAW);
+    m_mode = ofGetGLPrimitiveMode(_billboard.getMode());
+    m_vertices = int(_billboard.getNumVertices());
+
+    m_capacity = std::max<size_t>(1, _capacity);
+    m_instances.allocate(m_capacity * sizeof(glm::vec4), GL_DYNAMIC_DRAW);
+    m_location = -1;
+    clear();
+}
+
+void ofxMoonPhases::add(const ofxMoon& _moon) {
+    if (m_capacity == 0) {
+        return;
+    }
+    glm::vec4 instance(_moon.getPosition(), _moon.getPhase());
+    m_instances.updateData(m_next * sizeof(glm::vec4), sizeof(glm::vec4), &instance);
+    m_next = (m_next + 1) % m_capacity;
+    m_count = std::min(m_count + 1, m_capacity);
+}
+
+void ofxMoonPhases::clear() {
+    m_count = 0;
+    m_next = 0;
+}
+
+void ofxMoonPhases::draw(ofShader& _shader, float _size) {
+    if (m_count == 0) {
+        return;
+    }
+
+    // Looked up every frame, the shader can be reloaded and relinked
+    int location = _shader.getAttributeLocation("a_moon");
+    if (location < 0) {
+        return;
+    }
+    if (location != m_location) {
+        m_billboard.setAttributeBuffer(location, m_instances, 4, sizeof(glm::vec4), 0);
+        m_billboard.setAttributeDivisor(location, 1);
+        m_location = location;
+    }
+
+    _shader.setUniform1f("u_size", _size);
+    m_billboard.drawInstanced(m_mode, 0, m_vertices, int(m_count));
+}
@@ -0,0 +1,40 @@
+//
+//  ofxMoonPhases.h
+//  Solar
+//
+//  The moon phase billboards of the HUD, drawn with a single instanced
+//  call. Every phase is one vec4 instance (position, synodic day) in a GPU
+//  buffer that is written once, when the phase is added. The buffer is a
+//  ring: past its capacity the oldest phases are overwritten.
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "ofxMoon.h"
+
+#define MOON_PHASES_CAPACITY 4096
+
+class ofxMoonPhases {
+public:
+    ofxMoonPhases();
+
+    void    setup(const ofMesh& _billboard, size_t _capacity = MOON_PHASES_CAPACITY);
+
+    void    add(const ofxMoon& _moon);
+    void    clear();
+    size_t  size() const { return m_count; }
+
+    // With _shader bound; its "a_moon" attribute receives the instances
+    void    draw(ofShader& _shader, float _size);
+
+protected:
+    ofVbo           m_billboard;
+    ofBufferObject  m_instances;
+    GLenum          m_mode;
+    int             m_vertices;
+    int             m_location;     // of a_moon the buffer is bound to, -1 when not yet
+    size_t          m_capacity;
+    size_t          m_count;
+    size_t          m_next;
+};
@@ -0,0 +1,309 @@
+//
+//  ofxMultiView.cpp
+//  Solar
+//
+
+#include "ofxMultiView.h"
+
+ofxMultiView::ofxMultiView() :
+    m_projection(1.0f),
+    m_fov(90.0f),
+    m_near(MULTIVIEW_NEAR), m_far(MULTIVIEW_FAR),
+    m_width(0), m_height(0),
+    m_cube(false),
+    m_multiview(false),
+    m_fbo(0), m_layerFbo(0), m_color(0), m_depth(0),
+    m_previous(0) {
+}
+
+ofxMultiView::~ofxMultiView() {
+    clear();
+}
+
+bool ofxMultiView::setupCube(int _faceSize) {
+    // Each face maps its axis to -Z: front, right, back, left, up, down
+    std::vector<glm::mat4> rotations;
+    glm::vec3 yAxis(0.0f, 1.0f, 0.0f), xAxis(1.0f, 0.0f, 0.0f);
+    rotations.push_back(glm::mat4(1.0f));
+    rotations.push_back(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), yAxis));
+    rotations.push_back(glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), yAxis));
+    rotations.push_back(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), yAxis));
+    rotations.push_back(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), xAxis));
+    rotations.push_back(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), xAxis));
+    if (!setup(_faceSize, _faceSize, rotations, 90.0f)) {
+        return false;
+    }
+    m_cube = true;
+    return true;
+}
+
+bool ofxMultiView::setup(int _width, int _height, const std::vector<glm::mat4>& _rotations, float _fovDegrees) {
+    clear();
+    if (_rotations.empty() || _rotations.size() > MULTIVIEW_MAX_VIEWS || _width <= 0 || _height <= 0) {
+        ofLogError("ofxMultiView") << "Between 1 and " << MULTIVIEW_MAX_VIEWS << " views";
+        return false;
+    }
+    m_rotations = _rotations;
+    m_width = _width;
+    m_height = _height;
+    m_fov = _fovDegrees;
+    m_cube = false;
+    m_projection = glm::perspective(glm::radians(m_fov), float(m_width) / float(m_height), m_near, m_far);
+    m_multiview = ofGLCheckExtension("GL_OVR_multiview2");
+
+    if (!allocate()) {
+        clear();
+        return false;
+    }
+
+    if (m_multiview) {
+        load(m_default, "shaders/multiview.vert", "shaders/multiview.frag");
+    }
+    m_warp.setupShaderFromSource(GL_VERTEX_SHADER, source("shaders/dome.vert", true, 0));
+    m_warp.setupShaderFromSource(GL_FRAGMENT_SHADER, source("shaders/dome.frag", false, 0));
+    m_warp.bindDefaults();
+    m_warp.linkProgram();
+
+    m_quad.clear();
+    m_quad.setMode(OF_PRIMITIVE_TRIANGLE_FAN);
+    m_quad.addVertex(glm::vec3(0.0f, 0.0f, 0.0f));
+    m_quad.addTexCoord(glm::vec2(0.0f, 1.0f));
+    m_quad.addVertex(glm::vec3(1.0f, 0.0f, 0.0f));
+    m_quad.addTexCoord(glm::vec2(1.0f, 1.0f));
+    m_quad.addVertex(glm::vec3(1.0f, 1.0f, 0.0f));
+    m_quad.addTexCoord(glm::vec2(1.0f, 0.0f));
+    m_quad.addVertex(glm::vec3(0.0f, 1.0f, 0.0f));
+    m_quad.addTexCoord(glm::vec2(0.0f, 0.0f));
+
+    ofLogNotice("ofxMultiView") << m_rotations.size() << " views of " << m_width << "x" << m_height
+                                << (m_multiview? ", single pass" : ", one pass each (no GL_OVR_multiview2)");
+    return true;
+}
+
+void ofxMultiView::setClip(float _near, float _far) {
+    m_near = _near;
+    m_far = _far;
+    if (m_width > 0) {
+        m_projection = glm::perspective(glm::radians(m_fov), float(m_width) / float(m_height), m_near, m_far);
+    }
+}
+
+bool ofxMultiView::allocate() {
+    GLsizei layers = GLsizei(m_rotations.size());
+
+    glGenTextures(1, &m_color);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_color);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, m_width, m_height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &m_depth);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_depth);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, m_width, m_height, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_previous);
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    if (m_multiview) {
+        glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_color, 0, 0, layers);
+        glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depth, 0, 0, layers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            ofLogWarning("ofxMultiView") << "Multiview framebuffer incomplete, drawing one view per pass";
+            m_multiview = false;
+        }
+    }
+    if (m_multiview) {
+        // The overlays draw one layer at a time next to the multiview target
+        glGenFramebuffers(1, &m_layerFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_layerFbo);
+    }
+
+    // begin() without multiview and beginOverlay() attach each layer the same way
+    bool complete = true;
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_color, 0, 0);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depth, 0, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        ofLogError("ofxMultiView") << "Layered framebuffer incomplete";
+        complete = false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_previous);
+    return complete;
+}
+
+void ofxMultiView::clear() {
+    if (m_fbo) {
+        glDeleteFramebuffers(1, &m_fbo);
+    }
+    if (m_layerFbo) {
+        glDeleteFramebuffers(1, &m_layerFbo);
+    }
+    if (m_color) {
+        glDeleteTextures(1, &m_color);
+    }
+    if (m_depth) {
+        glDeleteTextures(1, &m_depth);
+    }
+    m_fbo = m_layerFbo = m_color = m_depth = 0;
+}
+
+std::string ofxMultiView::source(const std::string& _path, bool _vertex, size_t _views) const {
+    // The shaders of the scene are written without a version, in the old
+    // attribute/varying style: the header makes them valid 1.50
+    std::string header = "#version 150\n";
+    if (_views > 0) {
+        header += "#extension GL_OVR_multiview2 : require\n";
+        header += "layout(num_views = " + ofToString(_views) + ") in;\n";
+        header += "uniform mat4 u_views[" + ofToString(_views) + "];\n";
+    }
+    if (_vertex) {
+        header += "#define attribute in\n#define varying out\n";
+    }
+    else {
+        header += "#define varying in\n#define texture2D texture\nout vec4 fragColor;\n#define gl_FragColor fragColor\n";
+    }
+
+    std::string body = ofBufferFromFile(ofToDataPath(_path)).getText();
+    if (_vertex && _views > 0) {
+        // Their main() still runs, then its view space position is projected for each view
+        return header + "#define main sceneMain\n" + body +
+            "\n#undef main\n"
+            "void main() {\n"
+            "    sceneMain();\n"
+            "    gl_Position = u_views[gl_ViewID_OVR] * gl_Position;\n"
+            "}\n";
+    }
+    return header + body;
+}
+
+bool ofxMultiView::load(ofShader& _shader, const std::string& _vert, const std::string& _frag) const {
+    if (!m_multiview) {
+        return false;
+    }
+    size_t views = m_rotations.size();
+    return  _shader.setupShaderFromSource(GL_VERTEX_SHADER, source(_vert, true, views)) &&
+            _shader.setupShaderFromSource(GL_FRAGMENT_SHADER, source(_frag, false, views)) &&
+            _shader.bindDefaults() &&
+            _shader.linkProgram();
+}
+
+glm::mat4 ofxMultiView::getViewProjection(size_t _view) const {
+    return m_projection * m_rotations[_view];
+}
+
+std::vector<glm::mat4> ofxMultiView::getViewProjections() const {
+    std::vector<glm::mat4> views;
+    for (size_t i = 0; i < m_rotations.size(); i++) {
+        views.push_back(getViewProjection(i));
+    }
+    return views;
+}
+
+void ofxMultiView::begin(const ofCamera& _camera, size_t _pass) {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_previous);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    if (!m_multiview) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_color, 0, GLint(_pass));
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depth, 0, GLint(_pass));
+    }
+
+    ofPushView();
+    ofViewport(0, 0, m_width, m_height, false);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    ofSetMatrixMode(OF_MATRIX_PROJECTION);
+    if (m_multiview) {
+        // Every view's projection is applied in the vertex stage
+        ofLoadIdentityMatrix();
+    }
+    else {
+        ofLoadMatrix(getViewProjection(_pass));
+    }
+    ofSetMatrixMode(OF_MATRIX_MODELVIEW);
+    ofLoadViewMatrix(_camera.getModelViewMatrix());
+
+    resume();
+}
+
+void ofxMultiView::resume() {
+    if (!m_multiview) {
+        return;
+    }
+    m_default.begin();
+    setUniforms(m_default);
+}
+
+void ofxMultiView::setUniforms(ofShader& _shader) const {
+    std::vector<glm::mat4> views = getViewProjections();
+    _shader.setUniformMatrix4f("u_views", views[0], int(views.size()));
+}
+
+void ofxMultiView::end() {
+    if (m_multiview) {
+        m_default.end();
+    }
+    ofPopView();
+    glBindFramebuffer(GL_FRAMEBUFFER, m_previous);
+}
+
+void ofxMultiView::beginOverlay(size_t _view) {
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_previous);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_layerFbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_color, 0, GLint(_view));
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depth, 0, GLint(_view));
+
+    // No clear, the scene is already there and its depth still occludes
+    ofPushView();
+    ofViewport(0, 0, m_width, m_height, false);
+    ofSetMatrixMode(OF_MATRIX_PROJECTION);
+    ofLoadMatrix(getViewProjection(_view));
+    ofSetMatrixMode(OF_MATRIX_MODELVIEW);
+    ofLoadIdentityMatrix();
+}
+
+void ofxMultiView::endOverlay() {
+    ofPopView();
+    glBindFramebuffer(GL_FRAMEBUFFER, m_previous);
+}
+
+void ofxMultiView::drawDomeMaster(float _x, float _y, float _size, float _fovDegrees) {
+    if (!m_cube) {
+        return;
+    }
+    std::vector<glm::mat4> faces(m_rotations);
+    m_warp.begin();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_color);
+    m_warp.setUniform1i("u_views", 0);
+    m_warp.setUniform1i("u_layer", -1);
+    m_warp.setUniform1f("u_fov", glm::radians(_fovDegrees));
+    m_warp.setUniformMatrix4f("u_faces", faces[0], int(faces.size()));
+    ofPushMatrix();
+    ofTranslate(_x, _y);
+    ofScale(_size, _size);
+    m_quad.draw();
+    ofPopMatrix();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    m_warp.end();
+}
+
+void ofxMultiView::drawView(size_t _view, float _x, float _y, float _width, float _height) {
+    if (_view >= m_rotations.size()) {
+        return;
+    }
+    m_warp.begin();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_color);
+    m_warp.setUniform1i("u_views", 0);
+    m_warp.setUniform1i("u_layer", int(_view));
+    ofPushMatrix();
+    ofTranslate(_x, _y);
+    ofScale(_width, _height);
+    m_quad.draw();
+    ofPopMatrix();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    m_warp.end();
+}
@@ -0,0 +1,97 @@
+//
+//  ofxMultiView.h
+//  Solar
+//
+//  Renders the scene into several views at once (the six faces of a cube
+//  for a dome, or one view per projector of a wall) and warps the cube
+//  into a fisheye dome master.
+//
+//  With GL_OVR_multiview2 the views are the layers of one texture array
+//  and the scene is submitted once: draw calls go through shaders whose
+//  vertex stage multiplies the view space position by the matrix of
+//  gl_ViewID_OVR. load() builds those variants from the scene's own
+//  shader files (the projection is identity while the scene is drawn, so
+//  their gl_Position is in view space), and the default shader is
+//  replaced by one made the same way. Without the extension every view
+//  is drawn in its own pass, with the usual shaders.
+//
+//  In a single pass the renderer's projection is identity, so anything
+//  that projects on its own (bitmap strings in billboard mode) would land
+//  in the wrong place. Callers keep those for an overlay pass per view
+//  (beginOverlay()), drawn on top of the scene with a real projection.
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+#define MULTIVIEW_MAX_VIEWS 6
+#define MULTIVIEW_NEAR      0.05
+#define MULTIVIEW_FAR       10000.0
+
+class ofxMultiView {
+public:
+    ofxMultiView();
+    virtual ~ofxMultiView();
+
+    // Six 90 degree faces around the camera, for the dome master
+    bool        setupCube(int _faceSize);
+    // Arbitrary views, each a rotation from camera space (looking down -Z)
+    bool        setup(int _width, int _height, const std::vector<glm::mat4>& _rotations, float _fovDegrees);
+    bool        isAllocated() const { return m_color != 0; }
+    void        setClip(float _near, float _far);
+
+    // Single submission (OVR_multiview) or one pass per view
+    bool        isMultiview() const { return m_multiview; }
+    size_t      getPasses() const { return m_multiview? 1 : m_rotations.size(); }
+    size_t      getViews() const { return m_rotations.size(); }
+
+    // Multiview variant of a scene shader. Does nothing without the extension
+    bool        load(ofShader& _shader, const std::string& _vert, const std::string& _frag) const;
+
+    // Around the scene submission, with the camera's view
+    void        begin(const ofCamera& _camera, size_t _pass = 0);
+    void        end();
+    // After the scene, one pass per view with that view's projection and
+    // an identity model view: positions are in the camera's view space.
+    // Only needed with multiview, otherwise the scene passes already are
+    size_t      getOverlayPasses() const { return m_multiview? m_rotations.size() : 0; }
+    void        beginOverlay(size_t _view);
+    void        endOverlay();
+    // After begin() of a shader from load(): its per view matrices
+    void        setUniforms(ofShader& _shader) const;
+    // A scene shader ended, so the multiview default shader goes back on
+    void        resume();
+
+    // Fisheye of _fovDegrees centered on where the camera looks (cube setup only)
+    void        drawDomeMaster(float _x, float _y, float _size, float _fovDegrees = 180.0f);
+    // One view as is, for projector outputs
+    void        drawView(size_t _view, float _x, float _y, float _width, float _height);
+
+    // Projection and rotation of a view, for code that needs to know what it sees
+    glm::mat4   getViewProjection(size_t _view) const;
+    std::vector<glm::mat4> getViewProjections() const;
+
+protected:
+    void        clear();
+    bool        allocate();
+    std::string source(const std::string& _path, bool _vertex, size_t _views) const;
+
+    std::vector<glm::mat4>  m_rotations;
+    glm::mat4               m_projection;
+    float                   m_fov;
+    float                   m_near, m_far;
+    int                     m_width, m_height;
+    bool                    m_cube;
+    bool                    m_multiview;
+
+    GLuint                  m_fbo;
+    GLuint                  m_layerFbo; // one layer at a time, for the overlays
+    GLuint                  m_color;    // GL_TEXTURE_2D_ARRAY, one layer per view
+    GLuint                  m_depth;
+    GLint                   m_previous;
+
+    ofShader                m_default;  // stands in for the renderer's shader
+    ofShader                m_warp;     // dome master and single layers
+    ofMesh                  m_quad;
+};
@@ -15,39 +15,41 @@ ofxSatellite::ofxSatellite(const TLE& _tle) {
     setTLE(_tle);
 }
 
-glm::vec3 ofxSatellite::getGeoPosition(DISTANCE_UNIT _type) {
-    Vector gPos = getEclipticGeocentric().getVector(_type);
-    return glm::vec3(gPos.x, gPos.y, gPos.z);
+static void addVertexIfMoved(ofPolyline& _trail, const glm::vec3& _point) {
+    if ( _trail.size() == 0) {
+        _trail.addVertex(_point);
+    } else if ( _trail[_trail.size()-1].x != _point.x ||
+               _trail[_trail.size()-1].y != _point.y ||
+               _trail[_trail.size()-1].z != _point.z ) {
+        _trail.addVertex(_point);
+    }
+}
+
+static void removeVertexIfLast(ofPolyline& _trail, const glm::vec3& _point) {
+    if ( _trail.size() > 0 && _trail[_trail.size()-1] == _point ) {
+        _trail.resize(_trail.size()-1);
+    }
 }
 
-glm::vec3 ofxSatellite::getHelioPosition(DISTANCE_UNIT _type) {
-    Vector hPos = getEclipticHeliocentric().getVector(_type);
-    return glm::vec3(hPos.x, hPos.y, hPos.z);
+void ofxSatellite::rewindTrails(const glm::vec3& _geo, const glm::vec3& _helio) {
+    removeVertexIfLast(m_geoTrail, _geo);
+    removeVertexIfLast(m_helioTrail, _helio);
 }
 
-void ofxSatellite::drawGeocentricTrail(ofFloatColor _color) {
+void ofxSatellite::updateTrails(const glm::vec3& _geo, const glm::vec3& _helio) {
+    addVertexIfMoved(m_geoTrail, _geo);
+    addVertexIfMoved(m_helioTrail, _helio);
+}
+
+void ofxSatellite::drawGeocentricTrail(ofFloatColor _color, const glm::vec3& _geo) {
     ofSetColor(_color);
-    
-    if ( m_geoTrail.size() == 0) {
-        m_geoTrail.addVertex(m_geoC);
-    } else if ( m_geoTrail[m_geoTrail.size()-1].x != m_geoC.x ||
-               m_geoTrail[m_geoTrail.size()-1].y != m_geoC.y ||
-               m_geoTrail[m_geoTrail.size()-1].z != m_geoC.z ) {
-        m_geoTrail.addVertex(m_geoC);
-    }
+    addVertexIfMoved(m_geoTrail, _geo);
     m_geoTrail.draw();
 }
 
-void ofxSatellite::drawHeliocentricTrail(ofFloatColor _color) {
+void ofxSatellite::drawHeliocentricTrail(ofFloatColor _color, const glm::vec3& _helio) {
     ofSetColor(_color);
-    
-    if ( m_helioTrail.size() == 0) {
-        m_helioTrail.addVertex(m_helioC);
-    } else if ( m_helioTrail[m_helioTrail.size()-1].x != m_helioC.x ||
-               m_helioTrail[m_helioTrail.size()-1].y != m_helioC.y ||
-               m_helioTrail[m_helioTrail.size()-1].z != m_helioC.z ) {
-        m_helioTrail.addVertex(m_helioC);
-    }
+    addVertexIfMoved(m_helioTrail, _helio);
     m_helioTrail.draw();
 }
 
@@ -56,17 +58,24 @@ void ofxSatellite::clearTale() {
     m_geoTrail.clear();
 }
 
-void ofxSatellite::draw(ofFloatColor _color, float _size) {
+void ofxSatellite::getBounds(const glm::vec3& _helio, const glm::vec3& _geo, glm::vec3& _center, float& _radius) {
+    _center = _helio + _geo * (SATELLITE_TETHER * 0.5f);
+    _radius = glm::length(_geo) * (SATELLITE_TETHER * 0.5f);
+}
+
+void ofxSatellite::draw(const glm::vec3& _helio, const glm::vec3& _geo, ofFloatColor _color, float _size, bool _label) {
     ofPushMatrix();
-    ofTranslate(m_helioC);
+    ofTranslate(_helio);
     ofSetColor(_color);
     ofDrawBox(_size);
     
-    glm::vec3 fromEarth = m_geoC * 0.25;
+    glm::vec3 fromEarth = _geo * SATELLITE_TETHER;
     ofSetColor(170);
     ofDrawLine(ofPoint(0.0), fromEarth);
-    ofSetColor(250);
-    ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
-    ofDrawBitmapString(getName(), fromEarth + _size);
+    if (_label) {
+        ofSetColor(250);
+        ofSetDrawBitmapMode(OF_BITMAPMODE_MODEL_BILLBOARD );
+        ofDrawBitmapString(getName(), fromEarth + _size);
+    }
     ofPopMatrix();
 }
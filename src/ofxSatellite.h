@@ -10,22 +10,36 @@
 #include "ofMain.h"
 #include "Astro/src/Satellite.h"
 
+#include "FrameVector.h"
+
+#define SATELLITE_TETHER 0.25   // of the geocentric vector, drawn from the marker
+
 class ofxSatellite : public Satellite {
 public:
     ofxSatellite();
     ofxSatellite(const TLE& _tle);
     
-    void drawGeocentricTrail(ofFloatColor _color);
-    void drawHeliocentricTrail(ofFloatColor _color);
-    void draw(ofFloatColor _color, float _size);
+    // Scene positions are not kept here but in the catalog's hot arrays
+    // (CatalogHot::geo and helio), which are passed in
+    void updateTrails(const glm::vec3& _geo, const glm::vec3& _helio);
+    // Drops the vertices of the current position, one frame back along the trails
+    void rewindTrails(const glm::vec3& _geo, const glm::vec3& _helio);
+    void drawGeocentricTrail(ofFloatColor _color, const glm::vec3& _geo);
+    void drawHeliocentricTrail(ofFloatColor _color, const glm::vec3& _helio);
+    void draw(const glm::vec3& _helio, const glm::vec3& _geo, ofFloatColor _color, float _size, bool _label = true);
+    // Where draw() puts the name, at the end of the tether
+    static glm::vec3 getLabelPosition(const glm::vec3& _helio, const glm::vec3& _geo, float _size) { return _helio + _geo * SATELLITE_TETHER + glm::vec3(_size); }
     
     void clearTale();
     
-    glm::vec3   getGeoPosition(DISTANCE_UNIT _type);
-    glm::vec3   getHelioPosition(DISTANCE_UNIT _type);
+    // Sphere around the tether and label draw() adds to the marker at _helio.
+    // The marker and label size is left out, pad the radius with 1.75 x size
+    static void getBounds(const glm::vec3& _helio, const glm::vec3& _geo, glm::vec3& _center, float& _radius);
     
-    glm::vec3   m_geoC;
-    glm::vec3   m_helioC;
+    template<Unit U>
+    GeoVector<U>    getGeoPosition() { return GeoVector<U>(getEclipticGeocentric().getVector(AU)).template to<U>(); }
+    template<Unit U>
+    HelioVector<U>  getHelioPosition() { return HelioVector<U>(getEclipticHeliocentric().getVector(AU)).template to<U>(); }
     
 protected:
     ofFloatColor    m_color;
@@ -0,0 +1,529 @@
+//
+//  ofxVirtualTexture.cpp
+//  Solar
+//
+
+#include "ofxVirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define VIRTUAL_TEXTURE_NONE        (~uint64_t(0))
+#define VIRTUAL_TEXTURE_BASE_TILES  4       // tiles of the coarsest level kept resident
+
+// Value of _name="..." in the .dzi XML, empty when missing
+static std::string dziAttribute(const std::string& _xml, const std::string& _name) {
+    size_t start = _xml.find(_name + "=\"");
+    if (start == std::string::npos) {
+        return "";
+    }
+    start += _name.size() + 2;
+    size_t end = _xml.find('"', start);
+    return (end == std::string::npos)? "" : _xml.substr(start, end - start);
+}
+
+ofxVirtualTexture::ofxVirtualTexture() :
+    m_width(0), m_height(0),
+    m_tileSize(0), m_overlap(0),
+    m_maxLevel(0), m_baseLevel(0),
+    m_loaded(false),
+    m_slotsPerSide(0), m_slotSize(0),
+    m_gridCols(0), m_gridRows(0),
+    m_frame(0),
+    m_dirty(false),
+    m_loading(VIRTUAL_TEXTURE_NONE),
+    m_running(false) {
+}
+
+ofxVirtualTexture::~ofxVirtualTexture() {
+    stop();
+}
+
+bool ofxVirtualTexture::setup(const std::string& _dzi, int _slots) {
+    stop();
+    m_loaded = false;
+
+    std::string xml = ofBufferFromFile(_dzi).getText();
+    m_format = dziAttribute(xml, "Format");
+    m_tileSize = std::atoi(dziAttribute(xml, "TileSize").c_str());
+    m_overlap = std::atoi(dziAttribute(xml, "Overlap").c_str());
+    m_width = std::atoi(dziAttribute(xml, "Width").c_str());
+    m_height = std::atoi(dziAttribute(xml, "Height").c_str());
+    if (m_format.empty() || m_tileSize <= 0 || m_overlap < 0 || m_width <= 0 || m_height <= 0) {
+        ofLogError("ofxVirtualTexture") << "Can't read " << _dzi;
+        return false;
+    }
+    m_folder = _dzi.substr(0, _dzi.find_last_of('.')) + "_files/";
+
+    // Level N is the full image, each level below halves it down to 1x1
+    m_maxLevel = int(std::ceil(std::log2(double(std::max(m_width, m_height)))));
+    m_baseLevel = 0;
+    for (int level = 0; level <= m_maxLevel; level++) {
+        if (levelCols(level) * levelRows(level) <= VIRTUAL_TEXTURE_BASE_TILES) {
+            m_baseLevel = level;
+        }
+    }
+
+    m_slotsPerSide = std::max(2, _slots);
+    m_slotSize = m_tileSize + 2 * m_overlap;
+    m_atlas.allocate(m_slotsPerSide * m_slotSize, m_slotsPerSide * m_slotSize, GL_RGB8);
+    m_atlas.setTextureMinMagFilter(GL_LINEAR, GL_LINEAR);
+    m_atlas.setTextureWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+    m_gridCols = levelCols(m_maxLevel);
+    m_gridRows = levelRows(m_maxLevel);
+    m_indirectionPixels.allocate(m_gridCols, m_gridRows, 4);
+    m_indirection.allocate(m_gridCols, m_gridRows, GL_RGBA8);
+    m_indirection.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+    m_indirection.setTextureWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+    Slot empty;
+    empty.key = VIRTUAL_TEXTURE_NONE;
+    empty.used = 0;
+    empty.pinned = false;
+    empty.empty = true;
+    m_slots.assign(m_slotsPerSide * m_slotsPerSide, empty);
+    m_lookup.clear();
+    m_wanted.clear();
+    m_failed.clear();
+    m_ready.clear();
+    m_results.clear();
+    m_requests.clear();
+
+    m_sphere = ofMesh::sphere(1.0, VIRTUAL_TEXTURE_RESOLUTION);
+
+    // The base level is loaded right away and never evicted
+    for (int row = 0; row < levelRows(m_baseLevel); row++) {
+        for (int col = 0; col < levelCols(m_baseLevel); col++) {
+            Decoded tile;
+            tile.key = makeKey(m_baseLevel, col, row);
+            tile.ok = ofLoadImage(tile.pixels, tilePath(tile.key));
+            if (tile.ok && tile.pixels.getNumChannels() != 3) {
+                tile.pixels.setImageType(OF_IMAGE_COLOR);
+            }
+            if (!tile.ok || !upload(tile)) {
+                ofLogError("ofxVirtualTexture") << "Can't load " << tilePath(tile.key);
+                return false;
+            }
+            m_slots[m_lookup[tile.key]].pinned = true;
+        }
+    }
+
+    m_loaded = true;
+    m_dirty = true;
+    paint();
+    start();
+    ofLogNotice("ofxVirtualTexture") << m_width << "x" << m_height << ", levels " << m_baseLevel << " to " << m_maxLevel
+                                     << ", " << m_slots.size() << " slots of " << m_slotSize << "px";
+    return true;
+}
+
+int ofxVirtualTexture::levelWidth(int _level) const {
+    int shift = m_maxLevel - _level;
+    return std::max(1, (m_width + (1 << shift) - 1) >> shift);
+}
+
+int ofxVirtualTexture::levelHeight(int _level) const {
+    int shift = m_maxLevel - _level;
+    return std::max(1, (m_height + (1 << shift) - 1) >> shift);
+}
+
+int ofxVirtualTexture::levelCols(int _level) const {
+    return (levelWidth(_level) + m_tileSize - 1) / m_tileSize;
+}
+
+int ofxVirtualTexture::levelRows(int _level) const {
+    return (levelHeight(_level) + m_tileSize - 1) / m_tileSize;
+}
+
+std::string ofxVirtualTexture::tilePath(Key _key) const {
+    return m_folder + ofToString(keyLevel(_key)) + "/" + ofToString(keyCol(_key)) + "_" + ofToString(keyRow(_key)) + "." + m_format;
+}
+
+void ofxVirtualTexture::update(const glm::mat4& _modelView, const glm::mat4& _projection, const ofRectangle& _viewport) {
+    update(_modelView, std::vector<glm::mat4>(1, _projection), _viewport);
+}
+
+void ofxVirtualTexture::update(const glm::mat4& _modelView, const std::vector<glm::mat4>& _projections, const ofRectangle& _viewport) {
+    if (!m_loaded || _projections.empty()) {
+        return;
+    }
+    m_frame++;
+
+    // Coarser everywhere until the tiles in view, and the ancestors that
+    // stand in for the missing ones, fit the atlas
+    size_t capacity = 0;
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        capacity += m_slots[i].pinned? 0 : 1;
+    }
+    std::vector<Key> wanted, view;
+    for (int bias = 0; bias <= m_maxLevel - m_baseLevel; bias++) {
+        wanted.clear();
+        for (size_t p = 0; p < _projections.size(); p++) {
+            // A single view is projected once for every bias
+            if (bias == 0 || _projections.size() > 1) {
+                project(_modelView, _projections[p], _viewport);
+            }
+            collect(bias, view);
+            wanted.insert(wanted.end(), view.begin(), view.end());
+        }
+        if (_projections.size() > 1) {
+            std::sort(wanted.begin(), wanted.end());
+            wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+        }
+        if (countSlots(wanted) <= capacity) {
+            break;
+        }
+    }
+    if (wanted != m_wanted) {
+        m_wanted.swap(wanted);
+        m_dirty = true;
+    }
+    // What this frame reads is known before anything is evicted for the uploads
+    touch();
+
+    // Sorted keys have the level on top, so the coarsest tiles are asked for first
+    std::vector<Key> missing;
+    for (size_t i = 0; i < m_wanted.size(); i++) {
+        if (m_lookup.find(m_wanted[i]) == m_lookup.end() && m_failed.find(m_wanted[i]) == m_failed.end()) {
+            missing.push_back(m_wanted[i]);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_ready.empty()) {
+            m_ready.swap(m_results);
+        }
+        // Tiles that left the view and were not started yet are forgotten
+        m_requests.clear();
+        for (size_t i = 0; i < missing.size(); i++) {
+            bool decoded = false;
+            for (size_t j = 0; j < m_ready.size() && !decoded; j++) {
+                decoded = m_ready[j].key == missing[i];
+            }
+            for (size_t j = 0; j < m_results.size() && !decoded; j++) {
+                decoded = m_results[j].key == missing[i];
+            }
+            if (!decoded && missing[i] != m_loading) {
+                m_requests.push_back(missing[i]);
+            }
+        }
+    }
+    m_wake.notify_one();
+
+    // A few uploads per frame keep the frame time flat. Tiles that are no
+    // longer in view still fill slots nobody uses this frame
+    for (int i = 0; i < VIRTUAL_TEXTURE_UPLOADS && !m_ready.empty(); i++) {
+        Decoded tile = std::move(m_ready.front());
+        m_ready.pop_front();
+        if (!tile.ok) {
+            ofLogWarning("ofxVirtualTexture") << "Can't load " << tilePath(tile.key);
+            m_failed.insert(tile.key);
+        }
+        else if (m_lookup.find(tile.key) == m_lookup.end()) {
+            upload(tile);
+        }
+    }
+
+    paint();
+}
+
+void ofxVirtualTexture::project(const glm::mat4& _modelView, const glm::mat4& _projection, const ofRectangle& _viewport) {
+    const std::vector<glm::vec3>& vertices = m_sphere.getVertices();
+    const std::vector<glm::vec3>& normals = m_sphere.getNormals();
+    size_t total = vertices.size();
+    m_clip.resize(total);
+    m_screen.resize(total);
+    m_facing.resize(total);
+
+    glm::mat4 modelViewProjection = _projection * _modelView;
+    glm::mat3 normalMatrix = glm::mat3(_modelView);
+    for (size_t i = 0; i < total; i++) {
+        glm::vec4 clip = modelViewProjection * glm::vec4(vertices[i], 1.0f);
+        glm::vec3 view = glm::vec3(_modelView * glm::vec4(vertices[i], 1.0f));
+        glm::vec3 normal = normalMatrix * ((i < normals.size())? normals[i] : vertices[i]);
+        m_clip[i] = clip;
+        m_facing[i] = uint8_t(glm::dot(normal, view) < 0.0f);
+        if (clip.w > 0.0f) {
+            m_screen[i] = glm::vec2((clip.x / clip.w * 0.5f + 0.5f) * _viewport.width,
+                                    (clip.y / clip.w * 0.5f + 0.5f) * _viewport.height);
+        }
+    }
+}
+
+void ofxVirtualTexture::collect(int _bias, std::vector<Key>& _wanted) const {
+    _wanted.clear();
+
+    const std::vector<glm::vec2>& texCoords = m_sphere.getTexCoords();
+    const std::vector<unsigned int>& indices = m_sphere.getIndices();
+    size_t corners = indices.empty()? m_clip.size() : indices.size();
+    if (texCoords.size() < m_clip.size()) {
+        return;
+    }
+    glm::vec2 texels(m_width, m_height);
+
+    for (size_t t = 0; t + 2 < corners; t += 3) {
+        size_t v[3];
+        for (int k = 0; k < 3; k++) {
+            v[k] = indices.empty()? t + k : indices[t + k];
+        }
+        if (!m_facing[v[0]] && !m_facing[v[1]] && !m_facing[v[2]]) {
+            continue;
+        }
+
+        // Behind the camera, or out of one side of the frustum
+        bool behind = false;
+        int outside[4] = { 0, 0, 0, 0 };
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4& c = m_clip[v[k]];
+            behind |= c.w <= 0.0f;
+            outside[0] += c.x < -c.w;
+            outside[1] += c.x > c.w;
+            outside[2] += c.y < -c.w;
+            outside[3] += c.y > c.w;
+        }
+        if (behind || outside[0] == 3 || outside[1] == 3 || outside[2] == 3 || outside[3] == 3) {
+            continue;
+        }
+
+        // Screen pixels per full resolution texel along the longest edge
+        float density = 0.0f;
+        glm::vec2 uvMin(1.0f), uvMax(0.0f);
+        for (int k = 0; k < 3; k++) {
+            const glm::vec2& a = texCoords[v[k]];
+            const glm::vec2& b = texCoords[v[(k + 1) % 3]];
+            float texLength = glm::length((b - a) * texels);
+            if (texLength > 1e-3f) {
+                density = std::max(density, glm::length(m_screen[v[(k + 1) % 3]] - m_screen[v[k]]) / texLength);
+            }
+            uvMin = glm::min(uvMin, a);
+            uvMax = glm::max(uvMax, a);
+        }
+        int down = (density >= 1.0f || density <= 0.0f)? 0 : int(std::floor(-std::log2(density)));
+        int level = m_maxLevel - std::min(down + _bias, m_maxLevel - m_baseLevel);
+
+        auto tile = [&](float _uv, int _size, int _count) {
+            return std::max(0, std::min(_count - 1, int(std::floor(_uv * _size / m_tileSize))));
+        };
+        int colMin = tile(uvMin.x, levelWidth(level), levelCols(level));
+        int colMax = tile(uvMax.x, levelWidth(level), levelCols(level));
+        int rowMin = tile(uvMin.y, levelHeight(level), levelRows(level));
+        int rowMax = tile(uvMax.y, levelHeight(level), levelRows(level));
+        for (int row = rowMin; row <= rowMax; row++) {
+            for (int col = colMin; col <= colMax; col++) {
+                _wanted.push_back(makeKey(level, col, row));
+            }
+        }
+    }
+
+    std::sort(_wanted.begin(), _wanted.end());
+    _wanted.erase(std::unique(_wanted.begin(), _wanted.end()), _wanted.end());
+}
+
+// Slot of the tile itself or of its nearest loaded ancestor above the base
+// level (which is pinned and painted on its own), -1 when there is none
+int ofxVirtualTexture::findSource(Key _key, int& _level) const {
+    int level = keyLevel(_key);
+    int col = keyCol(_key);
+    int row = keyRow(_key);
+    for (_level = level; _level > m_baseLevel; _level--) {
+        int shift = level - _level;
+        std::unordered_map<Key, int>::const_iterator it = m_lookup.find(makeKey(_level, col >> shift, row >> shift));
+        if (it != m_lookup.end()) {
+            return it->second;
+        }
+    }
+    return -1;
+}
+
+// Unpinned slots _wanted occupies once loaded, plus the resident ancestors
+// that are read meanwhile and so can not be reused either
+size_t ofxVirtualTexture::countSlots(const std::vector<Key>& _wanted) const {
+    std::vector<Key> ancestors;
+    for (size_t i = 0; i < _wanted.size(); i++) {
+        if (m_lookup.find(_wanted[i]) != m_lookup.end()) {
+            continue;
+        }
+        int level;
+        int slot = findSource(_wanted[i], level);
+        if (slot >= 0) {
+            ancestors.push_back(m_slots[slot].key);
+        }
+    }
+    std::sort(ancestors.begin(), ancestors.end());
+    ancestors.erase(std::unique(ancestors.begin(), ancestors.end()), ancestors.end());
+
+    size_t count = _wanted.size();
+    for (size_t i = 0; i < ancestors.size(); i++) {
+        count += std::binary_search(_wanted.begin(), _wanted.end(), ancestors[i])? 0 : 1;
+    }
+    return count;
+}
+
+// Marks the slots the wanted tiles read this frame, so findSlot() keeps them
+void ofxVirtualTexture::touch() {
+    for (size_t i = 0; i < m_wanted.size(); i++) {
+        int level;
+        int slot = findSource(m_wanted[i], level);
+        if (slot >= 0) {
+            m_slots[slot].used = m_frame;
+        }
+    }
+}
+
+int ofxVirtualTexture::findSlot() {
+    int oldest = -1;
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        const Slot& slot = m_slots[i];
+        if (slot.empty) {
+            return int(i);
+        }
+        // Slots read this frame stay
+        if (!slot.pinned && slot.used < m_frame && (oldest < 0 || slot.used < m_slots[oldest].used)) {
+            oldest = int(i);
+        }
+    }
+    return oldest;
+}
+
+bool ofxVirtualTexture::upload(Decoded& _tile) {
+    int col = keyCol(_tile.key);
+    int row = keyRow(_tile.key);
+    // Tiles carry the overlap only on the sides that have a neighbour
+    int left = (col > 0)? m_overlap : 0;
+    int top = (row > 0)? m_overlap : 0;
+    int width = int(_tile.pixels.getWidth());
+    int height = int(_tile.pixels.getHeight());
+    if (m_overlap - left + width > m_slotSize || m_overlap - top + height > m_slotSize) {
+        ofLogWarning("ofxVirtualTexture") << tilePath(_tile.key) << " is bigger than its tile size";
+        m_failed.insert(_tile.key);
+        return false;
+    }
+
+    int index = findSlot();
+    if (index < 0) {
+        return false;
+    }
+    Slot& slot = m_slots[index];
+    if (!slot.empty) {
+        m_lookup.erase(slot.key);
+    }
+
+    int x = (index % m_slotsPerSide) * m_slotSize + m_overlap - left;
+    int y = (index / m_slotsPerSide) * m_slotSize + m_overlap - top;
+    const ofTextureData& data = m_atlas.getTextureData();
+    glBindTexture(data.textureTarget, data.textureID);
+    // Rows of RGB tiles are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(data.textureTarget, 0, x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, _tile.pixels.getData());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(data.textureTarget, 0);
+
+    slot.key = _tile.key;
+    slot.used = m_frame;
+    slot.empty = false;
+    m_lookup[_tile.key] = index;
+    m_dirty = true;
+    return true;
+}
+
+void ofxVirtualTexture::paint() {
+    // Indirection texel: atlas slot, and how many levels under the full image it is
+    uint8_t* texels = m_indirectionPixels.getData();
+    auto fill = [&](int _level, int _col, int _row, int _slot, int _sourceLevel) {
+        int shift = m_maxLevel - _level;
+        int colEnd = std::min(m_gridCols, (_col + 1) << shift);
+        int rowEnd = std::min(m_gridRows, (_row + 1) << shift);
+        for (int y = _row << shift; y < rowEnd; y++) {
+            for (int x = _col << shift; x < colEnd; x++) {
+                uint8_t* texel = texels + (size_t(y) * m_gridCols + x) * 4;
+                texel[0] = uint8_t(_slot % m_slotsPerSide);
+                texel[1] = uint8_t(_slot / m_slotsPerSide);
+                texel[2] = uint8_t(m_maxLevel - _sourceLevel);
+                texel[3] = 255;
+            }
+        }
+    };
+
+    if (m_dirty) {
+        for (int row = 0; row < levelRows(m_baseLevel); row++) {
+            for (int col = 0; col < levelCols(m_baseLevel); col++) {
+                fill(m_baseLevel, col, row, m_lookup[makeKey(m_baseLevel, col, row)], m_baseLevel);
+            }
+        }
+    }
+
+    // Every wanted tile shows itself or its nearest loaded ancestor, finer ones last
+    for (size_t i = 0; i < m_wanted.size(); i++) {
+        int source;
+        int slot = findSource(m_wanted[i], source);
+        if (slot >= 0) {
+            m_slots[slot].used = m_frame;
+            if (m_dirty) {
+                fill(keyLevel(m_wanted[i]), keyCol(m_wanted[i]), keyRow(m_wanted[i]), slot, source);
+            }
+        }
+    }
+
+    if (m_dirty) {
+        m_indirection.loadData(m_indirectionPixels);
+        m_dirty = false;
+    }
+}
+
+void ofxVirtualTexture::bind(ofShader& _shader, int _firstUnit) const {
+    _shader.setUniformTexture("u_atlas", m_atlas, _firstUnit);
+    _shader.setUniformTexture("u_indirection", m_indirection, _firstUnit + 1);
+    _shader.setUniform2f("u_virtualSize", m_width, m_height);
+    _shader.setUniform2f("u_virtualGrid", m_gridCols, m_gridRows);
+    _shader.setUniform1f("u_virtualTile", m_tileSize);
+    _shader.setUniform1f("u_virtualBorder", m_overlap);
+    _shader.setUniform2f("u_atlasSize", m_atlas.getWidth(), m_atlas.getHeight());
+}
+
+void ofxVirtualTexture::start() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = true;
+    }
+    m_thread = std::thread(&ofxVirtualTexture::work, this);
+}
+
+void ofxVirtualTexture::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void ofxVirtualTexture::work() {
+    while (true) {
+        Decoded tile;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() {
+                return !m_running || (!m_requests.empty() && m_results.size() < VIRTUAL_TEXTURE_DECODED);
+            });
+            if (!m_running) {
+                return;
+            }
+            tile.key = m_requests.front();
+            m_requests.pop_front();
+            m_loading = tile.key;
+        }
+
+        tile.ok = ofLoadImage(tile.pixels, tilePath(tile.key));
+        if (tile.ok && tile.pixels.getNumChannels() != 3) {
+            tile.pixels.setImageType(OF_IMAGE_COLOR);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.push_back(std::move(tile));
+        m_loading = VIRTUAL_TEXTURE_NONE;
+    }
+}
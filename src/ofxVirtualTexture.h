@@ -0,0 +1,144 @@
+//
+//  ofxVirtualTexture.h
+//  Solar
+//
+//  Streams an equirectangular image far bigger than the GPU should hold
+//  (16k to 43k Blue Marble mosaics) from a tile pyramid on disk.
+//
+//  The pyramid is a Deep Zoom (.dzi) image, the layout that
+//  `vips dzsave earth.tif earth --overlap 1 --tile-size 510` writes:
+//  <name>_files/<level>/<col>_<row>.<format>, where level N is the full
+//  image and every level below it is half the size of the next one.
+//
+//  Each frame the sphere mesh is projected with the current matrices;
+//  every front-facing triangle asks for the level whose texels match its
+//  pixels, and for the tiles its texture coordinates cover. A background
+//  thread decodes the missing ones, and they are uploaded to slots of a
+//  fixed atlas (least recently used slots are reused first, never one the
+//  view reads this frame, ancestors standing in included). An
+//  indirection texture, one texel per tile of the finest level, tells
+//  the shader which slot and level to read. Where a tile is not loaded
+//  yet its nearest loaded ancestor is used instead. The coarsest levels
+//  are always resident, so there is never a hole.
+//
+//  Memory does not grow with the image: the atlas, the indirection
+//  texture and a few decoded tiles in flight.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ofMain.h"
+
+#define VIRTUAL_TEXTURE_SLOTS       8       // atlas slots per side
+#define VIRTUAL_TEXTURE_RESOLUTION  48      // of the sphere mesh
+#define VIRTUAL_TEXTURE_UPLOADS     4       // tiles uploaded per frame
+#define VIRTUAL_TEXTURE_DECODED     8       // decoded tiles waiting for upload
+
+class ofxVirtualTexture {
+public:
+    ofxVirtualTexture();
+    virtual ~ofxVirtualTexture();
+
+    // Reads the .dzi descriptor and loads the always resident levels
+    bool        setup(const std::string& _dzi, int _slots = VIRTUAL_TEXTURE_SLOTS);
+    bool        isLoaded() const { return m_loaded; }
+
+    // With the matrices the sphere is about to be drawn with (radius 1):
+    // picks the tiles the view needs, requests and uploads them
+    void        update(const glm::mat4& _modelView, const glm::mat4& _projection, const ofRectangle& _viewport);
+    // Same for several views at once (the faces of a dome): the union of what they need
+    void        update(const glm::mat4& _modelView, const std::vector<glm::mat4>& _projections, const ofRectangle& _viewport);
+
+    // Between begin() and end() of a shader with the u_atlas/u_indirection uniforms
+    void        bind(ofShader& _shader, int _firstUnit) const;
+    // Unit sphere with the same texture coordinates as ofDrawSphere()
+    void        drawSphere() const { m_sphere.draw(); }
+
+    size_t      getResident() const { return m_lookup.size(); }
+    size_t      getWanted() const { return m_wanted.size(); }
+
+protected:
+    typedef uint64_t Key;
+    static Key  makeKey(int _level, int _col, int _row) { return (Key(_level) << 48) | (Key(_row) << 24) | Key(_col); }
+    static int  keyLevel(Key _key) { return int(_key >> 48); }
+    static int  keyRow(Key _key) { return int((_key >> 24) & 0xFFFFFF); }
+    static int  keyCol(Key _key) { return int(_key & 0xFFFFFF); }
+
+    struct Slot {
+        Key         key;
+        uint64_t    used;       // frame
+        bool        pinned;
+        bool        empty;
+    };
+
+    struct Decoded {
+        Key         key;
+        ofPixels    pixels;
+        bool        ok;
+    };
+
+    int         levelWidth(int _level) const;
+    int         levelHeight(int _level) const;
+    int         levelCols(int _level) const;
+    int         levelRows(int _level) const;
+    std::string tilePath(Key _key) const;
+
+    void        project(const glm::mat4& _modelView, const glm::mat4& _projection, const ofRectangle& _viewport);
+    void        collect(int _bias, std::vector<Key>& _wanted) const;
+    int         findSource(Key _key, int& _level) const;
+    size_t      countSlots(const std::vector<Key>& _wanted) const;
+    void        touch();
+    bool        upload(Decoded& _tile);
+    int         findSlot();
+    void        paint();
+
+    void        start();
+    void        stop();
+    void        work();
+
+    // Pyramid
+    std::string m_folder;
+    std::string m_format;
+    int         m_width, m_height;
+    int         m_tileSize, m_overlap;
+    int         m_maxLevel;         // full resolution
+    int         m_baseLevel;        // always resident
+    bool        m_loaded;
+
+    // GPU side
+    ofVboMesh   m_sphere;
+    ofTexture   m_atlas;
+    ofTexture   m_indirection;
+    ofPixels    m_indirectionPixels;
+    int         m_slotsPerSide;
+    int         m_slotSize;         // tile plus overlap on both sides
+    int         m_gridCols, m_gridRows;
+
+    std::vector<Slot>               m_slots;
+    std::unordered_map<Key, int>    m_lookup;   // resident tile to slot
+    std::vector<Key>                m_wanted;
+    std::unordered_set<Key>         m_failed;
+    std::deque<Decoded>             m_ready;    // decoded, not uploaded yet
+    std::vector<glm::vec4>          m_clip;     // sphere vertices this frame
+    std::vector<glm::vec2>          m_screen;
+    std::vector<uint8_t>            m_facing;
+    uint64_t                        m_frame;
+    bool                            m_dirty;
+
+    // Decoder thread
+    std::thread                 m_thread;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_wake;
+    std::deque<Key>             m_requests;
+    std::deque<Decoded>         m_results;
+    Key                         m_loading;
+    bool                        m_running;
+};